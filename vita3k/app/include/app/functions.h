@@ -42,6 +42,8 @@ bool init(EmuEnvState &state, Config &cfg, const Root &root_paths);
 void destroy(EmuEnvState &emuenv, ImGui_State *imgui);
 void update_viewport(EmuEnvState &state);
 void switch_state(EmuEnvState &emuenv, const bool pause);
+void set_speed(EmuEnvState &emuenv, float speed);
+void toggle_fast_forward(EmuEnvState &emuenv);
 void error_dialog(const std::string &message, SDL_Window *window = nullptr);
 
 void set_window_title(EmuEnvState &emuenv);
@@ -31,6 +31,7 @@
 
 #include <nids/functions.h>
 #include <renderer/functions.h>
+#include <rtc/guest_clock.h>
 #include <rtc/rtc.h>
 #include <util/fs.h>
 #include <util/lock_and_find.h>
@@ -49,6 +50,8 @@
 #include <SDL_video.h>
 #include <SDL_vulkan.h>
 
+#include <cmath>
+
 namespace app {
 void update_viewport(EmuEnvState &state) {
     int w = 0;
@@ -201,7 +204,9 @@ bool init(EmuEnvState &state, Config &cfg, const Root &root_paths) {
         }
     }
 
-    if (!init(state.mem, state.renderer->need_page_table)) {
+    state.mem.use_huge_pages = state.cfg.huge_pages;
+    const WriteTracking write_tracking = state.cfg.write_tracking == "userfaultfd" ? WriteTracking::Userfaultfd : WriteTracking::Mprotect;
+    if (!init(state.mem, state.renderer->need_page_table, write_tracking)) {
         LOG_ERROR("Failed to initialize memory for emulator state!");
         return false;
     }
@@ -256,4 +261,24 @@ void switch_state(EmuEnvState &emuenv, const bool pause) {
     emuenv.audio.switch_state(pause);
 }
 
+// Apply the speed to everything the guest can measure the time with, so its logic stays consistent.
+// A speed of 0 runs as fast as possible: a vblank as soon as a frame is ready, which moves the guest clock
+// forward by one vblank period, and no audio.
+void set_speed(EmuEnvState &emuenv, float speed) {
+    if (!(speed >= 0) || !std::isfinite(speed)) {
+        LOG_WARN("Invalid emulation speed {}, using x1", speed);
+        speed = 1.0f;
+    }
+
+    // the RTC and the timeouts of the timer wheel
+    guest_clock().set_speed(speed);
+    emuenv.audio.set_speed(speed);
+    emuenv.display.speed = speed;
+    LOG_INFO("Emulation speed set to {}", speed > 0 ? fmt::format("x{}", speed) : "unlimited");
+}
+
+void toggle_fast_forward(EmuEnvState &emuenv) {
+    set_speed(emuenv, emuenv.display.speed == 1.0f ? emuenv.cfg.fast_forward_speed : 1.0f);
+}
+
 } // namespace app
@@ -39,6 +39,8 @@ struct CubebAudioOutPort : AudioOutPort {
     // position of the next audio buffer to put audio
     int next_audio_buffer = 0;
     int nb_buffers_ready = 0;
+    // speed of the audio state, see AudioState::speed
+    const std::atomic<float> *speed = nullptr;
 
     // use the destructor to destroy the cubeb stream
     ~CubebAudioOutPort();
@@ -56,4 +58,5 @@ public:
     void audio_output(ThreadState &thread, AudioOutPort &out_port, const void *buffer) override;
     void set_volume(AudioOutPort &out_port, float volume) override;
     void switch_state(const bool pause) override;
+    void set_speed(float speed) override;
 };
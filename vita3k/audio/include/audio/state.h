@@ -21,6 +21,7 @@
 
 #include <SDL_audio.h>
 
+#include <atomic>
 #include <functional>
 #include <map>
 #include <memory>
@@ -94,6 +95,7 @@ public:
     virtual void audio_output(ThreadState &thread, AudioOutPort &out_port, const void *buffer) {}
     virtual void set_volume(AudioOutPort &out_port, float volume) {}
     virtual void switch_state(const bool pause) {}
+    virtual void set_speed(float speed) {}
 
     friend struct AudioState;
 };
@@ -108,6 +110,8 @@ struct AudioState {
     AudioInPort in_port;
     ResumeAudioThread resume_thread;
     std::string audio_backend;
+    // the output is consumed speed times faster than it is played, 0 drops it as fast as it comes
+    std::atomic<float> speed{ 1.0f };
 
     bool init(const ResumeAudioThread &resume_thread, const std::string &adapter_name);
     void set_backend(const std::string &adapter_name);
@@ -115,4 +119,5 @@ struct AudioState {
     void audio_output(ThreadState &thread, AudioOutPort &out_port, const void *buffer);
     void set_volume(AudioOutPort &out_port, float volume);
     void switch_state(const bool pause);
+    void set_speed(float speed);
 };
@@ -30,7 +30,7 @@
 #include <cassert>
 #include <cstring>
 
-static void mix_out_port(uint8_t *stream, uint8_t *temp_buffer, int len, AudioOutPort &port, const ResumeAudioThread &resume_thread) {
+static void mix_out_port(uint8_t *stream, uint8_t *temp_buffer, int len, AudioOutPort &port, const ResumeAudioThread &resume_thread, float speed) {
     ZoneScopedC(0xF6C2FF); // Tracy - Track function scope with color thistle
 
     // How much data is available?
@@ -38,9 +38,12 @@ static void mix_out_port(uint8_t *stream, uint8_t *temp_buffer, int len, AudioOu
     const int bytes_available = SDL_AudioStreamAvailable(port.stream.get());
     assert(bytes_available >= 0);
 
+    // When fast-forwarding, more is consumed than played, rounded to whole stereo 16-bit frames
+    const int bytes_consumed = speed > 0 ? static_cast<int>(len * speed) & ~3 : bytes_available;
+
     // Running out of data?
     // The (len * 3) is according to the value in sceAudioOutOutput
-    if (bytes_available < len * 3) {
+    if (bytes_available < std::max(bytes_consumed, len) * 3) {
         // Is there a thread waiting for playback to finish?
         if (port.thread >= 0) {
             // Wake the thread up.
@@ -52,8 +55,20 @@ static void mix_out_port(uint8_t *stream, uint8_t *temp_buffer, int len, AudioOu
     if (bytes_available == 0)
         return;
 
-    // Mix as much as we need.
-    const int bytes_to_get = std::min(len, bytes_available);
+    if (speed == 0) {
+        // as fast as possible, there is nothing meaningful to play
+        SDL_AudioStreamClear(port.stream.get());
+        return;
+    }
+
+    // Skip what is consumed but not played, then mix as much as we need.
+    for (int bytes_to_skip = std::min(bytes_consumed, bytes_available) - len; bytes_to_skip > 0;) {
+        const int bytes_skipped = SDL_AudioStreamGet(port.stream.get(), temp_buffer, std::min(len, bytes_to_skip));
+        if (bytes_skipped <= 0)
+            break;
+        bytes_to_skip -= bytes_skipped;
+    }
+    const int bytes_to_get = std::min(len, SDL_AudioStreamAvailable(port.stream.get()));
     const int bytes_got = SDL_AudioStreamGet(port.stream.get(), temp_buffer, bytes_to_get);
     lock.unlock();
     if (bytes_got > 0) {
@@ -76,8 +91,9 @@ void AudioAdapter::audio_callback(uint8_t *stream, int len_bytes) {
     }
     std::memset(stream, state.spec.silence, len_bytes);
 
+    const float speed = state.speed.load();
     for (const AudioOutPortPtr &port : ports) {
-        mix_out_port(stream, temp_buffer.data(), len_bytes, *port.get(), state.resume_thread);
+        mix_out_port(stream, temp_buffer.data(), len_bytes, *port.get(), state.resume_thread, speed);
     }
 
     FrameMarkNamed("Audio"); // Tracy - End discontinuous frame for audio rendering
@@ -154,7 +170,8 @@ void AudioState::audio_output(ThreadState &thread, AudioOutPort &out_port, const
         // we are supposed to wait for the existing samples to be processed (except the ones just passed)
         // but this would give a bad audio because the host buffer size is different compared to the guest buffer size
         // so we need to cache more data to make sure we always have enough
-        if (available >= 3 * spec.nb_samples * 2 * sizeof(uint16_t)) {
+        // when running as fast as possible, the host doesn't pace the output anymore
+        if (available >= 3 * spec.nb_samples * 2 * sizeof(uint16_t) && speed.load() > 0) {
             out_port.thread = thread.id;
 
             std::unique_lock<std::mutex> mlock(thread.mutex);
@@ -175,3 +192,21 @@ void AudioState::set_volume(AudioOutPort &out_port, float volume) {
 void AudioState::switch_state(const bool pause) {
     adapter->switch_state(pause);
 }
+
+void AudioState::set_speed(float new_speed) {
+    speed = new_speed;
+
+    if (adapter->single_stream) {
+        // the waiting threads check the speed again once woken up
+        const std::lock_guard<std::mutex> lock(mutex);
+        for (const AudioOutPortPtrs::value_type &port : out_ports) {
+            const std::lock_guard<std::mutex> port_lock(port.second->mutex);
+            if (port.second->thread >= 0) {
+                resume_thread(port.second->thread);
+                port.second->thread = -1;
+            }
+        }
+    } else {
+        adapter->set_speed(new_speed);
+    }
+}
@@ -23,6 +23,9 @@
 
 #include "util/log.h"
 
+#include <algorithm>
+#include <climits>
+
 static long impl_cubeb_audio_callback(cubeb_stream *stream, void *user_data, const void *input, void *output, long nframes) {
     assert(user_data != nullptr);
     assert(stream != nullptr);
@@ -31,7 +34,13 @@ static long impl_cubeb_audio_callback(cubeb_stream *stream, void *user_data, con
 
     int bytes_given = 0;
     const int bytes_to_give = nframes * port->spec.channels * sizeof(uint16_t);
-    while (bytes_given < bytes_to_give) {
+    // when fast-forwarding, the buffers are consumed faster and only the start of what is consumed is played,
+    // when running as fast as possible nothing is played
+    const float speed = port->speed->load();
+    const int bytes_to_consume = speed > 0 ? static_cast<int>(bytes_to_give * speed) : INT_MAX;
+    const int bytes_to_play = speed > 0 ? bytes_to_give : 0;
+    int bytes_consumed = 0;
+    while (bytes_consumed < bytes_to_consume) {
         if (port->nb_buffers_ready == 0) {
             // no data available, should we wait for it or return nothing?
             // return nothing for now
@@ -39,10 +48,11 @@ static long impl_cubeb_audio_callback(cubeb_stream *stream, void *user_data, con
         }
 
         AudioBuffer &audio_buffer = port->audio_buffers[port->next_audio_buffer];
-        // compute the number of bytes we can copy from this buffer to the output
-        const int bytes_to_copy = std::min(bytes_to_give - bytes_given, port->len_bytes - audio_buffer.buffer_position);
+        // compute the number of bytes we can take from this buffer and how many of them go to the output
+        const int bytes_to_take = std::min(bytes_to_consume - bytes_consumed, port->len_bytes - audio_buffer.buffer_position);
+        const int bytes_to_copy = std::clamp(bytes_to_play - bytes_given, 0, bytes_to_take);
         memcpy(&output_buffer[bytes_given], &audio_buffer.buffer[audio_buffer.buffer_position], bytes_to_copy);
-        audio_buffer.buffer_position += bytes_to_copy;
+        audio_buffer.buffer_position += bytes_to_take;
 
         if (audio_buffer.buffer_position == port->len_bytes) {
             // if we are done with this buffer, tell it
@@ -54,7 +64,10 @@ static long impl_cubeb_audio_callback(cubeb_stream *stream, void *user_data, con
         }
 
         bytes_given += bytes_to_copy;
+        bytes_consumed += bytes_to_take;
     }
+    // what could not be filled is silence
+    memset(&output_buffer[bytes_given], 0, bytes_to_give - bytes_given);
 
     return nframes;
 }
@@ -112,6 +125,7 @@ AudioOutPortPtr CubebAudioAdapter::open_port(int nb_channels, int freq, int nb_s
     }
 
     port->len_bytes = nb_sample * nb_channels * sizeof(uint16_t);
+    port->speed = &state.speed;
 
     // allocate enough buffers to be able to satisfy a callback (+1 to make sure one buffer can be ready)
     const int nb_buffers = (latency + nb_sample - 1) / nb_sample + 1;
@@ -133,12 +147,13 @@ void CubebAudioAdapter::audio_output(ThreadState &thread, AudioOutPort &out_port
     if (port.nb_buffers_ready == port.audio_buffers.size()) {
         // is it really useful to update the thread status?
         thread.update_status(ThreadStatus::wait);
-        port.cond_var.wait(lock);
+        // when running as fast as possible, the host doesn't pace the output anymore
+        port.cond_var.wait(lock, [&] { return port.nb_buffers_ready < port.audio_buffers.size() || state.speed.load() == 0; });
         thread.update_status(ThreadStatus::run);
     }
 
-    assert(port.nb_buffers_ready < port.audio_buffers.size());
-    if (buffer) {
+    // the buffer is dropped if the port is still full
+    if (buffer && port.nb_buffers_ready < port.audio_buffers.size()) {
         // the buffer can be empty to drain the port
         int next_buffer_pos = (port.next_audio_buffer + port.nb_buffers_ready) % port.audio_buffers.size();
         // we could unlock the lock here and re-lock it right after, but will this be faster?
@@ -165,3 +180,15 @@ void CubebAudioAdapter::switch_state(const bool pause) {
             cubeb_stream_start(port.out_stream);
     }
 }
+
+void CubebAudioAdapter::set_speed(float speed) {
+    const std::lock_guard<std::mutex> lock(state.mutex);
+    for (auto [_, out_port] : state.out_ports) {
+        CubebAudioOutPort &port = static_cast<CubebAudioOutPort &>(*out_port);
+        {
+            // lock the port so a thread about to wait doesn't miss the notification
+            const std::lock_guard<std::mutex> port_lock(port.mutex);
+        }
+        port.cond_var.notify_all();
+    }
+}
@@ -85,10 +85,17 @@ enum PerfomanceOverleyPosition {
     code(int, "log-level", static_cast<int>(spdlog::level::trace), log_level)                           \
     code(std::string, "cpu-backend", "Dynarmic", cpu_backend)                                           \
     code(bool, "cpu-opt", true, cpu_opt)                                                                \
+    code(bool, "jit-cache", true, jit_cache)                                                            \
+    code(bool, "host-thread-priority", false, host_thread_priority)                                     \
+    code(std::string, "host-core-affinity", std::string{}, host_core_affinity)                          \
+    code(bool, "park-spinning-threads", true, park_spinning_threads)                                    \
+    code(std::string, "write-tracking", "mprotect", write_tracking)                                     \
+    code(bool, "huge-pages", false, huge_pages)                                                         \
     code(std::string, "pref-path", std::string{}, pref_path)                                            \
     code(bool, "discord-rich-presence", true, discord_rich_presence)                                    \
     code(bool, "wait-for-debugger", false, wait_for_debugger)                                           \
     code(bool, "color-surface-debug", false, color_surface_debug)                                       \
+    code(float, "fast-forward-speed", 4.f, fast_forward_speed)                                          \
     code(bool, "performance-overlay", false, performance_overlay)                                       \
     code(int, "perfomance-overlay-detail", static_cast<int>(MINIMUM), performance_overlay_detail)       \
     code(int, "perfomance-overlay-position", static_cast<int>(TOP_LEFT), performance_overlay_position)  \
@@ -120,6 +127,7 @@ enum PerfomanceOverleyPosition {
     code(int, "keyboard-gui-toggle-gui", 10, keyboard_gui_toggle_gui)                                   \
     code(int, "keyboard-gui-fullscreen", 68, keyboard_gui_fullscreen)                                   \
     code(int, "keyboard-gui-toggle-touch", 23, keyboard_gui_toggle_touch)                               \
+    code(int, "keyboard-gui-toggle-fast-forward", 43, keyboard_gui_toggle_fast_forward)                 \
     code(std::string, "user-id", std::string{}, user_id)                                                \
     code(bool, "user-auto-connect", false, auto_user_login)                                             \
     code(bool, "dump-textures", false, dump_textures)                                                   \
@@ -34,6 +34,7 @@ struct MemState;
 struct CPUContext;
 struct CPUInterface;
 struct ThreadState;
+struct JitPool;
 
 typedef std::function<void(CPUState &cpu, uint32_t, Address)> CallSVC;
 
@@ -41,11 +42,15 @@ typedef std::function<Address(Address)> GetWatchMemoryAddr;
 typedef std::unique_ptr<CPUState, std::function<void(CPUState *)>> CPUStatePtr;
 typedef std::unique_ptr<CPUInterface> CPUInterfacePtr;
 typedef void *ExclusiveMonitorPtr;
+typedef std::shared_ptr<JitPool> JitPoolPtr;
 
 struct CPUProtocolBase {
     virtual void call_svc(CPUState &cpu, uint32_t svc, Address pc, ThreadState &thread) = 0;
     virtual Address get_watch_memory_addr(Address addr) = 0;
+    // Called after the cpu stopped, protects the watched memory hit in the meantime again
+    virtual void update_watches() = 0;
     virtual ExclusiveMonitorPtr get_exlusive_monitor() = 0;
+    virtual JitPoolPtr get_jit_pool() = 0;
     virtual ~CPUProtocolBase() = default;
 };
 
@@ -108,6 +113,26 @@ struct CPUContext {
     }
 };
 
+struct JitBlock {
+    Address pc;
+    bool thumb;
+    uint32_t core_id;
+};
+
+struct JitPoolStats {
+    size_t live_jits = 0;
+    size_t pooled_jits = 0;
+    size_t translated_blocks = 0;
+    size_t guest_code_size = 0;
+    uint64_t interpreter_fallbacks = 0;
+};
+
+// Instruction the JIT can't translate, run by the interpreter every time it is reached
+struct JitFallbackSite {
+    Address pc;
+    uint64_t count;
+};
+
 enum class CPUBackend {
     Dynarmic,
     Unicorn,
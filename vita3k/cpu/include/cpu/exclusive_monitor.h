@@ -0,0 +1,153 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <mem/util.h> // Address.
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+/*! \brief Global exclusive monitor partitioned by address hash.
+ *
+ * Every reservation granule (a host cache line) hashes to a stripe with its own lock and
+ * generation, so exclusive stores to unrelated addresses never contend. A successful store
+ * bumps the generation of its stripe, which makes the reservations other cores hold on it fail.
+ * Granules sharing a stripe can make a store fail spuriously, like a larger reservation granule
+ * on hardware, guest code retries it.
+ *
+ * The monitor doesn't read or write guest memory itself, the operation given to
+ * do_exclusive_operation compares the value read by the exclusive load and stores the new one.
+ *
+ * It also holds the event register of each core used by WFE. SEV sets it on every core, an exclusive
+ * store only on the cores waiting with a reservation on the stored granule (or without any reservation).
+ */
+class ExclusiveMonitor {
+public:
+    static constexpr Address RESERVATION_GRANULE_SIZE = 64;
+    static constexpr std::size_t DEFAULT_STRIPE_COUNT = 256;
+
+    ExclusiveMonitor(std::size_t max_num_cores, std::size_t stripe_count = DEFAULT_STRIPE_COUNT);
+    ~ExclusiveMonitor();
+
+    ExclusiveMonitor(const ExclusiveMonitor &) = delete;
+    ExclusiveMonitor &operator=(const ExclusiveMonitor &) = delete;
+
+    // Reserve the granule of address for core, done by the exclusive load
+    void mark(std::size_t core_num, Address address);
+
+    // Drop the reservation of core, only the core itself may call it
+    void clear(std::size_t core_num);
+
+    // Granule reserved by core, only the core itself may call it
+    std::optional<Address> get_reservation(std::size_t core_num) const;
+
+    // SEV, sets the event register of every core and wakes the waiting ones
+    void send_event();
+    // Sets the event register of the cores whose last exclusive load is in the range and wakes them
+    void send_event_range(Address start, Address size);
+    // SEVL, sets the event register of core
+    void send_event_local(std::size_t core_num);
+
+    /*! WFE, clears the event register of core if it is set, otherwise waits for an event.
+     * \return false if the timeout expired without any event.
+     */
+    bool wait_for_event(std::size_t core_num, std::chrono::microseconds timeout);
+
+    /*! Run the exclusive store operation if no other core stored to the reserved stripe since mark.
+     * If the core holds a reservation on another granule (overwritten by an access the monitor
+     * can't tell apart from the exclusive load), only the value comparison of the operation guards the store.
+     * \return The result of the operation, false if the reservation was lost.
+     */
+    template <typename Operation>
+    bool do_exclusive_operation(std::size_t core_num, Address address, Operation &&operation) {
+        Reservation &reservation = reservations[core_num];
+        const Address granule = address & ~(RESERVATION_GRANULE_SIZE - 1);
+        const bool reserved = reservation.valid && reservation.granule == granule;
+        Stripe &stripe = get_stripe(granule);
+
+        lock(stripe);
+        const bool lost = reserved && stripe.generation.load(std::memory_order_relaxed) != reservation.generation;
+        const bool result = !lost && operation();
+        if (result)
+            stripe.generation.store(stripe.generation.load(std::memory_order_relaxed) + 1);
+        unlock(stripe);
+
+        reservation.valid = false;
+        waiters[core_num].granule.store(NO_GRANULE, std::memory_order_relaxed);
+        // other cores may be waiting for this store to release a lock
+        if (result && waiter_count.load())
+            wake_store_waiters(core_num, granule);
+        return result;
+    }
+
+private:
+    // Reservation granules are aligned, this isn't one
+    static constexpr Address NO_GRANULE = 1;
+
+    struct alignas(64) Stripe {
+        std::atomic<bool> locked = false;
+        std::atomic<uint32_t> generation = 0;
+    };
+
+    // Only accessed by the thread running the core
+    struct alignas(64) Reservation {
+        Address granule = 0;
+        uint32_t generation = 0;
+        bool valid = false;
+
+        bool local_event = false;
+    };
+
+    // What the other cores need to wake a core
+    struct alignas(64) Waiter {
+        std::mutex mutex;
+        std::condition_variable cond;
+        // event register set by the other cores
+        std::atomic<bool> event = false;
+        std::atomic<bool> waiting = false;
+        // granule of the last exclusive load, NO_GRANULE once the reservation is dropped
+        std::atomic<Address> granule = NO_GRANULE;
+    };
+
+    std::unique_ptr<Stripe[]> stripes;
+    std::unique_ptr<Reservation[]> reservations;
+    std::unique_ptr<Waiter[]> waiters;
+    std::size_t stripe_mask;
+    std::size_t core_count;
+    std::atomic<int> waiter_count = 0;
+
+    Stripe &get_stripe(Address granule) {
+        // Fibonacci hashing spreads neighbouring lines over the stripes
+        const uint32_t hash = static_cast<uint32_t>(granule / RESERVATION_GRANULE_SIZE) * 0x9E3779B9u;
+        return stripes[(hash >> 16) & stripe_mask];
+    }
+
+    static void signal(Waiter &waiter);
+    void wake_store_waiters(std::size_t core_num, Address granule);
+
+    static void lock(Stripe &stripe);
+    static void unlock(Stripe &stripe) {
+        stripe.locked.store(false, std::memory_order_release);
+    }
+};
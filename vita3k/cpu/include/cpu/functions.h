@@ -25,6 +25,7 @@
 #include <cstdint>
 #include <functional>
 #include <stack>
+#include <vector>
 
 CPUStatePtr init_cpu(CPUBackend backend, bool cpu_opt, SceUID thread_id, std::size_t processor_id, MemState &mem, CPUProtocolBase *protocol);
 int run(CPUState &state);
@@ -61,6 +62,18 @@ uint32_t stack_free(CPUState &state, size_t size);
 ExclusiveMonitorPtr new_exclusive_monitor(int max_num_cores);
 void free_exclusive_monitor(ExclusiveMonitorPtr monitor);
 void clear_exclusive(ExclusiveMonitorPtr monitor, std::size_t core_num);
+void set_spin_detection(ExclusiveMonitorPtr monitor, bool enable);
+
+JitPoolPtr new_jit_pool();
+void invalidate_jit_pool(JitPool &pool, Address start, size_t length);
+// Running Jits are rebuilt to check the halt flag after each memory access, for halt_running_cpu
+void set_halt_on_memory_access(JitPool &pool, bool enable);
+// Stops the Jit run by the calling thread after its current memory access, returns false if the thread isn't running one
+bool halt_running_cpu();
+JitPoolStats get_jit_pool_stats(JitPool &pool);
+std::vector<JitBlock> get_jit_pool_blocks(JitPool &pool);
+std::vector<JitFallbackSite> get_jit_fallback_sites(JitPool &pool, size_t max_count);
+void prewarm_jit_pool(const JitPoolPtr &pool, MemState &mem, CPUProtocolBase *protocol, std::size_t processor_id, bool cpu_opt, const std::vector<JitBlock> &blocks);
 
 // Debugging helpers
 std::string disassemble(CPUState &state, uint64_t at, bool thumb, uint16_t *insn_size = nullptr);
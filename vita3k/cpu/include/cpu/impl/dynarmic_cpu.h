@@ -22,17 +22,42 @@
 #include <dynarmic/interface/A32/coprocessor.h>
 #include <dynarmic/interface/exclusive_monitor.h>
 
+#include <cpu/exclusive_monitor.h>
 #include <cpu/functions.h>
 #include <cpu/impl/unicorn_cpu.h>
 
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
 
 class ArmDynarmicCallback;
 class ArmDynarmicCP15;
 
+// Dynarmic locks its monitor for every exclusive access, so each core gets its own one (as processor 0)
+// and the partitioned monitor checks the reservations of the other cores on exclusive stores
+struct DynarmicExclusiveMonitor {
+    ExclusiveMonitor global;
+    std::vector<std::unique_ptr<Dynarmic::ExclusiveMonitor>> local;
+
+    // Park the threads spinning on YIELD or WFE until the polled page is written or an event is sent
+    bool park_spinning_threads = false;
+    // Pages write protected to wake parked threads
+    std::mutex armed_pages_mutex;
+    std::set<Address> armed_pages;
+
+    explicit DynarmicExclusiveMonitor(std::size_t max_num_cores);
+
+    void clear(std::size_t core_num);
+};
+
 class DynarmicCPU : public CPUInterface {
     friend class ArmDynarmicCallback;
+    friend struct JitPool;
 
     UnicornCPU fallback;
     CPUState *parent;
@@ -40,22 +65,39 @@ class DynarmicCPU : public CPUInterface {
     std::unique_ptr<Dynarmic::A32::Jit> jit;
     std::unique_ptr<ArmDynarmicCallback> cb;
     std::shared_ptr<ArmDynarmicCP15> cp15;
-    Dynarmic::ExclusiveMonitor *monitor;
+    DynarmicExclusiveMonitor *monitor;
+    JitPoolPtr jit_pool;
+
+    // Ranges invalidated by other threads, only the thread running a Jit can invalidate it.
+    // Guarded by the Jit pool mutex and applied before the next run.
+    std::vector<std::pair<Address, size_t>> pending_invalidations;
+    std::atomic<bool> invalidation_pending = false;
 
     std::size_t core_id = 0;
 
+    // Hint instruction the thread keeps hitting without leaving the Jit
+    Address spin_pc = 0;
+    int spin_count = 0;
+    std::chrono::steady_clock::time_point last_spin_hint;
+
     bool exit_request = false;
     bool halted = false;
     bool break_ = false;
 
     bool log_mem = false;
     bool log_code = false;
+    // The Jit checks the halt flag after each memory access, so a watchpoint can stop it right after the access
+    bool halt_on_memory_access = false;
     bool cpu_opt;
 
     std::unique_ptr<Dynarmic::A32::Jit> make_jit();
+    void rebuild_jit();
+    void apply_pending_invalidations();
+    void update_jit_config();
+    void handle_spin_hint(Address pc, bool wait_for_event);
 
 public:
-    DynarmicCPU(CPUState *state, std::size_t processor_id, Dynarmic::ExclusiveMonitor *monitor, bool cpu_opt);
+    DynarmicCPU(CPUState *state, std::size_t processor_id, DynarmicExclusiveMonitor *monitor, JitPoolPtr jit_pool, bool cpu_opt);
     ~DynarmicCPU() override;
     int run() override;
     void stop() override;
@@ -99,4 +141,8 @@ public:
 
     std::size_t processor_id() const override;
     void invalidate_jit_cache(Address start, size_t length) override;
+
+    void translate_block(Address pc, bool thumb);
+    // Only sets a flag, safe in the access violation handler
+    void halt_after_memory_access();
 };
@@ -50,6 +50,10 @@ class UnicornCPU : public CPUInterface {
     bool did_break = false;
     bool did_inject = false;
 
+    // Registers last written to or read from Unicorn by sync_context and read_back_context
+    CPUContext synced_context;
+    bool has_synced_context = false;
+
     void log_error_details(uc_err code);
 
     static void intr_hook(uc_engine *uc, uint32_t intno, void *user_data);
@@ -64,6 +68,11 @@ public:
 
     int execute_instructions_no_check(int num);
 
+    // Interpreter fallback of another backend: only write the registers which changed since the last sync
+    void sync_context(const CPUContext &context);
+    // Read all the registers back in a single call, cpsr and fpscr are left as they were synced
+    const CPUContext &read_back_context();
+
     int run() override;
     int step() override;
 
@@ -21,6 +21,8 @@
 #include <cpu/disasm/state.h>
 #include <cpu/functions.h>
 
+#include <atomic>
+
 struct CPUState {
     CPUState() = default;
 
@@ -35,4 +37,9 @@ struct CPUState {
     CPUInterfacePtr cpu;
     bool svc_called;
     uint32_t svc;
+
+    // JIT block translations done by this thread, and how many of them duplicate
+    // a block another thread already translated in its own Jit
+    std::atomic<uint64_t> jit_translations = 0;
+    std::atomic<uint64_t> jit_duplicate_translations = 0;
 };
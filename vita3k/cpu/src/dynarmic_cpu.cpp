@@ -20,12 +20,23 @@
 #include <cpu/impl/dynarmic_cpu.h>
 #include <cpu/impl/interface.h>
 #include <cpu/state.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <optional>
 #include <set>
+#include <thread>
+#include <unordered_map>
+#include <util/align.h>
 #include <util/log.h>
 
+#include <mem/functions.h>
 #include <mem/ptr.h>
 
 #include <dynarmic/frontend/A32/a32_ir_emitter.h>
+#include <dynarmic/frontend/A32/a32_location_descriptor.h>
 
 class ArmDynarmicCP15 : public Dynarmic::A32::Coprocessor {
     uint32_t tpidruro;
@@ -86,12 +97,70 @@ public:
     }
 };
 
+// Jits of the process. Nothing translated is shared: Dynarmic emits host code into a
+// buffer owned by each Jit instance, so every thread translates its own blocks. The pool
+// keeps the Jit of an exited thread warm, keyed by processor id, and hands it to the next
+// thread getting that core number, and all Jits are invalidated from here.
+// Translated blocks are indexed by guest pc and thumb mode for diagnostics, to count the
+// blocks more than one thread translated, along with the core number which translated
+// them first so a warm start can prewarm the pooled Jit of each core with its own blocks.
+struct JitPool {
+    struct PooledJit {
+        std::unique_ptr<Dynarmic::A32::Jit> jit;
+        std::unique_ptr<ArmDynarmicCallback> cb;
+        std::shared_ptr<ArmDynarmicCP15> cp15;
+    };
+
+    std::mutex mutex;
+    std::set<DynarmicCPU *> cpus;
+    std::map<std::size_t, PooledJit> pool;
+
+    struct BlockInfo {
+        uint32_t size;
+        uint32_t core_id;
+    };
+
+    // key is (pc << 1) | thumb
+    std::map<uint64_t, BlockInfo> blocks;
+    size_t guest_code_size = 0;
+
+    // times each pc went through the interpreter fallback
+    std::unordered_map<Address, uint64_t> fallback_sites;
+    uint64_t fallback_count = 0;
+
+    // Applied by each Jit before it runs again
+    std::atomic<bool> halt_on_memory_access = false;
+
+    ~JitPool();
+
+    bool acquire(DynarmicCPU &cpu);
+    void release(DynarmicCPU &cpu);
+
+    // Records a new block along with the size of the one translated before it, returns true if
+    // no other thread translated the block yet
+    bool record_block(Address pc, bool thumb, std::size_t core_id, Address previous_pc, bool previous_thumb, uint32_t previous_size);
+    void record_block_size(Address pc, bool thumb, uint32_t size);
+
+    void invalidate(Address start, size_t length);
+    JitPoolStats stats();
+
+    // Returns true the first time pc falls back
+    bool record_fallback(Address pc);
+};
+
 class ArmDynarmicCallback : public Dynarmic::A32::UserCallbacks {
     friend class DynarmicCPU;
+    friend struct JitPool;
 
     CPUState *parent;
     DynarmicCPU *cpu;
 
+    // block being translated, its size is only recorded with the next one to lock the pool once per block
+    Address translating_block_pc = 0;
+    bool translating_block_thumb = false;
+    bool translating_new_block = false;
+    uint32_t translating_block_size = 0;
+
 public:
     explicit ArmDynarmicCallback(CPUState &parent, DynarmicCPU &cpu)
         : parent(&parent)
@@ -102,7 +171,7 @@ public:
     std::optional<std::uint32_t> MemoryReadCode(Dynarmic::A32::VAddr addr) override {
         if (cpu->log_mem)
             LOG_TRACE("Instruction fetch at address 0x{:X}", addr);
-        return MemoryRead32(addr);
+        return MemoryRead<uint32_t, false>(addr);
     }
 
     static void TraceInstruction(uint64_t self_, uint64_t address, uint64_t is_thumb) {
@@ -118,12 +187,32 @@ public:
     }
 
     void PreCodeTranslationHook(bool is_thumb, Dynarmic::A32::VAddr pc, Dynarmic::A32::IREmitter &ir) override {
+        if (cpu->jit_pool) {
+            const Dynarmic::A32::LocationDescriptor location{ ir.block.Location() };
+            if (location.PC() == pc) {
+                // first instruction of a new block
+                translating_new_block = cpu->jit_pool->record_block(pc, is_thumb, cpu->core_id, translating_block_pc, translating_block_thumb, translating_block_size);
+                translating_block_pc = pc;
+                translating_block_thumb = is_thumb;
+                translating_block_size = 0;
+                parent->jit_translations++;
+                if (!translating_new_block)
+                    parent->jit_duplicate_translations++;
+            }
+            if (translating_new_block) {
+                uint32_t size = 4;
+                if (is_thumb && (*Ptr<uint16_t>(pc).get(*parent->mem) & 0xF800) < 0xE800)
+                    size = 2;
+                translating_block_size += size;
+            }
+        }
         if (cpu->log_code) {
             ir.CallHostFunction(&TraceInstruction, ir.Imm64((uint64_t)this), ir.Imm64(pc), ir.Imm64(is_thumb));
         }
     }
 
-    template <typename T>
+    // Dynarmic does exclusive loads through the same callbacks, every data read marks the global monitor
+    template <typename T, bool mark_exclusive = true>
     T MemoryRead(Dynarmic::A32::VAddr addr) {
         Ptr<T> ptr{ addr };
         if (!ptr || !ptr.valid(*parent->mem) || ptr.address() < parent->mem->page_size) {
@@ -137,6 +226,11 @@ public:
             return 0;
         }
 
+        if constexpr (mark_exclusive) {
+            if (cpu->monitor)
+                cpu->monitor->global.mark(cpu->core_id, addr);
+        }
+
         T ret = *ptr.get(*parent->mem);
         if (cpu->log_mem) {
             LOG_TRACE("Read uint{}_t at address: 0x{:x}, val = 0x{:x}", sizeof(T) * 8, addr, ret);
@@ -210,7 +304,10 @@ public:
             return false;
         }
 
-        auto result = Ptr<T>(addr).atomic_compare_and_swap(*parent->mem, value, expected);
+        const auto store = [&] {
+            return Ptr<T>(addr).atomic_compare_and_swap(*parent->mem, value, expected);
+        };
+        const bool result = cpu->monitor ? cpu->monitor->global.do_exclusive_operation(cpu->core_id, addr, store) : store();
         if (cpu->log_mem) {
             LOG_TRACE("Write uint{}_t at addr: 0x{:x}, val = 0x{:x}, expected = 0x{:x}", sizeof(T) * 8, addr, value, expected);
         }
@@ -237,14 +334,33 @@ public:
         if (cpu->is_thumb_mode())
             addr |= 1;
 
-        CPUContext context = cpu->save_context();
-        context.set_pc(addr);
-        cpu->fallback.load_context(context);
-        cpu->fallback.execute_instructions_no_check(static_cast<int>(num_insts));
-        context = cpu->fallback.save_context();
+        // The fallback keeps its registers between calls, only the ones which changed are written to it
+        CPUContext context;
+        context.cpu_registers = cpu->jit->Regs();
+        memcpy(context.fpu_registers.data(), cpu->jit->ExtRegs().data(), sizeof(context.fpu_registers));
         context.cpsr = cpu->get_cpsr();
         context.fpscr = cpu->get_fpscr();
-        cpu->load_context(context);
+        context.set_pc(addr);
+        cpu->fallback.sync_context(context);
+        cpu->fallback.execute_instructions_no_check(static_cast<int>(num_insts));
+
+        // cpsr and fpscr are kept, Unicorn doesn't handle them
+        const CPUContext &result = cpu->fallback.read_back_context();
+        auto &regs = cpu->jit->Regs();
+        for (size_t i = 0; i < 15; i++) {
+            if (result.cpu_registers[i] != context.cpu_registers[i])
+                regs[i] = result.cpu_registers[i];
+        }
+        cpu->set_pc(result.thumb() ? result.get_pc() | 1 : result.get_pc());
+        if (memcmp(result.fpu_registers.data(), context.fpu_registers.data(), sizeof(context.fpu_registers)))
+            memcpy(cpu->jit->ExtRegs().data(), result.fpu_registers.data(), sizeof(context.fpu_registers));
+    }
+
+    // Logs the instruction the first time it falls back, the same instruction in a loop would flood the log
+    void FallbackUntranslatable(uint32_t pc, const char *reason) {
+        if (!cpu->jit_pool || cpu->jit_pool->record_fallback(pc))
+            LOG_WARN("{} at address 0x{:X}, instruction 0x{:X} ({})", reason, pc, MemoryReadCode(pc).value(), disassemble(*parent, pc, nullptr));
+        InterpreterFallback(pc, 1);
     }
 
     void ExceptionRaised(uint32_t pc, Dynarmic::A32::Exception exception) override {
@@ -266,25 +382,30 @@ public:
         case Dynarmic::A32::Exception::PreloadDataWithIntentToWrite:
         case Dynarmic::A32::Exception::PreloadData:
         case Dynarmic::A32::Exception::PreloadInstruction:
+            break;
         case Dynarmic::A32::Exception::SendEvent:
+            if (cpu->monitor)
+                cpu->monitor->global.send_event();
+            break;
         case Dynarmic::A32::Exception::SendEventLocal:
+            if (cpu->monitor)
+                cpu->monitor->global.send_event_local(cpu->core_id);
+            break;
         case Dynarmic::A32::Exception::WaitForEvent:
+            cpu->handle_spin_hint(pc, true);
             break;
         case Dynarmic::A32::Exception::Yield:
+            cpu->handle_spin_hint(pc, false);
             break;
         case Dynarmic::A32::Exception::UndefinedInstruction:
-            LOG_WARN("Undefined instruction at address 0x{:X}, instruction 0x{:X} ({})", pc, MemoryReadCode(pc).value(), disassemble(*parent, pc, nullptr));
-            InterpreterFallback(pc, 1);
+            FallbackUntranslatable(pc, "Undefined instruction");
             break;
         case Dynarmic::A32::Exception::UnpredictableInstruction:
-            LOG_WARN("Unpredictable instruction at address 0x{:X}, instruction 0x{:X} ({})", pc, MemoryReadCode(pc).value(), disassemble(*parent, pc, nullptr));
-            InterpreterFallback(pc, 1);
+            FallbackUntranslatable(pc, "Unpredictable instruction");
             break;
-        case Dynarmic::A32::Exception::DecodeError: {
-            LOG_WARN("Decode error at address 0x{:X}, instruction 0x{:X} ({})", pc, MemoryReadCode(pc).value(), disassemble(*parent, pc, nullptr));
-            InterpreterFallback(pc, 1);
+        case Dynarmic::A32::Exception::DecodeError:
+            FallbackUntranslatable(pc, "Decode error");
             break;
-        }
         default:
             LOG_WARN("Unknown exception {} Raised at pc = 0x{:x}", static_cast<size_t>(exception), pc);
             LOG_TRACE("at address 0x{:X}, instruction 0x{:X} ({})", pc, MemoryReadCode(pc).value(), disassemble(*parent, pc, nullptr));
@@ -304,6 +425,116 @@ public:
     }
 };
 
+// Times a hint instruction must be hit in a row before the thread is considered spinning
+static constexpr int SPIN_DETECTION_THRESHOLD = 16;
+// Longest time between two of these hits, a loop doing real work between its hints isn't spinning
+static constexpr std::chrono::microseconds SPIN_HINT_WINDOW{ 20 };
+// Longest a spinning thread is parked, in case the value it polls changes without a write it can see
+static constexpr std::chrono::microseconds SPIN_PARK_TIMEOUT{ 1000 };
+
+// Used to stop a Jit running on another thread when its cache needs to be invalidated
+static constexpr Dynarmic::HaltReason INVALIDATION_HALT_REASON = Dynarmic::HaltReason::UserDefined7;
+// Used by the access violation handler to stop the Jit of the faulting thread after the access
+static constexpr Dynarmic::HaltReason MEMORY_ACCESS_HALT_REASON = Dynarmic::HaltReason::UserDefined6;
+
+// Jit run by the calling thread, the access violation handler runs on the faulting thread
+static thread_local DynarmicCPU *running_cpu = nullptr;
+
+static uint64_t block_key(Address pc, bool thumb) {
+    return (static_cast<uint64_t>(pc) << 1) | thumb;
+}
+
+JitPool::~JitPool() = default;
+
+bool JitPool::acquire(DynarmicCPU &cpu) {
+    const std::lock_guard<std::mutex> guard(mutex);
+    cpus.insert(&cpu);
+
+    const auto it = pool.find(cpu.core_id);
+    if (it == pool.end())
+        return false;
+
+    PooledJit &pooled = it->second;
+    pooled.cb->parent = cpu.parent;
+    pooled.cb->cpu = &cpu;
+    cpu.jit = std::move(pooled.jit);
+    cpu.cb = std::move(pooled.cb);
+    cpu.cp15 = std::move(pooled.cp15);
+    pool.erase(it);
+    return true;
+}
+
+void JitPool::release(DynarmicCPU &cpu) {
+    const std::lock_guard<std::mutex> guard(mutex);
+    cpus.erase(&cpu);
+
+    if (cpu.cb && cpu.cb->translating_block_size) {
+        record_block_size(cpu.cb->translating_block_pc, cpu.cb->translating_block_thumb, cpu.cb->translating_block_size);
+        cpu.cb->translating_block_size = 0;
+    }
+
+    // Jits built for code or memory logging use a different config, don't keep them
+    if (!cpu.jit || cpu.log_code || cpu.log_mem || cpu.halt_on_memory_access)
+        return;
+
+    cpu.jit->ClearExclusiveState();
+    pool[cpu.core_id] = PooledJit{ std::move(cpu.jit), std::move(cpu.cb), std::move(cpu.cp15) };
+}
+
+bool JitPool::record_block(Address pc, bool thumb, std::size_t core_id, Address previous_pc, bool previous_thumb, uint32_t previous_size) {
+    const std::lock_guard<std::mutex> guard(mutex);
+    if (previous_size)
+        record_block_size(previous_pc, previous_thumb, previous_size);
+    return blocks.emplace(block_key(pc, thumb), BlockInfo{ 0, static_cast<uint32_t>(core_id) }).second;
+}
+
+// Must be called with the mutex locked
+void JitPool::record_block_size(Address pc, bool thumb, uint32_t size) {
+    const auto it = blocks.find(block_key(pc, thumb));
+    if (it == blocks.end())
+        return;
+
+    it->second.size += size;
+    guest_code_size += size;
+}
+
+void JitPool::invalidate(Address start, size_t length) {
+    const std::lock_guard<std::mutex> guard(mutex);
+    // Queue the range and make running Jits return at the next block boundary so
+    // their thread applies it before executing any more code
+    for (DynarmicCPU *cpu : cpus) {
+        cpu->pending_invalidations.emplace_back(start, length);
+        cpu->invalidation_pending = true;
+        if (cpu->jit)
+            cpu->jit->HaltExecution(INVALIDATION_HALT_REASON);
+    }
+    for (auto &[_, pooled] : pool)
+        pooled.jit->InvalidateCacheRange(start, length);
+
+    const auto first = blocks.lower_bound(block_key(start, false));
+    const auto last = blocks.lower_bound(block_key(start + length, false));
+    for (auto it = first; it != last; ++it)
+        guest_code_size -= it->second.size;
+    blocks.erase(first, last);
+}
+
+JitPoolStats JitPool::stats() {
+    const std::lock_guard<std::mutex> guard(mutex);
+    JitPoolStats stats;
+    stats.live_jits = cpus.size();
+    stats.pooled_jits = pool.size();
+    stats.translated_blocks = blocks.size();
+    stats.guest_code_size = guest_code_size;
+    stats.interpreter_fallbacks = fallback_count;
+    return stats;
+}
+
+bool JitPool::record_fallback(Address pc) {
+    const std::lock_guard<std::mutex> guard(mutex);
+    fallback_count++;
+    return ++fallback_sites[pc] == 1;
+}
+
 std::unique_ptr<Dynarmic::A32::Jit> DynarmicCPU::make_jit() {
     Dynarmic::A32::UserConfig config;
     config.arch_version = Dynarmic::A32::ArchVersion::v7;
@@ -315,27 +546,83 @@ std::unique_ptr<Dynarmic::A32::Jit> DynarmicCPU::make_jit() {
         config.fastmem_pointer = (log_mem || !cpu_opt) ? nullptr : parent->mem->memory.get();
     }
     config.hook_hint_instructions = true;
+    config.check_halt_on_memory_access = halt_on_memory_access;
     config.enable_cycle_counting = false;
-    config.global_monitor = monitor;
+    // Each core has its own Dynarmic monitor, the partitioned one orders the stores of different cores
+    config.global_monitor = monitor ? monitor->local[core_id].get() : nullptr;
     config.coprocessors[15] = cp15;
-    config.processor_id = core_id;
+    config.processor_id = 0;
     config.optimizations = cpu_opt ? Dynarmic::all_safe_optimizations : Dynarmic::no_optimizations;
 
     return std::make_unique<Dynarmic::A32::Jit>(config);
 }
 
-DynarmicCPU::DynarmicCPU(CPUState *state, std::size_t processor_id, Dynarmic::ExclusiveMonitor *monitor, bool cpu_opt)
+DynarmicExclusiveMonitor::DynarmicExclusiveMonitor(std::size_t max_num_cores)
+    : global(max_num_cores) {
+    local.reserve(max_num_cores);
+    for (std::size_t core = 0; core < max_num_cores; core++)
+        local.push_back(std::make_unique<Dynarmic::ExclusiveMonitor>(1));
+}
+
+void DynarmicExclusiveMonitor::clear(std::size_t core_num) {
+    global.clear(core_num);
+    local[core_num]->ClearProcessor(0);
+}
+
+DynarmicCPU::DynarmicCPU(CPUState *state, std::size_t processor_id, DynarmicExclusiveMonitor *monitor, JitPoolPtr jit_pool, bool cpu_opt)
     : fallback(state)
     , parent(state)
-    , cb(std::make_unique<ArmDynarmicCallback>(*state, *this))
-    , cp15(std::make_shared<ArmDynarmicCP15>())
     , monitor(monitor)
+    , jit_pool(std::move(jit_pool))
     , core_id(processor_id)
     , cpu_opt(cpu_opt) {
+    if (this->jit_pool && this->jit_pool->acquire(*this))
+        return;
+
+    cb = std::make_unique<ArmDynarmicCallback>(*state, *this);
+    cp15 = std::make_shared<ArmDynarmicCP15>();
     jit = make_jit();
 }
 
 DynarmicCPU::~DynarmicCPU() {
+    if (jit_pool)
+        jit_pool->release(*this);
+}
+
+void DynarmicCPU::rebuild_jit() {
+    std::unique_ptr<Dynarmic::A32::Jit> new_jit = make_jit();
+    if (jit_pool) {
+        // the pool may be invalidating this jit from another thread
+        const std::lock_guard<std::mutex> guard(jit_pool->mutex);
+        jit.swap(new_jit);
+    } else {
+        jit.swap(new_jit);
+    }
+}
+
+void DynarmicCPU::apply_pending_invalidations() {
+    if (!invalidation_pending)
+        return;
+
+    std::vector<std::pair<Address, size_t>> ranges;
+    {
+        const std::lock_guard<std::mutex> guard(jit_pool->mutex);
+        ranges.swap(pending_invalidations);
+        invalidation_pending = false;
+    }
+    for (const auto &[start, length] : ranges)
+        jit->InvalidateCacheRange(start, length);
+}
+
+// Rebuilds the Jit when the settings shared through the pool changed, keeping the guest context
+void DynarmicCPU::update_jit_config() {
+    if (!jit_pool || jit_pool->halt_on_memory_access == halt_on_memory_access)
+        return;
+
+    halt_on_memory_access = !halt_on_memory_access;
+    const Dynarmic::A32::Context context = jit->SaveContext();
+    rebuild_jit();
+    jit->LoadContext(context);
 }
 
 int DynarmicCPU::run() {
@@ -343,13 +630,71 @@ int DynarmicCPU::run() {
     break_ = false;
     exit_request = false;
     parent->svc_called = false;
+    spin_count = 0;
+    update_jit_config();
+    apply_pending_invalidations();
+    running_cpu = this;
     jit->Run();
+    running_cpu = nullptr;
     return halted;
 }
 
+void DynarmicCPU::handle_spin_hint(Address pc, bool wait_for_event) {
+    if (!monitor || !monitor->park_spinning_threads)
+        return;
+
+    const auto now = std::chrono::steady_clock::now();
+    if (pc != spin_pc || now - last_spin_hint > SPIN_HINT_WINDOW) {
+        spin_pc = pc;
+        spin_count = 0;
+    }
+    last_spin_hint = now;
+    if (++spin_count < SPIN_DETECTION_THRESHOLD)
+        return;
+
+    // the thread has to show it still spins before being parked again
+    spin_count = 0;
+
+    // The exclusive load of the loop tells which address it polls
+    const std::optional<Address> polled = monitor->global.get_reservation(core_id);
+    if (!polled && !wait_for_event) {
+        // nothing to wait for, at least let the other host threads run
+        std::this_thread::yield();
+        return;
+    }
+
+    if (polled) {
+        MemState &mem = *parent->mem;
+        const Address page = align_down(*polled, mem.page_size);
+        bool arm = false;
+        {
+            const std::lock_guard<std::mutex> guard(monitor->armed_pages_mutex);
+            arm = monitor->armed_pages.insert(page).second;
+        }
+        // the protect callback runs with the protect mutex locked, don't hold armed_pages_mutex here
+        if (arm) {
+            add_protect(mem, page, mem.page_size, MemPerm::ReadOnly, [monitor = monitor, page, page_size = mem.page_size](Address, bool) {
+                {
+                    const std::lock_guard<std::mutex> guard(monitor->armed_pages_mutex);
+                    monitor->armed_pages.erase(page);
+                }
+                // only the cores polling this page are woken
+                monitor->global.send_event_range(page, page_size);
+                return true;
+            });
+        }
+    }
+
+    monitor->global.wait_for_event(core_id, SPIN_PARK_TIMEOUT);
+}
+
 int DynarmicCPU::step() {
     parent->svc_called = false;
+    update_jit_config();
+    apply_pending_invalidations();
+    running_cpu = this;
     jit->Step();
+    running_cpu = nullptr;
     return 0;
 }
 
@@ -367,7 +712,7 @@ void DynarmicCPU::set_log_code(bool log) {
         return;
 
     log_code = log;
-    jit = make_jit();
+    rebuild_jit();
 }
 
 void DynarmicCPU::set_log_mem(bool log) {
@@ -375,7 +720,7 @@ void DynarmicCPU::set_log_mem(bool log) {
         return;
 
     log_mem = log;
-    jit = make_jit();
+    rebuild_jit();
 }
 
 bool DynarmicCPU::get_log_code() {
@@ -496,17 +841,100 @@ void DynarmicCPU::invalidate_jit_cache(Address start, size_t length) {
     jit->InvalidateCacheRange(start, length);
 }
 
+void DynarmicCPU::halt_after_memory_access() {
+    jit->HaltExecution(MEMORY_ACCESS_HALT_REASON);
+}
+
+void DynarmicCPU::translate_block(Address pc, bool thumb) {
+    apply_pending_invalidations();
+    set_pc(thumb ? (pc | 1) : pc);
+    // Dynarmic looks up (and compiles if needed) the block at pc, then checks the
+    // halt flag before jumping into it, so the block is translated but not executed
+    jit->HaltExecution();
+    jit->Run();
+}
+
 // TODO: proper abstraction
 ExclusiveMonitorPtr new_exclusive_monitor(int max_num_cores) {
-    return new Dynarmic::ExclusiveMonitor(max_num_cores);
+    return new DynarmicExclusiveMonitor(max_num_cores);
 }
 
 void free_exclusive_monitor(ExclusiveMonitorPtr monitor) {
-    Dynarmic::ExclusiveMonitor *monitor_ = reinterpret_cast<Dynarmic::ExclusiveMonitor *>(monitor);
+    DynarmicExclusiveMonitor *monitor_ = reinterpret_cast<DynarmicExclusiveMonitor *>(monitor);
     delete monitor_;
 }
 
 void clear_exclusive(ExclusiveMonitorPtr monitor, std::size_t core_num) {
-    Dynarmic::ExclusiveMonitor *monitor_ = reinterpret_cast<Dynarmic::ExclusiveMonitor *>(monitor);
-    monitor_->ClearProcessor(core_num);
+    DynarmicExclusiveMonitor *monitor_ = reinterpret_cast<DynarmicExclusiveMonitor *>(monitor);
+    // Only touches the reservation of the core, other cores are not stalled
+    monitor_->clear(core_num);
+}
+
+void set_spin_detection(ExclusiveMonitorPtr monitor, bool enable) {
+    DynarmicExclusiveMonitor *monitor_ = reinterpret_cast<DynarmicExclusiveMonitor *>(monitor);
+    monitor_->park_spinning_threads = enable;
+}
+
+JitPoolPtr new_jit_pool() {
+    return std::make_shared<JitPool>();
+}
+
+void invalidate_jit_pool(JitPool &pool, Address start, size_t length) {
+    pool.invalidate(start, length);
+}
+
+void set_halt_on_memory_access(JitPool &pool, bool enable) {
+    pool.halt_on_memory_access = enable;
+}
+
+bool halt_running_cpu() {
+    if (!running_cpu)
+        return false;
+
+    running_cpu->halt_after_memory_access();
+    return true;
+}
+
+JitPoolStats get_jit_pool_stats(JitPool &pool) {
+    return pool.stats();
+}
+
+std::vector<JitBlock> get_jit_pool_blocks(JitPool &pool) {
+    const std::lock_guard<std::mutex> guard(pool.mutex);
+    std::vector<JitBlock> blocks;
+    blocks.reserve(pool.blocks.size());
+    for (const auto &[key, info] : pool.blocks)
+        blocks.push_back({ static_cast<Address>(key >> 1), static_cast<bool>(key & 1), info.core_id });
+    return blocks;
+}
+
+std::vector<JitFallbackSite> get_jit_fallback_sites(JitPool &pool, size_t max_count) {
+    std::vector<JitFallbackSite> sites;
+    {
+        const std::lock_guard<std::mutex> guard(pool.mutex);
+        sites.reserve(pool.fallback_sites.size());
+        for (const auto &[pc, count] : pool.fallback_sites)
+            sites.push_back({ pc, count });
+    }
+
+    // hottest first
+    const size_t count = std::min(max_count, sites.size());
+    std::partial_sort(sites.begin(), sites.begin() + count, sites.end(), [](const JitFallbackSite &a, const JitFallbackSite &b) {
+        return a.count > b.count;
+    });
+    sites.resize(count);
+    return sites;
+}
+
+void prewarm_jit_pool(const JitPoolPtr &pool, MemState &mem, CPUProtocolBase *protocol, std::size_t processor_id, bool cpu_opt, const std::vector<JitBlock> &blocks) {
+    CPUState state;
+    state.mem = &mem;
+    state.protocol = protocol;
+
+    DynarmicExclusiveMonitor *monitor = reinterpret_cast<DynarmicExclusiveMonitor *>(protocol->get_exlusive_monitor());
+    DynarmicCPU cpu(&state, processor_id, monitor, pool, cpu_opt);
+    for (const JitBlock &block : blocks)
+        cpu.translate_block(block.pc, block.thumb);
+
+    // the destructor of cpu gives the warm jit to the pool
 }
@@ -0,0 +1,131 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <cpu/exclusive_monitor.h>
+
+#include <algorithm>
+#include <thread>
+
+// Spins on a busy stripe before giving the core back to the host scheduler
+constexpr int LOCK_SPIN_COUNT = 64;
+
+ExclusiveMonitor::ExclusiveMonitor(std::size_t max_num_cores, std::size_t stripe_count) {
+    // The hash picks the stripe with a mask
+    std::size_t count = 1;
+    while (count < std::clamp<std::size_t>(stripe_count, 1, 0x10000))
+        count <<= 1;
+
+    stripes = std::make_unique<Stripe[]>(count);
+    reservations = std::make_unique<Reservation[]>(max_num_cores);
+    waiters = std::make_unique<Waiter[]>(max_num_cores);
+    stripe_mask = count - 1;
+    core_count = max_num_cores;
+}
+
+ExclusiveMonitor::~ExclusiveMonitor() = default;
+
+void ExclusiveMonitor::mark(std::size_t core_num, Address address) {
+    Reservation &reservation = reservations[core_num];
+    reservation.granule = address & ~(RESERVATION_GRANULE_SIZE - 1);
+    reservation.generation = get_stripe(reservation.granule).generation.load(std::memory_order_acquire);
+    reservation.valid = true;
+    waiters[core_num].granule.store(reservation.granule, std::memory_order_relaxed);
+}
+
+void ExclusiveMonitor::clear(std::size_t core_num) {
+    reservations[core_num].valid = false;
+    waiters[core_num].granule.store(NO_GRANULE, std::memory_order_relaxed);
+}
+
+std::optional<Address> ExclusiveMonitor::get_reservation(std::size_t core_num) const {
+    const Reservation &reservation = reservations[core_num];
+    if (!reservation.valid)
+        return std::nullopt;
+
+    return reservation.granule;
+}
+
+void ExclusiveMonitor::signal(Waiter &waiter) {
+    bool waiting;
+    {
+        const std::lock_guard<std::mutex> guard(waiter.mutex);
+        waiter.event = true;
+        waiting = waiter.waiting;
+    }
+    if (waiting)
+        waiter.cond.notify_one();
+}
+
+void ExclusiveMonitor::send_event() {
+    for (std::size_t core_num = 0; core_num < core_count; core_num++)
+        signal(waiters[core_num]);
+}
+
+void ExclusiveMonitor::send_event_range(Address start, Address size) {
+    for (std::size_t core_num = 0; core_num < core_count; core_num++) {
+        const Address granule = waiters[core_num].granule.load(std::memory_order_relaxed);
+        if (granule != NO_GRANULE && granule - start < size)
+            signal(waiters[core_num]);
+    }
+}
+
+void ExclusiveMonitor::wake_store_waiters(std::size_t core_num, Address granule) {
+    for (std::size_t other = 0; other < core_count; other++) {
+        Waiter &waiter = waiters[other];
+        if (other == core_num || !waiter.waiting)
+            continue;
+
+        const Address waited = waiter.granule.load(std::memory_order_relaxed);
+        if (waited == granule || waited == NO_GRANULE)
+            signal(waiter);
+    }
+}
+
+void ExclusiveMonitor::send_event_local(std::size_t core_num) {
+    reservations[core_num].local_event = true;
+}
+
+bool ExclusiveMonitor::wait_for_event(std::size_t core_num, std::chrono::microseconds timeout) {
+    Reservation &reservation = reservations[core_num];
+    Waiter &waiter = waiters[core_num];
+    if (reservation.local_event || waiter.event.exchange(false)) {
+        reservation.local_event = false;
+        return true;
+    }
+
+    // A store landing before waiting is published breaks the reservation, which is checked after it.
+    // Both sides use sequentially consistent accesses so at least one of them sees the other.
+    std::unique_lock<std::mutex> lock(waiter.mutex);
+    waiter.waiting = true;
+    waiter_count++;
+    const bool woken = waiter.cond.wait_for(lock, timeout, [&] {
+        return waiter.event || (reservation.valid && get_stripe(reservation.granule).generation.load() != reservation.generation);
+    });
+    waiter_count--;
+    waiter.waiting = false;
+    waiter.event = false;
+    return woken;
+}
+
+void ExclusiveMonitor::lock(Stripe &stripe) {
+    for (int spin = 0;; spin++) {
+        if (!stripe.locked.load(std::memory_order_relaxed) && !stripe.locked.exchange(true, std::memory_order_acquire))
+            return;
+        if (spin >= LOCK_SPIN_COUNT)
+            std::this_thread::yield();
+    }
+}
@@ -21,6 +21,7 @@
 #include <util/log.h>
 
 #include <cassert>
+#include <cstring>
 #include <cpu/disasm/functions.h>
 
 #include <util/string_utils.h>
@@ -370,6 +371,7 @@ CPUContext UnicornCPU::save_context() {
 }
 
 void UnicornCPU::load_context(CPUContext ctx) {
+    has_synced_context = false;
     for (size_t i = 0; i < ctx.fpu_registers.size(); i++) {
         set_float_reg(i, ctx.fpu_registers[i]);
     }
@@ -386,6 +388,70 @@ void UnicornCPU::load_context(CPUContext ctx) {
     set_pc(ctx.thumb() ? ctx.get_pc() | 1 : ctx.get_pc());
 }
 
+// Core registers in CPUContext order
+static constexpr int CORE_REGISTER_IDS[16] = {
+    UC_ARM_REG_R0, UC_ARM_REG_R1, UC_ARM_REG_R2, UC_ARM_REG_R3,
+    UC_ARM_REG_R4, UC_ARM_REG_R5, UC_ARM_REG_R6, UC_ARM_REG_R7,
+    UC_ARM_REG_R8, UC_ARM_REG_R9, UC_ARM_REG_R10, UC_ARM_REG_R11,
+    UC_ARM_REG_R12, UC_ARM_REG_SP, UC_ARM_REG_LR, UC_ARM_REG_PC
+};
+constexpr int DOUBLE_REGISTER_COUNT = 32;
+
+void UnicornCPU::sync_context(const CPUContext &context) {
+    std::array<int, 16 + DOUBLE_REGISTER_COUNT> ids;
+    std::array<void *, 16 + DOUBLE_REGISTER_COUNT> values;
+    int count = 0;
+
+    CPUContext &synced = synced_context;
+    for (int i = 0; i < 15; i++) {
+        if (has_synced_context && synced.cpu_registers[i] == context.cpu_registers[i])
+            continue;
+        synced.cpu_registers[i] = context.cpu_registers[i];
+        ids[count] = CORE_REGISTER_IDS[i];
+        values[count++] = &synced.cpu_registers[i];
+    }
+
+    for (int i = 0; i < DOUBLE_REGISTER_COUNT; i++) {
+        // compare the bits, NaN never equals itself
+        if (has_synced_context && !memcmp(&synced.fpu_registers[i * 2], &context.fpu_registers[i * 2], sizeof(DoubleReg)))
+            continue;
+        memcpy(&synced.fpu_registers[i * 2], &context.fpu_registers[i * 2], sizeof(DoubleReg));
+        ids[count] = UC_ARM_REG_D0 + i;
+        values[count++] = &synced.fpu_registers[i * 2];
+    }
+
+    // writing the pc with the thumb bit is what switches the mode
+    synced.cpsr = context.cpsr;
+    synced.fpscr = context.fpscr;
+    synced.cpu_registers[15] = context.get_pc() | (context.thumb() ? 1 : 0);
+    ids[count] = UC_ARM_REG_PC;
+    values[count++] = &synced.cpu_registers[15];
+
+    const uc_err err = uc_reg_write_batch(uc.get(), ids.data(), values.data(), count);
+    assert(err == UC_ERR_OK);
+    synced.cpu_registers[15] = context.get_pc();
+    has_synced_context = true;
+}
+
+const CPUContext &UnicornCPU::read_back_context() {
+    std::array<int, 16 + DOUBLE_REGISTER_COUNT> ids;
+    std::array<void *, 16 + DOUBLE_REGISTER_COUNT> values;
+    for (int i = 0; i < 16; i++) {
+        ids[i] = CORE_REGISTER_IDS[i];
+        values[i] = &synced_context.cpu_registers[i];
+    }
+    for (int i = 0; i < DOUBLE_REGISTER_COUNT; i++) {
+        ids[16 + i] = UC_ARM_REG_D0 + i;
+        values[16 + i] = &synced_context.fpu_registers[i * 2];
+    }
+
+    const uc_err err = uc_reg_read_batch(uc.get(), ids.data(), values.data(), static_cast<int>(ids.size()));
+    assert(err == UC_ERR_OK);
+    synced_context.set_pc(is_thumb_mode() ? synced_context.get_pc() | 1 : synced_context.get_pc());
+
+    return synced_context;
+}
+
 bool UnicornCPU::hit_breakpoint() {
     return did_break;
 }
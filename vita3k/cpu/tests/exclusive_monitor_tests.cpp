@@ -0,0 +1,183 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <cpu/exclusive_monitor.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Emulates LDREX / ADD / STREX on a word of fake guest memory, retrying until the store succeeds
+static void exclusive_increment(ExclusiveMonitor &monitor, std::size_t core_num, std::atomic<uint32_t> &word, Address address) {
+    for (;;) {
+        uint32_t expected = word.load();
+        monitor.mark(core_num, address);
+        const bool stored = monitor.do_exclusive_operation(core_num, address, [&] {
+            return word.compare_exchange_strong(expected, expected + 1);
+        });
+        if (stored)
+            return;
+    }
+}
+
+TEST(exclusive_monitor, store_without_conflict) {
+    ExclusiveMonitor monitor(2);
+    monitor.mark(0, 0x81000000);
+    ASSERT_TRUE(monitor.do_exclusive_operation(0, 0x81000000, [] { return true; }));
+}
+
+TEST(exclusive_monitor, store_clears_reservation) {
+    ExclusiveMonitor monitor(2);
+    monitor.mark(0, 0x81000000);
+    ASSERT_TRUE(monitor.do_exclusive_operation(0, 0x81000000, [] { return true; }));
+
+    // a second store without exclusive load only depends on the operation
+    ASSERT_FALSE(monitor.do_exclusive_operation(0, 0x81000000, [] { return false; }));
+}
+
+TEST(exclusive_monitor, other_core_store_breaks_reservation) {
+    ExclusiveMonitor monitor(2);
+    monitor.mark(0, 0x81000004);
+    monitor.mark(1, 0x81000000);
+    ASSERT_TRUE(monitor.do_exclusive_operation(1, 0x81000000, [] { return true; }));
+
+    // same reservation granule, the store of core 1 must make core 0 fail even if the value matches
+    bool ran = false;
+    ASSERT_FALSE(monitor.do_exclusive_operation(0, 0x81000004, [&] { return ran = true; }));
+    ASSERT_FALSE(ran);
+}
+
+TEST(exclusive_monitor, failed_store_keeps_other_reservations) {
+    ExclusiveMonitor monitor(2);
+    monitor.mark(0, 0x81000000);
+    monitor.mark(1, 0x81000000);
+    ASSERT_FALSE(monitor.do_exclusive_operation(1, 0x81000000, [] { return false; }));
+    ASSERT_TRUE(monitor.do_exclusive_operation(0, 0x81000000, [] { return true; }));
+}
+
+TEST(exclusive_monitor, contended_increments_are_not_lost) {
+    constexpr int thread_count = 8;
+    constexpr int increments = 20000;
+
+    ExclusiveMonitor monitor(thread_count);
+    std::atomic<uint32_t> word = 0;
+    std::vector<std::thread> threads;
+    for (int core = 0; core < thread_count; core++) {
+        threads.emplace_back([&, core] {
+            for (int i = 0; i < increments; i++)
+                exclusive_increment(monitor, core, word, 0x81000000);
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+
+    ASSERT_EQ(word.load(), thread_count * increments);
+}
+
+TEST(exclusive_monitor, wait_for_event_consumes_pending_event) {
+    ExclusiveMonitor monitor(2);
+    monitor.send_event();
+    ASSERT_TRUE(monitor.wait_for_event(0, std::chrono::microseconds(0)));
+    ASSERT_FALSE(monitor.wait_for_event(0, std::chrono::microseconds(100)));
+
+    monitor.send_event_local(1);
+    ASSERT_TRUE(monitor.wait_for_event(1, std::chrono::microseconds(0)));
+}
+
+TEST(exclusive_monitor, exclusive_store_wakes_waiting_core) {
+    ExclusiveMonitor monitor(2);
+    std::atomic<uint32_t> lock = 1;
+
+    std::thread owner([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        monitor.mark(1, 0x81000000);
+        uint32_t expected = 1;
+        monitor.do_exclusive_operation(1, 0x81000000, [&] { return lock.compare_exchange_strong(expected, 0); });
+    });
+
+    // the timeout is only there for the test not to hang, the store must wake the core before
+    while (lock != 0)
+        ASSERT_TRUE(monitor.wait_for_event(0, std::chrono::seconds(10)));
+    owner.join();
+}
+
+TEST(exclusive_monitor, store_only_wakes_cores_waiting_on_its_granule) {
+    ExclusiveMonitor monitor(3);
+    monitor.mark(0, 0x81000000);
+    monitor.mark(1, 0x81001000);
+
+    monitor.mark(2, 0x81001000);
+    ASSERT_TRUE(monitor.do_exclusive_operation(2, 0x81001000, [] { return true; }));
+    ASSERT_FALSE(monitor.wait_for_event(0, std::chrono::microseconds(100)));
+    ASSERT_TRUE(monitor.wait_for_event(1, std::chrono::microseconds(0)));
+
+    // a plain write to the polled page wakes the cores whose reservation is in it
+    monitor.clear(1);
+    monitor.send_event_range(0x81000000, 0x1000);
+    ASSERT_TRUE(monitor.wait_for_event(0, std::chrono::microseconds(0)));
+    ASSERT_FALSE(monitor.wait_for_event(1, std::chrono::microseconds(100)));
+}
+
+// Each thread increments its own cache line, which only contend in the monitor
+static double measure_store_throughput(std::size_t stripe_count, int thread_count) {
+    constexpr int increments = 200000;
+
+    struct alignas(64) Line {
+        std::atomic<uint32_t> word = 0;
+    };
+
+    ExclusiveMonitor monitor(thread_count, stripe_count);
+    std::vector<Line> lines(thread_count);
+    std::vector<std::thread> threads;
+    std::atomic<bool> start = false;
+
+    for (int core = 0; core < thread_count; core++) {
+        threads.emplace_back([&, core] {
+            while (!start)
+                std::this_thread::yield();
+            const Address address = 0x81000000 + core * ExclusiveMonitor::RESERVATION_GRANULE_SIZE;
+            for (int i = 0; i < increments; i++)
+                exclusive_increment(monitor, core, lines[core].word, address);
+        });
+    }
+
+    const auto begin = std::chrono::steady_clock::now();
+    start = true;
+    for (std::thread &thread : threads)
+        thread.join();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+    for (const Line &line : lines)
+        EXPECT_EQ(line.word.load(), increments);
+
+    return thread_count * increments / elapsed.count();
+}
+
+// Prints timings without checking anything, run it with --gtest_also_run_disabled_tests
+TEST(exclusive_monitor, DISABLED_benchmark_store_throughput) {
+    for (const int thread_count : { 1, 2, 4, 8 }) {
+        // a single stripe behaves like one lock for the whole address space
+        const double single = measure_store_throughput(1, thread_count);
+        const double partitioned = measure_store_throughput(ExclusiveMonitor::DEFAULT_STRIPE_COUNT, thread_count);
+        std::printf("%d thread(s): single lock %.2f Mstores/s, partitioned %.2f Mstores/s\n",
+            thread_count, single / 1e6, partitioned / 1e6);
+    }
+}
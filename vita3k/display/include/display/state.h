@@ -18,6 +18,8 @@
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
+#include <display/vblank_pacer.h>
 #include <kernel/callback.h>
 #include <mem/ptr.h>
 #include <memory>
@@ -50,6 +52,7 @@ struct DisplayState {
     DisplayFrameInfo frame;
     std::mutex display_info_mutex;
     bool has_next_frame = false;
+    std::condition_variable next_frame_cond; // notified when has_next_frame is set
     DisplayFrameInfo next_frame;
     std::mutex mutex;
     std::unique_ptr<std::thread> vblank_thread;
@@ -57,6 +60,9 @@ struct DisplayState {
     std::atomic<bool> imgui_render{ true };
     std::atomic<bool> fullscreen{ false };
     std::atomic<std::uint64_t> vblank_count{ 0 };
+    // speed multiplier of the vblanks, 0 to run as fast as possible
+    std::atomic<float> speed{ 1.0f };
+    VblankJitterStats vblank_jitter;
     std::vector<DisplayStateVBlankWaitInfo> vblank_wait_infos;
     std::uint64_t last_setframe_vblank_count = 0;
     std::map<SceUID, CallbackPtr> vblank_callbacks{};
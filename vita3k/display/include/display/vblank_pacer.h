@@ -0,0 +1,69 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+struct VblankJitterStats {
+    // inclusive upper bounds of the buckets of the histogram in us, the last bucket holds the later vblanks
+    static constexpr std::array<uint32_t, 7> BUCKET_LIMITS = { 10, 25, 50, 100, 250, 500, 1000 };
+    static constexpr size_t BUCKET_COUNT = BUCKET_LIMITS.size() + 1;
+
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> histogram{};
+    std::atomic<uint64_t> count = 0;
+    std::atomic<uint64_t> total_us = 0;
+    std::atomic<uint64_t> max_us = 0;
+    std::atomic<uint64_t> resyncs = 0; // times the pacer was too late and restarted from the current time
+
+    void add(uint64_t jitter_us);
+    void reset();
+};
+
+/*! \brief Paces the vblanks on a steady cadence.
+ *
+ * Vblank n is due at epoch + n * period, so errors of a sleep don't add up from one frame to the next.
+ * The pacer sleeps until SPIN_TIME before the vblank, a sleep can overshoot by a scheduler tick, and
+ * spins for the rest. When it falls more than MAX_LATE_VBLANKS behind, it starts again from the current
+ * time instead of running the missed vblanks back to back.
+ * When fast-forwarding, the period is divided by the speed, counted from the vblank the speed changed at.
+ */
+class VblankPacer {
+public:
+    static constexpr std::chrono::microseconds SPIN_TIME{ 300 };
+    static constexpr int MAX_LATE_VBLANKS = 3;
+
+    VblankPacer(std::chrono::nanoseconds period, VblankJitterStats &stats);
+
+    void wait_next_vblank();
+    void set_speed(float speed);
+    std::chrono::nanoseconds get_period() const { return period; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    const std::chrono::nanoseconds base_period;
+    float speed = 1.0f;
+    std::chrono::nanoseconds period;
+    Clock::time_point epoch;
+    uint64_t vblank = 0;
+
+    VblankJitterStats &stats;
+};
@@ -22,6 +22,7 @@
 #include <emuenv/state.h>
 #include <kernel/state.h>
 #include <renderer/state.h>
+#include <rtc/guest_clock.h>
 
 #include <chrono>
 #include <motion/functions.h>
@@ -31,10 +32,11 @@
 // Code heavily influenced by PPSSSPP's SceDisplay.cpp
 
 static constexpr int TARGET_FPS = 60;
-static constexpr int64_t TARGET_MICRO_PER_FRAME = 1000000LL / TARGET_FPS;
+static constexpr int64_t TARGET_NANO_PER_FRAME = 1000000000LL / TARGET_FPS;
 
 static void vblank_sync_thread(EmuEnvState &emuenv) {
     DisplayState &display = emuenv.display;
+    VblankPacer pacer(std::chrono::nanoseconds(TARGET_NANO_PER_FRAME), display.vblank_jitter);
 
     while (!display.abort.load()) {
         {
@@ -73,9 +75,18 @@ static void vblank_sync_thread(EmuEnvState &emuenv) {
                 }
             }
         }
-        const auto time_ms = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-        const auto time_left = TARGET_MICRO_PER_FRAME - (time_ms % TARGET_MICRO_PER_FRAME);
-        std::this_thread::sleep_for(std::chrono::microseconds(time_left));
+
+        const float speed = display.speed.load();
+        pacer.set_speed(speed);
+        if (speed > 0) {
+            pacer.wait_next_vblank();
+        } else {
+            // as fast as possible, the next vblank is as soon as the game sets a new frame
+            std::unique_lock<std::mutex> lock(display.display_info_mutex);
+            display.next_frame_cond.wait_for(lock, pacer.get_period(), [&] { return display.has_next_frame || display.abort.load(); });
+        }
+        // when running as fast as possible, the vblanks move the guest clock
+        guest_clock().vblank(std::chrono::duration_cast<std::chrono::microseconds>(pacer.get_period()));
     }
 }
 
@@ -0,0 +1,79 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <display/vblank_pacer.h>
+
+#include <algorithm>
+#include <thread>
+
+void VblankJitterStats::add(uint64_t jitter_us) {
+    const auto bucket = std::lower_bound(BUCKET_LIMITS.begin(), BUCKET_LIMITS.end(), jitter_us);
+    histogram[bucket - BUCKET_LIMITS.begin()]++;
+    count++;
+    total_us += jitter_us;
+    uint64_t max = max_us.load();
+    while (jitter_us > max && !max_us.compare_exchange_weak(max, jitter_us)) {
+    }
+}
+
+void VblankJitterStats::reset() {
+    for (auto &bucket : histogram)
+        bucket = 0;
+    count = 0;
+    total_us = 0;
+    max_us = 0;
+    resyncs = 0;
+}
+
+VblankPacer::VblankPacer(std::chrono::nanoseconds period, VblankJitterStats &stats)
+    : base_period(period)
+    , period(period)
+    , epoch(Clock::now())
+    , stats(stats) {
+}
+
+void VblankPacer::wait_next_vblank() {
+    vblank++;
+    const Clock::time_point target = epoch + static_cast<int64_t>(vblank) * period;
+
+    Clock::time_point now = Clock::now();
+    if (now > target + MAX_LATE_VBLANKS * period) {
+        // the emulator was paused or stalled, don't catch up
+        stats.resyncs++;
+        epoch = now;
+        vblank = 0;
+        return;
+    }
+
+    if (now < target - SPIN_TIME)
+        std::this_thread::sleep_until(target - SPIN_TIME);
+    while ((now = Clock::now()) < target)
+        std::this_thread::yield();
+
+    stats.add(std::chrono::duration_cast<std::chrono::microseconds>(now - target).count());
+}
+
+void VblankPacer::set_speed(float new_speed) {
+    if (new_speed == speed)
+        return;
+
+    speed = new_speed;
+    // as fast as possible, the period only bounds the wait for a new frame
+    period = speed > 0 ? std::chrono::duration_cast<std::chrono::nanoseconds>(base_period / speed) : base_period;
+    epoch = Clock::now();
+    vblank = 0;
+}
@@ -153,6 +153,8 @@ struct DebugMenuState {
     bool allocations_dialog = false;
     bool memory_editor_dialog = false;
     bool disassembly_dialog = false;
+    bool profiler_dialog = false;
+    bool save_states_dialog = false;
 };
 
 struct ConfigurationMenuState {
@@ -18,6 +18,8 @@
 #include "private.h"
 
 #include <cpu/functions.h>
+#include <util/fs.h>
+#include <util/log.h>
 
 // Disable warninig here is needed to compile on windows because we
 // are turning some warnings into errors to allow makepkg default flags
@@ -28,6 +30,9 @@
 
 #include <spdlog/fmt/fmt.h>
 
+#include <algorithm>
+#include <ctime>
+
 namespace gui {
 
 const char *blacklist[] = {
@@ -35,8 +40,118 @@ const char *blacklist[] = {
     "export_sceGxmDisplayQueueAddEntry"
 };
 
+static bool save_csv(const fs::path &path, const std::string &csv) {
+    if (!fs::exists(path.parent_path()))
+        fs::create_directories(path.parent_path());
+
+    fs::ofstream file(path, std::ios::out | std::ios::binary);
+    if (!file.is_open()) {
+        LOG_ERROR("Failed to save allocations to {}", path.string());
+        return false;
+    }
+    file << csv;
+    return true;
+}
+
+static void draw_allocation_tracker(EmuEnvState &emuenv) {
+    static std::string last_saved_path;
+
+    AllocationTracker &tracker = emuenv.mem.allocation_tracker;
+    bool enabled = tracker.is_enabled();
+    if (ImGui::Checkbox("Track allocations", &enabled))
+        tracker.set_enabled(enabled);
+    if (ImGui::IsItemHovered())
+        ImGui::SetTooltip("Record the allocations made from now on, with their name, size and thread.");
+    ImGui::SameLine();
+    if (ImGui::Button("Reset"))
+        tracker.reset();
+    ImGui::SameLine();
+    if (ImGui::Button("Export CSV")) {
+        const auto title = emuenv.io.title_id.empty() ? std::string("system") : emuenv.io.title_id;
+        const auto base_name{ fs::path(emuenv.base_path) / "allocations" / fmt::format("{}-{}", title, std::time(nullptr)) };
+        if (save_csv(base_name.string() + "-events.csv", tracker.get_events_csv()) && save_csv(base_name.string() + "-summary.csv", tracker.get_summary_csv()))
+            last_saved_path = base_name.string() + "-*.csv";
+    }
+    if (!last_saved_path.empty())
+        ImGui::TextWrapped("Saved to %s", last_saved_path.c_str());
+
+    ImGui::Text("Tracked: %.1f MiB, peak %.1f MiB", tracker.get_current_size() / static_cast<float>(MiB(1)), tracker.get_peak_size() / static_cast<float>(MiB(1)));
+
+    const std::vector<AllocationUsageSample> history = tracker.get_usage_history();
+    if (!history.empty()) {
+        std::vector<float> current, peak;
+        for (const AllocationUsageSample &sample : history) {
+            current.push_back(sample.current_size / static_cast<float>(MiB(1)));
+            peak.push_back(sample.peak_size / static_cast<float>(MiB(1)));
+        }
+        const float scale_max = *std::max_element(peak.begin(), peak.end()) * 1.1f;
+        ImGui::PlotLines("Current (MiB)", current.data(), static_cast<int>(current.size()), 0, nullptr, 0.f, scale_max, ImVec2(0, 60.f));
+        ImGui::PlotLines("Peak (MiB)", peak.data(), static_cast<int>(peak.size()), 0, nullptr, 0.f, scale_max, ImVec2(0, 60.f));
+    }
+
+    std::vector<AllocationCategoryStats> categories = tracker.get_category_stats();
+    std::sort(categories.begin(), categories.end(), [](const AllocationCategoryStats &a, const AllocationCategoryStats &b) {
+        return a.current_size > b.current_size;
+    });
+    if (!categories.empty() && ImGui::BeginTable("allocation_categories", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY, ImVec2(0, 200.f))) {
+        ImGui::TableSetupColumn("Name");
+        ImGui::TableSetupColumn("Live");
+        ImGui::TableSetupColumn("Current (KiB)");
+        ImGui::TableSetupColumn("Peak (KiB)");
+        ImGui::TableSetupColumn("Allocations");
+        ImGui::TableHeadersRow();
+        for (const AllocationCategoryStats &stats : categories) {
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::TextUnformatted(stats.name.c_str());
+            if (ImGui::IsItemHovered()) {
+                // the sizes histogram
+                std::string histogram;
+                for (size_t bucket = 0; bucket < ALLOCATION_SIZE_BUCKET_COUNT; bucket++) {
+                    if (stats.size_histogram[bucket])
+                        histogram += fmt::format("<= {} KiB: {}\n", KiB(4) << bucket >> 10, stats.size_histogram[bucket]);
+                }
+                ImGui::SetTooltip("%s", histogram.c_str());
+            }
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%u", stats.live_count);
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Text("%llu", static_cast<unsigned long long>(stats.current_size / KiB(1)));
+            ImGui::TableSetColumnIndex(3);
+            ImGui::Text("%llu", static_cast<unsigned long long>(stats.peak_size / KiB(1)));
+            ImGui::TableSetColumnIndex(4);
+            ImGui::Text("%llu", static_cast<unsigned long long>(stats.alloc_count));
+        }
+        ImGui::EndTable();
+    }
+}
+
 void draw_allocations_dialog(GuiState &gui, EmuEnvState &emuenv) {
-    ImGui::Begin("Memory Allocations", &gui.debug_menu.allocations_dialog);
+    // nothing is gathered while the window is collapsed
+    if (!ImGui::Begin("Memory Allocations", &gui.debug_menu.allocations_dialog)) {
+        ImGui::End();
+        return;
+    }
+
+    ImGui::Text("Write tracking: %s, %llu access violations, %llu userfaultfd faults",
+        emuenv.mem.write_tracking == WriteTracking::Userfaultfd ? "userfaultfd" : "mprotect",
+        static_cast<unsigned long long>(emuenv.mem.access_violation_count.load()),
+        static_cast<unsigned long long>(emuenv.mem.userfaultfd_fault_count.load()));
+
+    // checking the allocated memory is slow, refresh it once per second while the dialog is shown
+    static MemResidency residency;
+    static double last_residency_time = -1.0;
+    if (last_residency_time < 0.0 || ImGui::GetTime() - last_residency_time >= 1.0) {
+        residency = get_residency(emuenv.mem);
+        last_residency_time = ImGui::GetTime();
+    }
+    ImGui::Text("Allocated: %llu MiB%s", static_cast<unsigned long long>(residency.allocated / MiB(1)), emuenv.mem.use_huge_pages ? " (huge pages)" : "");
+    if (residency.resident_available)
+        ImGui::Text("Resident: %llu MiB, %llu MiB in huge pages", static_cast<unsigned long long>(residency.resident / MiB(1)), static_cast<unsigned long long>(residency.huge_pages / MiB(1)));
+    ImGui::Separator();
+
+    draw_allocation_tracker(emuenv);
+    ImGui::Separator();
 
     const std::lock_guard<std::mutex> lock(emuenv.mem.generation_mutex);
     for (const auto &pair : emuenv.mem.page_name_map) {
@@ -27,7 +27,7 @@ void draw_event_flags_dialog(GuiState &gui, EmuEnvState &emuenv) {
 
     const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
 
-    for (const auto &event : emuenv.kernel.eventflags) {
+    for (const auto &event : emuenv.kernel.eventflags.get_all()) {
         std::shared_ptr<EventFlag> event_state = event.second;
         ImGui::TextColored(GUI_COLOR_TEXT, "0x%08X       %-32s  %02d        %01d         %02zu                 ",
             event.first,
@@ -836,6 +836,10 @@ void draw_ui(GuiState &gui, EmuEnvState &emuenv) {
         draw_allocations_dialog(gui, emuenv);
     if (gui.debug_menu.disassembly_dialog)
         draw_disassembly_dialog(gui, emuenv);
+    if (gui.debug_menu.profiler_dialog)
+        draw_profiler_dialog(gui, emuenv);
+    if (gui.debug_menu.save_states_dialog)
+        draw_save_states_dialog(gui, emuenv);
 
     if (gui.configuration_menu.custom_settings_dialog || gui.configuration_menu.settings_dialog)
         draw_settings_dialog(gui, emuenv);
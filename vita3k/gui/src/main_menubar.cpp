@@ -72,6 +72,8 @@ static void draw_debug_menu(DebugMenuState &state) {
         ImGui::MenuItem("Event Flags", nullptr, &state.eventflags_dialog);
         ImGui::MenuItem("Memory Allocations", nullptr, &state.allocations_dialog);
         ImGui::MenuItem("Disassembly", nullptr, &state.disassembly_dialog);
+        ImGui::MenuItem("Profiler", nullptr, &state.profiler_dialog);
+        ImGui::MenuItem("Save States", nullptr, &state.save_states_dialog);
         ImGui::EndMenu();
     }
 }
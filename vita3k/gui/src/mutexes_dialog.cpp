@@ -30,7 +30,7 @@ void draw_mutexes_dialog(GuiState &gui, EmuEnvState &emuenv) {
 
     const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
 
-    for (const auto &mutex : emuenv.kernel.mutexes) {
+    for (const auto &mutex : emuenv.kernel.mutexes.get_all()) {
         std::shared_ptr<Mutex> mutex_state = mutex.second;
         ImGui::TextColored(GUI_COLOR_TEXT, "0x%08X       %-32s   %02d        %01d            %02zu                 %s",
             mutex.first,
@@ -45,19 +45,26 @@ void draw_mutexes_dialog(GuiState &gui, EmuEnvState &emuenv) {
 
 void draw_lw_mutexes_dialog(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::Begin("Lightweight Mutexes", &gui.debug_menu.lwmutexes_dialog);
-    ImGui::TextColored(GUI_COLOR_TEXT_TITLE, "%-16s %-32s   %-7s   %-8s  %-16s   %-16s", "ID", "LwMutex Name", "Status", "Attributes", "Waiting Threads", "Owner");
+    const LwMutexStats &stats = emuenv.kernel.lwmutex_stats;
+    ImGui::TextColored(GUI_COLOR_TEXT, "Acquisitions: %llu uncontended, %llu contended",
+        static_cast<unsigned long long>(stats.uncontended.load()), static_cast<unsigned long long>(stats.contended.load()));
+    ImGui::TextColored(GUI_COLOR_TEXT_TITLE, "%-16s %-32s   %-7s   %-8s  %-16s   %-10s   %-16s", "ID", "LwMutex Name", "Status", "Attributes", "Waiting Threads", "Contended", "Owner");
 
     const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
 
-    for (const auto &mutex : emuenv.kernel.lwmutexes) {
+    for (const auto &mutex : emuenv.kernel.lwmutexes.get_all()) {
         std::shared_ptr<Mutex> mutex_state = mutex.second;
-        ImGui::TextColored(GUI_COLOR_TEXT, "0x%08X       %-32s   %02d        %01d           %02zu                 %s",
+        // The lock state of lightweight mutexes is kept in the guest workarea
+        const SceKernelLwMutexWork *workarea = mutex_state->workarea.get(emuenv.mem);
+        const auto owner = emuenv.kernel.threads.find(lwmutex_owner(*workarea));
+        ImGui::TextColored(GUI_COLOR_TEXT, "0x%08X       %-32s   %02u        %01d           %02zu                 %-10llu   %s",
             mutex.first,
             mutex_state->name,
-            mutex_state->lock_count,
+            workarea->lockCount,
             mutex_state->attr,
             mutex_state->waiting_threads->size(),
-            mutex_state->owner == nullptr ? "not owned" : mutex_state->owner->name.c_str());
+            static_cast<unsigned long long>(mutex_state->contended_count),
+            owner == emuenv.kernel.threads.end() ? "not owned" : owner->second->name.c_str());
     }
     ImGui::End();
 }
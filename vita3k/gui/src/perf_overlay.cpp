@@ -18,6 +18,9 @@
 #include "private.h"
 
 #include <config/state.h>
+#include <display/state.h>
+
+#include <spdlog/fmt/fmt.h>
 
 namespace gui {
 static const ImVec2 PERF_OVERLAY_PAD = ImVec2(12.f, 12.f);
@@ -45,7 +48,7 @@ static ImVec2 get_perf_pos(ImVec2 window_size, EmuEnvState &emuenv) {
 
 static float get_perf_height(EmuEnvState &emuenv) {
     switch (emuenv.cfg.performance_overlay_detail) {
-    case MAXIMUM: return 138.f;
+    case MAXIMUM: return 196.f;
     case MEDIUM: return 80.f;
     case LOW:
     case MINIMUM:
@@ -80,6 +83,11 @@ void draw_perf_overlay(GuiState &gui, EmuEnvState &emuenv) {
         ImGui::Text("FPS: %d", emuenv.fps);
     else
         ImGui::Text("FPS: %d %s: %d", emuenv.fps, lang["avg"].c_str(), emuenv.avg_fps);
+    // fast-forward speed, next to the fps it explains
+    if (const float speed = emuenv.display.speed; speed != 1.0f) {
+        ImGui::SameLine();
+        ImGui::TextColored(GUI_COLOR_TEXT_TITLE, ">>%s", speed > 0 ? fmt::format("x{}", speed).c_str() : lang["unlimited"].c_str());
+    }
     if (emuenv.cfg.performance_overlay_detail >= PerfomanceOverleyDetail::MEDIUM) {
         ImGui::Separator();
         ImGui::Text("%s: %d %s: %d", lang["min"].c_str(), emuenv.min_fps, lang["max"].c_str(), emuenv.max_fps);
@@ -91,6 +99,15 @@ void draw_perf_overlay(GuiState &gui, EmuEnvState &emuenv) {
     if (emuenv.cfg.performance_overlay_detail == PerfomanceOverleyDetail::MAXIMUM) {
         ImGui::SetCursorPosY(ImGui::GetCursorPosY() - (5.f * SCALE.y));
         ImGui::PlotLines("##fps_graphic", emuenv.fps_values, IM_ARRAYSIZE(emuenv.fps_values), emuenv.current_fps_offset, nullptr, 0.f, float(emuenv.max_fps), WINDOW_SIZE);
+
+        // how late the vblanks are, from <= 10 us on the left to > 1 ms on the right
+        const VblankJitterStats &jitter = emuenv.display.vblank_jitter;
+        float histogram[VblankJitterStats::BUCKET_COUNT];
+        for (size_t i = 0; i < VblankJitterStats::BUCKET_COUNT; i++)
+            histogram[i] = static_cast<float>(jitter.histogram[i].load());
+        const uint64_t count = jitter.count;
+        const std::string overlay = fmt::format("{}: {} us", lang["vblank_jitter"], count ? jitter.total_us / count : 0);
+        ImGui::PlotHistogram("##vblank_jitter", histogram, VblankJitterStats::BUCKET_COUNT, 0, overlay.c_str(), 0.f, FLT_MAX, ImVec2(WINDOW_SIZE.x, WINDOW_SIZE.y * 0.9f));
     }
     ImGui::End();
     ImGui::PopStyleVar();
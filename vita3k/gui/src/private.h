@@ -59,6 +59,8 @@ void draw_condvars_dialog(GuiState &gui, EmuEnvState &emuenv);
 void draw_event_flags_dialog(GuiState &gui, EmuEnvState &emuenv);
 void draw_allocations_dialog(GuiState &gui, EmuEnvState &emuenv);
 void draw_disassembly_dialog(GuiState &gui, EmuEnvState &emuenv);
+void draw_profiler_dialog(GuiState &gui, EmuEnvState &emuenv);
+void draw_save_states_dialog(GuiState &gui, EmuEnvState &emuenv);
 void draw_settings_dialog(GuiState &gui, EmuEnvState &emuenv);
 void draw_controls_dialog(GuiState &gui, EmuEnvState &emuenv);
 void draw_controllers_dialog(GuiState &gui, EmuEnvState &emuenv);
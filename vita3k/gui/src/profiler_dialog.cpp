@@ -0,0 +1,67 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "private.h"
+
+#include <kernel/state.h>
+
+#include <spdlog/fmt/fmt.h>
+
+#include <ctime>
+
+namespace gui {
+
+void draw_profiler_dialog(GuiState &gui, EmuEnvState &emuenv) {
+    static int interval_us = static_cast<int>(Profiler::DEFAULT_INTERVAL.count());
+    static std::string last_saved_path;
+
+    Profiler &profiler = emuenv.kernel.profiler;
+
+    ImGui::Begin("Profiler", &gui.debug_menu.profiler_dialog);
+    ImGui::Text("Samples the PC and LR of the running guest threads.");
+    ImGui::Separator();
+
+    if (profiler.is_running()) {
+        if (ImGui::Button("Stop"))
+            profiler.stop();
+    } else {
+        ImGui::SetNextItemWidth(150.f);
+        ImGui::SliderInt("Interval (us)", &interval_us, 100, 10000);
+        if (ImGui::Button("Start"))
+            profiler.start(std::chrono::microseconds(interval_us));
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Reset"))
+        profiler.reset();
+
+    ImGui::Text("%s, %llu samples", profiler.is_running() ? "Running" : "Stopped", static_cast<unsigned long long>(profiler.get_sample_count()));
+
+    if (ImGui::Button("Save collapsed stacks")) {
+        const auto title = emuenv.io.title_id.empty() ? std::string("system") : emuenv.io.title_id;
+        const auto path{ fs::path(emuenv.base_path) / "profiles" / fmt::format("{}-{}.folded", title, std::time(nullptr)) };
+        if (profiler.save_collapsed_stacks(path))
+            last_saved_path = path.string();
+    }
+    if (ImGui::IsItemHovered())
+        ImGui::SetTooltip("The file can be opened with flamegraph.pl or speedscope.");
+    if (!last_saved_path.empty())
+        ImGui::TextWrapped("Saved to %s", last_saved_path.c_str());
+
+    ImGui::End();
+}
+
+} // namespace gui
@@ -0,0 +1,73 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include "private.h"
+
+#include <kernel/state.h>
+
+#include <ctime>
+
+namespace gui {
+
+void draw_save_states_dialog(GuiState &gui, EmuEnvState &emuenv) {
+    SaveStates &save_states = emuenv.kernel.save_states;
+
+    ImGui::Begin("Save States", &gui.debug_menu.save_states_dialog);
+    ImGui::TextWrapped("Keeps the guest memory and threads in memory to run the same part again. Objects created after the save, the GPU and the audio are not restored.");
+    ImGui::Separator();
+
+    if (ImGui::Button("Save"))
+        save_states.save(emuenv.mem);
+    ImGui::SameLine();
+    if (ImGui::Button("Clear"))
+        save_states.clear(emuenv.mem);
+
+    const auto &states = save_states.get_states();
+    if (ImGui::BeginTable("save_states", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("#");
+        ImGui::TableSetupColumn("Time");
+        ImGui::TableSetupColumn("Stored");
+        ImGui::TableSetupColumn("Save time");
+        ImGui::TableSetupColumn("");
+        ImGui::TableHeadersRow();
+        for (size_t i = 0; i < states.size(); i++) {
+            const SaveState &state = states[i];
+            char time[16] = {};
+            std::strftime(time, sizeof(time), "%H:%M:%S", std::localtime(&state.time));
+
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::Text("%zu", i);
+            ImGui::TableSetColumnIndex(1);
+            ImGui::TextUnformatted(time);
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Text("%llu KiB", static_cast<unsigned long long>(state.stored_size / KiB(1)));
+            ImGui::TableSetColumnIndex(3);
+            ImGui::Text("%.1f ms", state.save_duration.count() / 1000.f);
+            ImGui::TableSetColumnIndex(4);
+            ImGui::PushID(static_cast<int>(i));
+            if (ImGui::SmallButton("Load"))
+                save_states.load(emuenv.mem, i);
+            ImGui::PopID();
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
+
+} // namespace gui
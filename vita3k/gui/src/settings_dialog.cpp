@@ -386,6 +386,9 @@ void set_config(GuiState &gui, EmuEnvState &emuenv, const std::string &app_path)
     if (emuenv.io.title_id.empty()) {
         emuenv.kernel.cpu_backend = set_cpu_backend(emuenv.cfg.current_config.cpu_backend);
         emuenv.kernel.cpu_opt = emuenv.cfg.current_config.cpu_opt;
+        emuenv.kernel.host_thread_scheduler.map_priority = emuenv.cfg.host_thread_priority;
+        emuenv.kernel.host_thread_scheduler.set_core_affinity(emuenv.cfg.host_core_affinity);
+        emuenv.kernel.park_spinning_threads = emuenv.cfg.park_spinning_threads;
         emuenv.audio.set_backend(emuenv.cfg.audio_backend);
     }
 }
@@ -490,7 +493,17 @@ void draw_settings_dialog(GuiState &gui, EmuEnvState &emuenv) {
             ImGui::Checkbox("Enable optimizations", &config.cpu_opt);
             if (ImGui::IsItemHovered())
                 ImGui::SetTooltip("Check the box to enable additional CPU JIT optimizations.");
+            ImGui::Checkbox("Use JIT cache", &emuenv.cfg.jit_cache);
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("Check the box to pre-translate the guest code seen in previous runs at game startup\nUncheck to disable this feature.");
+            ImGui::Checkbox("Park spinning threads", &emuenv.cfg.park_spinning_threads);
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("Check the box to put to sleep the guest threads busy-waiting on a lock until it is released, it lowers the host CPU usage.\nUncheck it if a game stutters with it.");
         }
+        ImGui::Spacing();
+        ImGui::Checkbox("Use guest thread priorities on the host", &emuenv.cfg.host_thread_priority);
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Check the box to give the host threads running high priority guest threads (render, audio...) a higher priority than the low priority ones.\nThe guest cores can be pinned to host cores with the host-core-affinity option of the config file.");
         ImGui::EndTabItem();
     } else
         ImGui::PopStyleColor();
@@ -1007,17 +1020,17 @@ void draw_settings_dialog(GuiState &gui, EmuEnvState &emuenv) {
         }
         if (ImGui::Button(emuenv.kernel.debugger.watch_code ? "Unwatch Code" : "Watch Code")) {
             emuenv.kernel.debugger.watch_code = !emuenv.kernel.debugger.watch_code;
-            emuenv.kernel.debugger.update_watches();
+            emuenv.kernel.debugger.update_watches(emuenv.mem);
         }
         ImGui::SameLine();
         if (ImGui::Button(emuenv.kernel.debugger.watch_memory ? "Unwatch Memory" : "Watch Memory")) {
             emuenv.kernel.debugger.watch_memory = !emuenv.kernel.debugger.watch_memory;
-            emuenv.kernel.debugger.update_watches();
+            emuenv.kernel.debugger.update_watches(emuenv.mem);
         }
         ImGui::Spacing();
         if (ImGui::Button(emuenv.kernel.debugger.watch_import_calls ? "Unwatch Import Calls" : "Watch Import Calls")) {
             emuenv.kernel.debugger.watch_import_calls = !emuenv.kernel.debugger.watch_import_calls;
-            emuenv.kernel.debugger.update_watches();
+            emuenv.kernel.debugger.update_watches(emuenv.mem);
         }
 
 #ifdef TRACY_ENABLE
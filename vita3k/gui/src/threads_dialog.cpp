@@ -62,8 +62,36 @@ void draw_thread_details_dialog(GuiState &gui, EmuEnvState &emuenv) {
 
 void draw_threads_dialog(GuiState &gui, EmuEnvState &emuenv) {
     ImGui::Begin("Threads", &gui.debug_menu.threads_dialog);
+    if (emuenv.kernel.jit_pool) {
+        const JitPoolStats stats = get_jit_pool_stats(*emuenv.kernel.jit_pool);
+        ImGui::Text("JIT pool: %zu live / %zu pooled JITs, %zu distinct blocks translated, %zu KiB of guest code",
+            stats.live_jits, stats.pooled_jits, stats.translated_blocks, stats.guest_code_size / KiB(1));
+        if (stats.interpreter_fallbacks && ImGui::TreeNode(fmt::format("Interpreter fallbacks: {}", stats.interpreter_fallbacks).c_str())) {
+            for (const JitFallbackSite &site : get_jit_fallback_sites(*emuenv.kernel.jit_pool, 10))
+                ImGui::Text("%08X: %llu", site.pc, static_cast<unsigned long long>(site.count));
+            ImGui::TreePop();
+        }
+        ImGui::Separator();
+    }
+    const TimerWheelStats timer_stats = emuenv.kernel.timer_wheel.get_stats();
+    if (ImGui::TreeNode(fmt::format("Timeouts: {} expired, {} cancelled, {:.1f} us late on average, {} us at most###timeouts", timer_stats.fired, timer_stats.cancelled,
+            timer_stats.fired ? static_cast<double>(timer_stats.total_lateness_us) / timer_stats.fired : 0.0, timer_stats.max_lateness_us)
+                            .c_str())) {
+        for (size_t i = 0; i < TimerWheelStats::BUCKET_COUNT; i++) {
+            if (!timer_stats.lateness_histogram[i])
+                continue;
+            const std::string range = i == 0 ? std::string("on time")
+                : i == TimerWheelStats::BUCKET_COUNT - 1 ? fmt::format(">= {} us late", 1ull << (i - 1))
+                                                        : fmt::format("{}-{} us late", 1ull << (i - 1), (1ull << i) - 1);
+            ImGui::Text("%-20s %llu", range.c_str(), static_cast<unsigned long long>(timer_stats.lateness_histogram[i]));
+        }
+        if (ImGui::Button("Reset"))
+            emuenv.kernel.timer_wheel.reset_stats();
+        ImGui::TreePop();
+    }
+    ImGui::Separator();
     ImGui::TextColored(GUI_COLOR_TEXT_TITLE,
-        "%-16s %-32s   %-16s   %-16s", "ID", "Thread Name", "Status", "Stack Pointer");
+        "%-16s %-32s   %-16s   %-16s   %-16s   %-16s", "ID", "Thread Name", "Status", "Stack Pointer", "Host CPU Time", "JIT Duplicates");
 
     const std::lock_guard<std::mutex> lock(emuenv.kernel.mutex);
 
@@ -83,8 +111,12 @@ void draw_threads_dialog(GuiState &gui, EmuEnvState &emuenv) {
         case ThreadStatus::suspend:
             run_state = "Suspended";
         }
-        if (ImGui::Selectable(fmt::format("{:0>8X}         {:<32}   {:<16}   {:0>8X}",
-                thread.first, th_state->name, run_state, th_state->stack.get())
+        const uint64_t translations = th_state->cpu->jit_translations;
+        const uint64_t duplicates = th_state->cpu->jit_duplicate_translations;
+        const double duplicate_rate = translations ? 100.0 * duplicates / translations : 0.0;
+        const uint64_t cpu_time = th_state->host_thread ? get_host_thread_cpu_time(*th_state->host_thread) : 0;
+        if (ImGui::Selectable(fmt::format("{:0>8X}         {:<32}   {:<16}   {:0>8X}           {:<16}   {:.1f}% of {}",
+                thread.first, th_state->name, run_state, th_state->stack.get(), fmt::format("{:.3f} s", cpu_time / 1'000'000.0), duplicate_rate, translations)
                                   .c_str())) {
             gui.thread_watch_index = thread.first;
             gui.debug_menu.thread_details_dialog = true;
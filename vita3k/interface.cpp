@@ -671,6 +671,8 @@ bool handle_events(EmuEnvState &emuenv, GuiState &gui) {
                 toggle_touchscreen();
             if (event.key.keysym.scancode == emuenv.cfg.keyboard_gui_fullscreen && !gui.is_key_capture_dropped)
                 switch_full_screen(emuenv);
+            if (event.key.keysym.scancode == emuenv.cfg.keyboard_gui_toggle_fast_forward && !gui.is_key_capture_dropped)
+                app::toggle_fast_forward(emuenv);
 
             if (sce_ctrl_btn != 0) {
                 if (gui.vita_area.user_management)
@@ -28,7 +28,9 @@ struct CPUProtocol : public CPUProtocolBase {
     ~CPUProtocol() override = default;
     void call_svc(CPUState &cpu, uint32_t svc, Address pc, ThreadState &thread) override;
     Address get_watch_memory_addr(Address addr) override;
+    void update_watches() override;
     ExclusiveMonitorPtr get_exlusive_monitor() override;
+    JitPoolPtr get_jit_pool() override;
 
 private:
     CallImportFunc call_import;
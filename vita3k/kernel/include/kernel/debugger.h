@@ -17,6 +17,7 @@
 
 #pragma once
 #include <cpu/state.h>
+#include <atomic>
 #include <map>
 #include <mem/state.h>
 #include <mem/util.h>
@@ -46,6 +47,8 @@ struct Breakpoint {
 struct WatchMemory {
     Address start;
     size_t size;
+    ProtectBlockPtr block; // protection of the range, null from a hit until it is armed again
+    uint64_t hits = 0;
 };
 
 typedef std::map<Address, WatchMemory> WatchMemoryAddrs;
@@ -65,19 +68,32 @@ struct Debugger {
     bool log_exports = false;
     bool dump_elfs = false;
 
-    void add_watch_memory_addr(Address addr, size_t size);
-    void remove_watch_memory_addr(KernelState &state, Address addr);
+    // Watches are page protections, the accesses are logged by the access violation handler.
+    // A hit lets the access go through and stops the Jit of the thread right after it, its run loop
+    // then arms the watch again.
+    void add_watch_memory_addr(MemState &mem, Address addr, size_t size);
+    void remove_watch_memory_addr(MemState &mem, Address addr);
     void add_breakpoint(MemState &mem, uint32_t addr, bool thumb_mode);
     void remove_breakpoint(MemState &mem, uint32_t addr);
     void add_trampoile(MemState &mem, uint32_t addr, bool thumb_mode, TrampolineCallback callback);
     Trampoline *get_trampoline(Address addr);
     void remove_trampoline(MemState &mem, uint32_t addr);
     Address get_watch_memory_addr(Address addr);
-    void update_watches();
+    void update_watches(MemState &mem);
+    void arm_watches(MemState &mem);
+    void disarm_watches(MemState &mem);
+
+    // Set when a watch must be armed
+    std::atomic<bool> watches_to_arm = false;
 
 private:
+    Address find_watch(Address addr) const;
+    bool handle_watch_hit(Address start, Address addr, bool write);
+
     std::mutex mutex;
     KernelState &parent;
+    // Locked by the access violation handler, must not be held while accessing the guest memory
+    std::mutex watch_mutex;
     WatchMemoryAddrs watch_memory_addrs;
     Breakpoints breakpoints;
     Trampolines trampolines;
@@ -0,0 +1,228 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <util/types.h>
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/*! \brief Epoch based reclamation of the objects erased from the handle tables.
+ *
+ * A thread looking objects up holds a HandleReadGuard, which publishes the global epoch it saw. Erasing an
+ * object retires it at the current epoch and advances the epoch, the table releases it once no guard holds
+ * an epoch up to the one it was retired at. Erasing never waits for the readers, but a guard held while
+ * blocking keeps the objects erased from every table alive until it is released: a thread waiting without a
+ * timeout would leak them for good. The calls which may block take a reference to the object they found and
+ * release the guard before waiting.
+ */
+class HandleEpoch {
+public:
+    // Guards of a thread can be nested, only the outermost one publishes an epoch
+    static void enter();
+    static void exit();
+    static bool is_pinned();
+
+    // Returns the epoch to retire an object at, the object must be unreachable from the tables already
+    static uint64_t retire();
+    // Objects retired before this epoch can be released
+    static uint64_t oldest_pinned();
+};
+
+class HandleReadGuard {
+public:
+    HandleReadGuard() {
+        HandleEpoch::enter();
+    }
+    ~HandleReadGuard() {
+        HandleEpoch::exit();
+    }
+
+    HandleReadGuard(const HandleReadGuard &) = delete;
+    HandleReadGuard &operator=(const HandleReadGuard &) = delete;
+};
+
+/*! \brief Table of kernel objects indexed by their UID.
+ *
+ * The UID encodes the slot of the object, so looking it up is an array access that doesn't take any lock.
+ * A UID is made of (from the low bits) a 16-bit slot index, an 11-bit generation incremented each time the
+ * slot is freed, so that a stale UID doesn't find the object reusing its slot, and a 4-bit tag identifying
+ * the table, so that UIDs of different tables never match. Bit 31 stays clear, UIDs are always positive.
+ *
+ * Objects are added and erased under a lock. A lookup returns a pointer borrowed from the table, valid as
+ * long as the calling thread holds a HandleReadGuard, see HandleEpoch. Keeping an object beyond that takes
+ * a reference to it (get_all, or shared_from_this for the sync primitives).
+ */
+template <typename T>
+class HandleTable {
+public:
+    static constexpr uint32_t INDEX_BITS = 16;
+    static constexpr uint32_t GENERATION_BITS = 11;
+    static constexpr uint32_t TAG_BITS = 4;
+    static constexpr uint32_t MAX_OBJECT_COUNT = 1 << INDEX_BITS;
+
+    typedef std::shared_ptr<T> ObjectPtr;
+
+    // the tag must be unique among the tables and not 0, for UIDs not to be 0
+    explicit HandleTable(uint32_t tag)
+        : tag(tag) {
+        assert(tag > 0 && tag < (1 << TAG_BITS));
+    }
+
+    ~HandleTable() {
+        for (auto &chunk : chunks)
+            delete chunk.load(std::memory_order_relaxed);
+    }
+
+    HandleTable(const HandleTable &) = delete;
+    HandleTable &operator=(const HandleTable &) = delete;
+
+    T *get(SceUID uid) const {
+        assert(HandleEpoch::is_pinned());
+        if (uid <= 0 || get_tag(uid) != tag)
+            return nullptr;
+
+        const Slot *slot = find_slot(get_index(uid));
+        if (!slot)
+            return nullptr;
+
+        // the slot may have been reused since the UID was handed out, the object keeps its own UID
+        T *const object = slot->object.load(std::memory_order_seq_cst);
+        return object && object->uid == uid ? object : nullptr;
+    }
+
+    // Sets the UID of the object, returns it or 0 if the table is full
+    SceUID add(const ObjectPtr &object) {
+        const std::lock_guard<std::mutex> lock(mutex);
+        release_retired();
+
+        uint32_t index;
+        if (!free_indices.empty()) {
+            // reuse the oldest free slot, for its generation to wrap as late as possible
+            index = free_indices.front();
+            free_indices.pop_front();
+        } else if (next_index < MAX_OBJECT_COUNT) {
+            index = next_index++;
+            auto &chunk = chunks[index / CHUNK_SIZE];
+            if (!chunk.load(std::memory_order_relaxed))
+                chunk.store(new Chunk, std::memory_order_release);
+        } else {
+            return 0;
+        }
+
+        Slot &slot = *find_slot(index);
+        const SceUID uid = static_cast<SceUID>((tag << (INDEX_BITS + GENERATION_BITS)) | (slot.generation << INDEX_BITS) | index);
+        object->uid = uid;
+        slot.owner = object;
+        slot.object.store(object.get(), std::memory_order_release);
+        count++;
+
+        return uid;
+    }
+
+    bool erase(SceUID uid) {
+        if (uid <= 0 || get_tag(uid) != tag)
+            return false;
+
+        const std::lock_guard<std::mutex> lock(mutex);
+        Slot *slot = find_slot(get_index(uid));
+        if (!slot || !slot->owner || slot->owner->uid != uid)
+            return false;
+
+        // new lookups fail from now on, the object is released once the guards which could have found it are gone
+        slot->object.store(nullptr, std::memory_order_seq_cst);
+        retired.emplace_back(HandleEpoch::retire(), std::move(slot->owner));
+        slot->generation = (slot->generation + 1) & GENERATION_MASK;
+        free_indices.push_back(get_index(uid));
+        count--;
+
+        release_retired();
+        return true;
+    }
+
+    // Copy of the objects in the table, for the debugger and lookups by name
+    std::vector<std::pair<SceUID, ObjectPtr>> get_all() const {
+        const std::lock_guard<std::mutex> lock(mutex);
+        std::vector<std::pair<SceUID, ObjectPtr>> objects;
+        objects.reserve(count);
+        for (uint32_t index = 0; index < next_index; index++) {
+            const Slot &slot = *find_slot(index);
+            if (slot.owner)
+                objects.emplace_back(slot.owner->uid, slot.owner);
+        }
+        return objects;
+    }
+
+    size_t size() const {
+        const std::lock_guard<std::mutex> lock(mutex);
+        return count;
+    }
+
+private:
+    static constexpr uint32_t CHUNK_SIZE = 1024;
+    static constexpr uint32_t GENERATION_MASK = (1 << GENERATION_BITS) - 1;
+
+    struct Slot {
+        std::atomic<T *> object = nullptr;
+        // guarded by the mutex
+        ObjectPtr owner;
+        uint32_t generation = 0;
+    };
+
+    // slots are allocated by chunks and never moved, so that readers don't need the lock
+    typedef std::array<Slot, CHUNK_SIZE> Chunk;
+
+    static uint32_t get_index(SceUID uid) {
+        return uid & (MAX_OBJECT_COUNT - 1);
+    }
+    static uint32_t get_tag(SceUID uid) {
+        return (uid >> (INDEX_BITS + GENERATION_BITS)) & ((1 << TAG_BITS) - 1);
+    }
+
+    Slot *find_slot(uint32_t index) const {
+        Chunk *chunk = chunks[index / CHUNK_SIZE].load(std::memory_order_acquire);
+        return chunk ? &(*chunk)[index % CHUNK_SIZE] : nullptr;
+    }
+
+    // Must be called with the mutex locked
+    void release_retired() {
+        if (retired.empty())
+            return;
+
+        const uint64_t oldest = HandleEpoch::oldest_pinned();
+        while (!retired.empty() && retired.front().first < oldest)
+            retired.pop_front();
+    }
+
+    const uint32_t tag;
+    std::array<std::atomic<Chunk *>, MAX_OBJECT_COUNT / CHUNK_SIZE> chunks{};
+
+    mutable std::mutex mutex;
+    std::deque<uint32_t> free_indices;
+    // erased objects and the epoch they were retired at, in increasing epochs
+    std::deque<std::pair<uint64_t, ObjectPtr>> retired;
+    uint32_t next_index = 0;
+    size_t count = 0;
+};
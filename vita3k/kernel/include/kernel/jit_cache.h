@@ -0,0 +1,39 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <util/fs.h>
+
+struct KernelState;
+struct MemState;
+
+/**
+ * \brief Pre-translate the guest code recorded during previous runs of the application.
+ * Entries belonging to modules whose bytes changed since then are skipped.
+ * \param kernel Kernel state struct
+ * \param mem Memory state struct
+ * \param cache_path Folder of the cache, next to the shader cache of the application
+ */
+void load_jit_cache(KernelState &kernel, MemState &mem, const fs::path &cache_path);
+
+/**
+ * \brief Record the entry points of the guest code translated during this run.
+ * \param kernel Kernel state struct
+ * \param cache_path Folder of the cache, next to the shader cache of the application
+ */
+void save_jit_cache(KernelState &kernel, const fs::path &cache_path);
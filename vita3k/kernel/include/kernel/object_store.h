@@ -17,9 +17,12 @@
 
 #pragma once
 
+#include <array>
 #include <atomic>
-#include <map>
+#include <cassert>
+#include <memory>
 #include <mutex>
+#include <stdexcept>
 
 // Brought form rpcs3
 class TypeInfo {
@@ -51,36 +54,55 @@ public:
 template <typename T>
 const uint32_t TypeInfo::registered<T>::index = TypeInfo::add_type(1);
 
+// Objects are created and erased under a lock, but looked up without any: each registered type
+// has a fixed slot in an array, indexed by its TypeInfo index.
 class ObjectStore {
 public:
+    static constexpr uint32_t MAX_TYPE_COUNT = 256;
+
     ObjectStore() = default;
 
     ~ObjectStore() = default;
 
     template <typename T>
     T *get() {
-        std::lock_guard<std::mutex> lock(mutex);
-        auto it = objs.find(TypeInfo::registered<T>::index);
-        assert(it != objs.end());
-        return reinterpret_cast<T *>(it->second.get());
+        const uint32_t index = get_index<T>();
+        void *const obj = objs[index].load(std::memory_order_acquire);
+        assert(obj);
+        return reinterpret_cast<T *>(obj);
     }
 
+    // Like std::map::emplace, an existing object is kept
     template <typename T, typename... Args>
     bool create(Args &&...args) {
+        const uint32_t index = get_index<T>();
         std::lock_guard<std::mutex> lock(mutex);
+        if (owners[index])
+            return true;
         auto ptr = std::make_shared<T>(std::forward<Args>(args)...);
-        objs.emplace(TypeInfo::registered<T>::index, ptr);
+        objs[index].store(ptr.get(), std::memory_order_release);
+        owners[index] = std::move(ptr);
         return true;
     }
     template <typename T>
     void erase() {
-        auto it = objs.find(TypeInfo::registered<T>::index);
-        if (it == objs.end())
-            return;
-        objs.erase(it);
+        const uint32_t index = get_index<T>();
+        std::lock_guard<std::mutex> lock(mutex);
+        objs[index].store(nullptr, std::memory_order_release);
+        owners[index].reset();
     }
 
 private:
+    // The types get their index at startup, one past the array would be used out of bounds in release builds too
+    template <typename T>
+    static uint32_t get_index() {
+        const uint32_t index = TypeInfo::registered<T>::index;
+        if (index >= MAX_TYPE_COUNT) [[unlikely]]
+            throw std::length_error("ObjectStore: more types than MAX_TYPE_COUNT");
+        return index;
+    }
+
     std::mutex mutex;
-    std::map<uint32_t, std::shared_ptr<void>> objs;
-};
\ No newline at end of file
+    std::array<std::atomic<void *>, MAX_TYPE_COUNT> objs{};
+    std::array<std::shared_ptr<void>, MAX_TYPE_COUNT> owners;
+};
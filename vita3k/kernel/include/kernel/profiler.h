@@ -0,0 +1,81 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <kernel/types.h>
+#include <mem/util.h>
+#include <util/fs.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+
+struct KernelState;
+
+/*! \brief Sampling profiler of the guest code.
+ *
+ * A host thread reads the PC and LR of every running guest thread at a fixed interval, the
+ * guest threads themselves are never stopped. The registers are read racily from the JIT state,
+ * so a sample points to the last block boundary the thread reached.
+ * Samples are symbolized when the report is generated, as module!export+offset (or module+offset).
+ */
+struct Profiler {
+    static constexpr std::chrono::microseconds DEFAULT_INTERVAL{ 1000 };
+
+    Profiler() = delete;
+    explicit Profiler(KernelState &kernel);
+    ~Profiler();
+
+    void start(std::chrono::microseconds interval = DEFAULT_INTERVAL);
+    void stop();
+    bool is_running() const {
+        return running;
+    }
+
+    void reset();
+    uint64_t get_sample_count() const {
+        return sample_count;
+    }
+
+    // One "thread;caller;function count" line per stack, the format of flamegraph.pl and speedscope
+    std::string get_collapsed_stacks();
+    bool save_collapsed_stacks(const fs::path &path);
+
+private:
+    // thread id, pc, lr
+    typedef std::tuple<SceUID, Address, Address> SampleKey;
+
+    KernelState &parent;
+
+    std::thread sampler;
+    std::atomic<bool> running = false;
+    std::mutex running_mutex;
+    std::condition_variable running_cond;
+
+    std::mutex samples_mutex;
+    std::map<SampleKey, uint64_t> samples;
+    std::map<SceUID, std::string> thread_names;
+    std::atomic<uint64_t> sample_count = 0;
+
+    void sample_loop(std::chrono::microseconds interval);
+};
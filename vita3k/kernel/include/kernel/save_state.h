@@ -0,0 +1,83 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <cpu/common.h>
+#include <kernel/types.h>
+#include <mem/state.h>
+
+#include <chrono>
+#include <ctime>
+#include <map>
+#include <set>
+#include <vector>
+
+struct KernelState;
+
+struct SaveState {
+    std::time_t time = 0;
+    MemSnapshotPtr mem;
+    std::map<SceUID, CPUContext> thread_contexts;
+    std::map<SceUID, int> semaphore_values;
+    std::map<SceUID, int> eventflag_flags;
+    std::map<SceUID, SceUInt32> simple_event_patterns;
+    // lock count and owner thread id
+    std::map<SceUID, std::pair<int, SceUID>> mutex_locks;
+    std::map<SceUID, std::vector<uint8_t>> msgpipe_data;
+    // the threads waiting on each object, in the order they are woken up
+    std::vector<std::vector<SceUID>> wait_queues;
+
+    // Size of the pages stored by this state only, the other ones are shared with the previous states
+    uint64_t stored_size = 0;
+    std::chrono::microseconds save_duration{};
+};
+
+/*! \brief In-memory savestates, to run the same part of a game again while comparing settings.
+ *
+ * The guest threads are suspended while saving and loading. Each state only stores the guest pages which
+ * changed since the previous one saved or loaded.
+ * A thread blocked in a HLE call sits in the host code of the call, which can't be saved. Its pc is saved on
+ * the svc of the import stub instead, so that it makes the call again once loaded.
+ * Loading cancels the waits in progress, then restores the memory, the CPU context of the threads, the counters
+ * of the semaphores, event flags and simple events, the locks of the mutexes and the content of the message
+ * pipes which still exist. The threads which were waiting are resumed first, in the order of the wait queues.
+ * The objects created or deleted since the save, the GPU and the audio are not restored, it is meant for
+ * experiments, not to replace the savedata of the games.
+ */
+struct SaveStates {
+    SaveStates() = delete;
+    explicit SaveStates(KernelState &kernel);
+
+    void save(MemState &mem);
+    bool load(MemState &mem, size_t index);
+    void clear(MemState &mem);
+
+    // Must only be used by the thread which saves and loads
+    const std::vector<SaveState> &get_states() const {
+        return states;
+    }
+
+private:
+    KernelState &parent;
+    std::vector<SaveState> states;
+
+    bool stop_threads();
+    std::set<SceUID> wait_threads_stopped();
+    void cancel_waits(const std::set<SceUID> &in_hle_call);
+    void resume_threads(const SaveState &state);
+};
@@ -21,7 +21,11 @@
 #include <kernel/callback.h>
 #include <kernel/cpu_protocol.h>
 #include <kernel/debugger.h>
+#include <kernel/profiler.h>
+#include <kernel/save_state.h>
 #include <kernel/sync_primitives.h>
+#include <kernel/thread/host_thread.h>
+#include <kernel/timer_wheel.h>
 #include <kernel/types.h>
 #include <mem/allocator.h>
 #include <mem/ptr.h>
@@ -59,6 +63,7 @@ typedef std::shared_ptr<SDL_Thread> ThreadPtr;
 typedef std::map<SceUID, ThreadPtr> ThreadPtrs;
 typedef std::shared_ptr<SceKernelModuleInfo> SceKernelModuleInfoPtr;
 typedef std::map<SceUID, SceKernelModuleInfoPtr> SceKernelModuleInfoPtrs;
+typedef std::map<SceUID, uint64_t> ModuleHashes;
 typedef std::map<SceUID, CallbackPtr> CallbackPtrs;
 typedef std::unordered_map<uint32_t, Address> ExportNids;
 typedef std::map<Address, uint32_t> NotFoundVars;
@@ -132,23 +137,27 @@ struct KernelState {
     unsigned int tls_psize = 0;
     unsigned int tls_msize = 0;
 
-    SimpleEventPtrs simple_events;
-    SemaphorePtrs semaphores;
-    CondvarPtrs condvars;
-    CondvarPtrs lwcondvars;
-    MutexPtrs mutexes;
-    MutexPtrs lwmutexes; // also Mutexes for now
-    RWLockPtrs rwlocks;
-    EventFlagPtrs eventflags;
-    MsgPipePtrs msgpipes;
+    // the numbers are the tags of the UIDs, see HandleTable
+    SimpleEventPtrs simple_events{ 1 };
+    SemaphorePtrs semaphores{ 2 };
+    CondvarPtrs condvars{ 3 };
+    CondvarPtrs lwcondvars{ 4 };
+    MutexPtrs mutexes{ 5 };
+    MutexPtrs lwmutexes{ 6 }; // also Mutexes for now
+    LwMutexStats lwmutex_stats;
+    RWLockPtrs rwlocks{ 7 };
+    EventFlagPtrs eventflags{ 8 };
+    MsgPipePtrs msgpipes{ 9 };
     CallbackPtrs callbacks;
 
     ThreadStatePtrs threads;
 
     SceKernelModuleInfoPtrs loaded_modules;
+    ModuleHashes module_hashes; // hash of the module segments once linked
     LoadedSysmodules loaded_sysmodules;
     ExportNids export_nids;
     std::shared_mutex export_nids_mutex;
+    std::atomic<uint32_t> export_nids_generation = 0; // incremented when a function export is added
     VarLateBindingInfos late_binding_infos;
     ModuleUidByNid module_uid_by_nid;
 
@@ -157,15 +166,21 @@ struct KernelState {
     CorenumAllocator corenum_allocator;
     CPUProtocolPtr cpu_protocol;
     ExclusiveMonitorPtr exclusive_monitor;
+    JitPoolPtr jit_pool;
+    HostThreadScheduler host_thread_scheduler;
+    bool park_spinning_threads = true;
 
     ObjectStore obj_store;
 
     uint64_t start_tick;
     SceRtcTick base_tick;
     TimerStates timers;
+    TimerWheel timer_wheel; // timeouts of the waits and delays
     Ptr<SceProcessParam> process_param;
 
     Debugger debugger;
+    Profiler profiler;
+    SaveStates save_states;
 
     SceUID get_next_uid() {
         return next_uid++;
@@ -177,14 +192,16 @@ struct KernelState {
     ThreadStatePtr create_thread(MemState &mem, const char *name, Ptr<const void> entry_point, int init_priority, SceInt32 affinity_mask, int stack_size, const SceKernelThreadOptParam *option);
 
     ThreadStatePtr get_thread(SceUID thread_id);
+    void update_host_thread(ThreadState &thread);
     Ptr<Ptr<void>> get_thread_tls_addr(MemState &mem, SceUID thread_id, int key);
 
     void exit_delete_all_threads();
     bool is_threads_paused() { return !paused_threads_status.empty(); };
     void pause_threads();
     void resume_threads();
+    // resumes a paused thread before the other ones
+    void resume_paused_thread(SceUID thread_id);
 
-    void set_memory_watch(bool enabled);
     void invalidate_jit_cache(Address start, size_t length);
     std::shared_ptr<SceKernelModuleInfo> find_module_by_addr(Address address);
 
@@ -18,10 +18,13 @@
 #pragma once
 
 #include <cpu/common.h>
+#include <kernel/handle_table.h>
 #include <kernel/thread/thread_data_queue.h>
 #include <kernel/types.h>
 #include <util/byte_ring_buffer.h>
 
+#include <atomic>
+
 struct KernelState;
 
 struct WaitingThreadData {
@@ -53,6 +56,10 @@ struct WaitingThreadData {
         // struct { }; // condvar
         struct { // msgpipe
             SceSize request_size;
+            // a sender copies straight into the buffer of a waiting receiver, and stores how much it copied
+            void *buffer;
+            SceSize buffer_size;
+            SceSize *received;
         } mp;
     };
 
@@ -77,7 +84,9 @@ typedef std::unique_ptr<ThreadDataQueue<WaitingThreadData>> WaitingThreadQueuePt
 
 // NOTE: uid is copied to sync primitives here for debugging,
 //       not really needed since they are put in std::map's
-struct SyncPrimitive {
+// Lookups borrow the primitives from their table, shared_from_this keeps one beyond the HandleReadGuard,
+// which the calls which may block must not hold while waiting
+struct SyncPrimitive : std::enable_shared_from_this<SyncPrimitive> {
     SceUID uid;
 
     uint32_t attr;
@@ -101,7 +110,7 @@ struct SimpleEvent : SyncPrimitive {
 };
 
 typedef std::shared_ptr<SimpleEvent> SimpleEventPtr;
-typedef std::map<SceUID, SimpleEventPtr> SimpleEventPtrs;
+typedef HandleTable<SimpleEvent> SimpleEventPtrs;
 
 struct Semaphore : SyncPrimitive {
     WaitingThreadQueuePtr waiting_threads;
@@ -112,20 +121,32 @@ struct Semaphore : SyncPrimitive {
 };
 
 typedef std::shared_ptr<Semaphore> SemaphorePtr;
-typedef std::map<SceUID, SemaphorePtr> SemaphorePtrs;
+typedef HandleTable<Semaphore> SemaphorePtrs;
+
+// Lightweight mutexes keep their lock state in the guest workarea so that
+// uncontended lock/unlock never has to look the mutex up in the kernel.
+// The owner word holds the owning thread id (0 when free), and the top bit
+// is set while threads are queued on the mutex in the kernel.
+constexpr uint32_t LW_MUTEX_CONTENDED = 0x80000000;
+
+struct LwMutexStats {
+    std::atomic<uint64_t> uncontended = 0;
+    std::atomic<uint64_t> contended = 0;
+};
 
 struct Mutex : SyncPrimitive {
     int init_count;
-    int lock_count;
-    ThreadStatePtr owner;
+    int lock_count; // not used by lightweight mutexes, see workarea
+    ThreadStatePtr owner; // not used by lightweight mutexes, see workarea
     WaitingThreadQueuePtr waiting_threads;
     Ptr<SceKernelLwMutexWork> workarea;
+    uint64_t contended_count = 0;
 
     ~Mutex() override = default;
 };
 
 typedef std::shared_ptr<Mutex> MutexPtr;
-typedef std::map<SceUID, MutexPtr> MutexPtrs;
+typedef HandleTable<Mutex> MutexPtrs;
 
 enum class RWLockState {
     Unlocked,
@@ -145,7 +166,7 @@ struct RWLock : SyncPrimitive {
 };
 
 typedef std::shared_ptr<RWLock> RWLockPtr;
-typedef std::map<SceUID, RWLockPtr> RWLockPtrs;
+typedef HandleTable<RWLock> RWLockPtrs;
 
 struct EventFlag : SyncPrimitive {
     WaitingThreadQueuePtr waiting_threads;
@@ -155,7 +176,7 @@ struct EventFlag : SyncPrimitive {
 };
 
 typedef std::shared_ptr<EventFlag> EventFlagPtr;
-typedef std::map<SceUID, EventFlagPtr> EventFlagPtrs;
+typedef HandleTable<EventFlag> EventFlagPtrs;
 
 struct Condvar : SyncPrimitive {
     struct SignalTarget {
@@ -181,24 +202,29 @@ struct Condvar : SyncPrimitive {
     ~Condvar() override = default;
 };
 typedef std::shared_ptr<Condvar> CondvarPtr;
-typedef std::map<SceUID, CondvarPtr> CondvarPtrs;
+typedef HandleTable<Condvar> CondvarPtrs;
 
 struct MsgPipe : SyncPrimitive {
     MsgPipe(std::size_t bufSize)
         : data_buffer(bufSize) {}
 
+    // guarded by mutex, the counts let the other side skip the mutex when no thread waits
     WaitingThreadQueuePtr senders;
     WaitingThreadQueuePtr receivers;
+    std::atomic<uint32_t> waiting_senders = 0;
+    std::atomic<uint32_t> waiting_receivers = 0;
+
+    // the ring has a single producer, the senders take turns with send_mutex
+    std::mutex send_mutex;
     ByteRingBuffer data_buffer;
 
     bool beingDeleted = false;
-    std::atomic<std::size_t> remainingThreads = 0;
 
     ~MsgPipe() override = default;
 };
 
 typedef std::shared_ptr<MsgPipe> MsgPipePtr;
-typedef std::map<SceUID, MsgPipePtr> MsgPipePtrs;
+typedef HandleTable<MsgPipe> MsgPipePtrs;
 
 enum class SyncWeight {
     Light, // lightweight
@@ -216,9 +242,16 @@ SceInt32 simple_event_delete(KernelState &kernel, const char *export_name, SceUI
 SceUID mutex_create(SceUID *uid_out, KernelState &kernel, MemState &mem, const char *export_name, const char *name, SceUID thread_id, SceUInt attr, int init_count, Ptr<SceKernelLwMutexWork> workarea, SyncWeight weight);
 int mutex_lock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID mutexid, int lock_count, unsigned int *timeout, SyncWeight weight);
 int mutex_try_lock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID mutexid, int lock_count, SyncWeight weight);
-int mutex_unlock(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID mutexid, int unlock_count, SyncWeight weight);
+int mutex_unlock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID mutexid, int unlock_count, SyncWeight weight);
 int mutex_delete(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID mutexid, SyncWeight weight);
-MutexPtr mutex_get(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID mutexid, SyncWeight weight);
+// The mutex is borrowed from its table, see HandleTable::get
+Mutex *mutex_get(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID mutexid, SyncWeight weight);
+
+// Lightweight Mutex (tries an atomic update of the workarea before entering the kernel)
+int lwmutex_lock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, Ptr<SceKernelLwMutexWork> workarea, int lock_count, unsigned int *timeout);
+int lwmutex_try_lock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, Ptr<SceKernelLwMutexWork> workarea, int lock_count);
+int lwmutex_unlock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, Ptr<SceKernelLwMutexWork> workarea, int unlock_count);
+SceUID lwmutex_owner(const SceKernelLwMutexWork &workarea);
 
 // RWLock
 SceUID rwlock_create(KernelState &kernel, MemState &mem, const char *export_name, const char *name, SceUID thread_id, SceUInt32 attr);
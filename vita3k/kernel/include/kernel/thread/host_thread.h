@@ -0,0 +1,52 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <kernel/types.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Host thread running a guest thread
+struct HostThread;
+typedef std::shared_ptr<HostThread> HostThreadPtr;
+
+// User threads can run on the cores 0 to 2 (SCE_KERNEL_CPU_MASK_USER_ALL)
+constexpr int GUEST_USER_CORE_COUNT = 3;
+
+struct HostThreadScheduler {
+    // Map guest thread priorities onto host thread priorities
+    bool map_priority = false;
+    // Host core each guest core is pinned to, -1 leaves it to the host scheduler
+    std::array<int, GUEST_USER_CORE_COUNT> core_affinity = { -1, -1, -1 };
+
+    // Parse a comma separated list of host cores, one for each guest core (ex: "2,3,4")
+    void set_core_affinity(const std::string &host_cores);
+    bool has_core_affinity() const;
+};
+
+// Must be called from the thread itself
+HostThreadPtr get_current_host_thread();
+
+void set_host_thread_priority(HostThread &thread, int priority);
+void set_host_thread_affinity(const HostThreadScheduler &scheduler, HostThread &thread, SceInt32 affinity_mask);
+
+// Time the host thread has spent running, in microseconds (0 if the host doesn't report it)
+uint64_t get_host_thread_cpu_time(const HostThread &thread);
@@ -17,9 +17,11 @@
 
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
 #include <cpu/state.h>
 #include <kernel/callback.h>
+#include <kernel/thread/host_thread.h>
 #include <kernel/types.h>
 #include <list>
 #include <mem/block.h>
@@ -86,6 +88,7 @@ struct ThreadState {
     bool is_processing_callbacks = false;
 
     CPUStatePtr cpu;
+    HostThreadPtr host_thread;
     ThreadStatus status = ThreadStatus::dormant;
 
     ThreadSignal signal;
@@ -93,6 +96,8 @@ struct ThreadState {
     std::condition_variable status_cond;
     std::vector<std::shared_ptr<ThreadState>> waiting_threads;
     uint32_t returned_value = 0;
+    // set when a savestate is loaded, the kernel wait the thread is in returns SCE_KERNEL_ERROR_WAIT_CANCEL
+    std::atomic<bool> wait_aborted = false;
 
     ThreadState() = delete;
     explicit ThreadState(SceUID id, MemState &mem);
@@ -121,6 +126,14 @@ struct ThreadState {
     void resume(bool step = false);
     std::string log_stack_traceback(KernelState &kernel) const;
 
+    // Context to resume the thread from, for the savestates. When the thread is inside a HLE call (or a callback
+    // it runs), the pc is put back on the svc of the import stub, so that the call is made again.
+    CPUContext get_resumable_context(bool in_hle_call);
+    // The thread loads the context before it runs again, once it left the HLE call it is in.
+    // Returns false if the thread is dormant.
+    bool set_restored_context(const CPUContext &context);
+    void abort_wait();
+
 private:
     void push_arguments(Address callback_address, const std::vector<uint32_t> &args);
 
@@ -134,6 +147,9 @@ private:
     // if running a callback inside a callback (possible for exemple by allocating
     // gxm callbacked memory inside a kernel callback), call_level is 2
     int call_level = 0;
+    // contexts the callbacks being run return to, the outermost first
+    std::vector<CPUContext> callback_return_contexts;
+    std::optional<CPUContext> restored_context;
 
     MemState &mem;
 };
@@ -0,0 +1,133 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <rtc/guest_clock.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct WheelTimer {
+    uint64_t deadline; // in us of the guest clock since the epoch of the wheel
+
+    // The timer locks the mutex to set expired, then notifies the condition variable.
+    // Both are kept alive until the timer fired or was cancelled.
+    std::shared_ptr<std::mutex> mutex;
+    std::shared_ptr<std::condition_variable> cond;
+    bool expired = false; // guarded by mutex
+
+    // position in the wheel, level is NOT_QUEUED once fired or cancelled
+    static constexpr uint32_t NOT_QUEUED = UINT32_MAX;
+    uint32_t level = NOT_QUEUED;
+    uint32_t slot = 0;
+    size_t position = 0;
+};
+
+typedef std::shared_ptr<WheelTimer> WheelTimerPtr;
+
+struct TimerWheelStats {
+    // bucket 0 counts the timers that fired on time, bucket i > 0 the ones [2^(i-1), 2^i) us late,
+    // the last bucket all the later ones
+    static constexpr size_t BUCKET_COUNT = 16;
+
+    uint64_t fired = 0;
+    uint64_t cancelled = 0;
+    uint64_t total_lateness_us = 0;
+    uint64_t max_lateness_us = 0;
+    std::array<uint64_t, BUCKET_COUNT> lateness_histogram{};
+};
+
+/*! \brief Timeouts of all the guest threads, expired by a single host thread.
+ *
+ * Timers are kept in a hierarchical wheel of 1 us ticks: level L has 64 slots of 64^L us and holds the
+ * timers whose deadline differs from the current time first in the L-th group of 6 bits. Timers move down
+ * a level when the time reaches their slot, so adding, cancelling and expiring a timer are O(1), and
+ * all the timers of a tick expire together.
+ * The time is the one of the guest clock, so the timeouts follow the emulation speed. The timer thread sleeps
+ * for the host time the clock takes to reach the next slot, then spins for the last SPIN_TIME to be precise.
+ * When only the vblanks move the clock, it sleeps until one of them does.
+ */
+class TimerWheel {
+public:
+    static constexpr uint32_t LEVEL_BITS = 6;
+    static constexpr uint32_t SLOT_COUNT = 1 << LEVEL_BITS;
+    static constexpr uint32_t LEVEL_COUNT = 6; // about 19 hours, the rest waits in an overflow list
+    static constexpr std::chrono::microseconds SPIN_TIME{ 100 };
+
+    explicit TimerWheel(GuestClock &clock = guest_clock());
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel &operator=(const TimerWheel &) = delete;
+
+    // Must be called with mutex locked
+    WheelTimerPtr start(std::chrono::microseconds timeout, std::shared_ptr<std::mutex> mutex, std::shared_ptr<std::condition_variable> cond);
+    void cancel(const WheelTimerPtr &timer);
+
+    // Like std::condition_variable::wait_for, with the timeout expired by the wheel.
+    // lock must hold *mutex, the owners of mutex and cond are kept alive by the timer.
+    template <typename Predicate>
+    bool wait_for(std::unique_lock<std::mutex> &lock, std::shared_ptr<std::mutex> mutex, std::shared_ptr<std::condition_variable> cond,
+        std::chrono::microseconds timeout, Predicate pred) {
+        if (pred())
+            return true;
+        std::condition_variable &condition = *cond;
+        const WheelTimerPtr timer = start(timeout, std::move(mutex), std::move(cond));
+        condition.wait(lock, [&] { return timer->expired || pred(); });
+        cancel(timer);
+        return pred();
+    }
+
+    TimerWheelStats get_stats();
+    void reset_stats();
+
+private:
+    GuestClock &clock;
+    size_t clock_listener;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::thread thread;
+    bool stopping = false;
+
+    uint64_t epoch;
+    uint64_t current = 0;
+    size_t queued = 0;
+    std::array<std::array<std::vector<WheelTimerPtr>, SLOT_COUNT>, LEVEL_COUNT> slots;
+    std::array<uint64_t, LEVEL_COUNT> occupied{};
+    std::vector<WheelTimerPtr> overflow;
+    // deadline the timer thread sleeps or spins until, an earlier new timer has to wake it
+    std::atomic<uint64_t> wake_at = UINT64_MAX;
+
+    TimerWheelStats stats;
+
+    uint64_t now() const;
+    void insert(const WheelTimerPtr &timer, std::vector<WheelTimerPtr> &due);
+    void unlink(WheelTimer &timer);
+    uint64_t next_event() const;
+    void advance(uint64_t time, std::vector<WheelTimerPtr> &due);
+    void record_lateness(const std::vector<WheelTimerPtr> &due, uint64_t time);
+    void run();
+};
@@ -62,6 +62,15 @@ Address CPUProtocol::get_watch_memory_addr(Address addr) {
     return kernel->debugger.get_watch_memory_addr(addr);
 }
 
+void CPUProtocol::update_watches() {
+    if (kernel->debugger.watches_to_arm)
+        kernel->debugger.arm_watches(*mem);
+}
+
 ExclusiveMonitorPtr CPUProtocol::get_exlusive_monitor() {
     return kernel->exclusive_monitor;
 }
+
+JitPoolPtr CPUProtocol::get_jit_pool() {
+    return kernel->jit_pool;
+}
@@ -16,7 +16,9 @@
 // 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
 #include <kernel/debugger.h>
+#include <cpu/functions.h>
 #include <kernel/state.h>
+#include <mem/functions.h>
 #include <util/align.h>
 #include <util/arm.h>
 #include <util/log.h>
@@ -124,19 +126,34 @@ Debugger::Debugger(KernelState &kernel)
     : parent(kernel) {
 }
 
-void Debugger::add_watch_memory_addr(Address addr, size_t size) {
-    std::lock_guard<std::mutex> lock(mutex);
-    watch_memory_addrs.emplace(addr, WatchMemory{ addr, size });
+void Debugger::add_watch_memory_addr(MemState &mem, Address addr, size_t size) {
+    {
+        std::lock_guard<std::mutex> lock(watch_mutex);
+        watch_memory_addrs.emplace(addr, WatchMemory{ addr, size });
+    }
+    if (watch_memory)
+        arm_watches(mem);
 }
 
-void Debugger::remove_watch_memory_addr(KernelState &state, Address addr) {
-    std::lock_guard<std::mutex> lock(mutex);
-    watch_memory_addrs.erase(addr);
+void Debugger::remove_watch_memory_addr(MemState &mem, Address addr) {
+    ProtectBlockPtr block;
+    {
+        std::lock_guard<std::mutex> lock(watch_mutex);
+        const auto watch = watch_memory_addrs.find(addr);
+        if (watch == watch_memory_addrs.end())
+            return;
+
+        block = std::move(watch->second.block);
+        watch_memory_addrs.erase(watch);
+    }
+    // the handler may wait for watch_mutex in the callback of the block
+    if (block)
+        remove_protect(mem, block);
 }
 
 // TODO use boost icl or interval tree instead if this turns out to be a significant bottleneck
-Address Debugger::get_watch_memory_addr(Address addr) {
-    std::lock_guard<std::mutex> lock(mutex);
+// watch_mutex must be locked
+Address Debugger::find_watch(Address addr) const {
     for (const auto &item : watch_memory_addrs) {
         if (item.second.start <= addr && addr < item.second.start + item.second.size) {
             return item.second.start;
@@ -145,6 +162,87 @@ Address Debugger::get_watch_memory_addr(Address addr) {
     return 0;
 }
 
-void Debugger::update_watches() {
-    parent.set_memory_watch(watch_memory);
+Address Debugger::get_watch_memory_addr(Address addr) {
+    std::lock_guard<std::mutex> lock(watch_mutex);
+    return find_watch(addr);
+}
+
+void Debugger::update_watches(MemState &mem) {
+    if (parent.jit_pool)
+        set_halt_on_memory_access(*parent.jit_pool, watch_memory);
+
+    if (watch_memory)
+        arm_watches(mem);
+    else
+        disarm_watches(mem);
+}
+
+void Debugger::arm_watches(MemState &mem) {
+    watches_to_arm = false;
+    if (!watch_memory)
+        return;
+
+    std::vector<WatchMemory> to_arm;
+    {
+        std::lock_guard<std::mutex> lock(watch_mutex);
+        for (const auto &[_, watch] : watch_memory_addrs) {
+            if (!watch.block)
+                to_arm.push_back(watch);
+        }
+    }
+
+    // add_protect locks the pages, which the handler locks before calling the callback
+    for (const WatchMemory &watch : to_arm) {
+        const ProtectBlockPtr block = add_protect(mem, watch.start, static_cast<uint32_t>(watch.size), MemPerm::None, [this, start = watch.start](Address addr, bool write) {
+            return handle_watch_hit(start, addr, write);
+        });
+
+        bool armed = false;
+        {
+            std::lock_guard<std::mutex> lock(watch_mutex);
+            const auto it = watch_memory_addrs.find(watch.start);
+            // the watch may have been removed, hit or armed by another thread in the meantime
+            if (it != watch_memory_addrs.end() && it->second.hits == watch.hits && !it->second.block) {
+                it->second.block = block;
+                armed = true;
+            }
+        }
+        if (!armed)
+            remove_protect(mem, block);
+    }
+}
+
+void Debugger::disarm_watches(MemState &mem) {
+    std::vector<ProtectBlockPtr> blocks;
+    {
+        std::lock_guard<std::mutex> lock(watch_mutex);
+        for (auto &[_, watch] : watch_memory_addrs) {
+            if (watch.block)
+                blocks.push_back(std::move(watch.block));
+        }
+    }
+    for (const ProtectBlockPtr &block : blocks)
+        remove_protect(mem, block);
+}
+
+// Runs in the access violation handler, on the faulting thread
+bool Debugger::handle_watch_hit(Address start, Address addr, bool write) {
+    {
+        std::lock_guard<std::mutex> lock(watch_mutex);
+        const auto watch = watch_memory_addrs.find(start);
+        if (watch != watch_memory_addrs.end()) {
+            watch->second.block = nullptr;
+            watch->second.hits++;
+        }
+
+        // the whole page is protected and may hold other watches, the access is logged once by the watch it hits
+        if (watch_memory && find_watch(addr) == start)
+            LOG_INFO("{} at {} ({} + {})", write ? "Write" : "Read", log_hex(addr), log_hex(start), addr - start);
+    }
+
+    // let the access through and protect the range again right after it, a host access from an import
+    // is followed by the run loop of its thread as well
+    watches_to_arm = true;
+    halt_running_cpu();
+    return true;
 }
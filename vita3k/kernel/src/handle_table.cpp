@@ -0,0 +1,96 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/handle_table.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+constexpr uint64_t IDLE_EPOCH = std::numeric_limits<uint64_t>::max();
+
+// Epoch published by a thread, records are reused by the next threads once theirs exits
+struct EpochRecord {
+    std::atomic<uint64_t> epoch = IDLE_EPOCH;
+    std::atomic<bool> used = false;
+};
+
+std::atomic<uint64_t> global_epoch = 1;
+
+// the deque never moves its elements, readers keep a pointer to their record
+std::mutex records_mutex;
+std::deque<EpochRecord> records;
+
+EpochRecord *acquire_record() {
+    const std::lock_guard<std::mutex> lock(records_mutex);
+    for (EpochRecord &record : records) {
+        bool used = false;
+        if (record.used.compare_exchange_strong(used, true))
+            return &record;
+    }
+
+    EpochRecord &record = records.emplace_back();
+    record.used = true;
+    return &record;
+}
+
+struct ThreadEpoch {
+    EpochRecord *record = nullptr;
+    uint32_t depth = 0;
+
+    ~ThreadEpoch() {
+        if (record)
+            record->used.store(false, std::memory_order_release);
+    }
+};
+
+thread_local ThreadEpoch thread_epoch;
+
+} // namespace
+
+void HandleEpoch::enter() {
+    if (thread_epoch.depth++ > 0)
+        return;
+
+    if (!thread_epoch.record)
+        thread_epoch.record = acquire_record();
+    // published before the lookups, which then see the objects erased up to this epoch as gone
+    thread_epoch.record->epoch.store(global_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+}
+
+void HandleEpoch::exit() {
+    assert(thread_epoch.depth > 0);
+    if (--thread_epoch.depth == 0)
+        thread_epoch.record->epoch.store(IDLE_EPOCH, std::memory_order_release);
+}
+
+bool HandleEpoch::is_pinned() {
+    return thread_epoch.depth > 0;
+}
+
+uint64_t HandleEpoch::retire() {
+    return global_epoch.fetch_add(1, std::memory_order_seq_cst);
+}
+
+uint64_t HandleEpoch::oldest_pinned() {
+    const std::lock_guard<std::mutex> lock(records_mutex);
+    uint64_t oldest = IDLE_EPOCH;
+    for (const EpochRecord &record : records)
+        oldest = std::min(oldest, record.epoch.load(std::memory_order_seq_cst));
+    return oldest;
+}
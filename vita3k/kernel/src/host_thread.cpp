@@ -0,0 +1,279 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/thread/host_thread.h>
+
+#include <util/log.h>
+#include <util/string_utils.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <thread>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#endif
+#endif
+
+// Host cores a mask can hold
+constexpr int MAX_HOST_CORES = 64;
+
+// The cpu mask of the first user core, the next ones follow
+constexpr SceInt32 SCE_KERNEL_CPU_MASK_USER_0 = 0x10000;
+
+void HostThreadScheduler::set_core_affinity(const std::string &host_cores) {
+    core_affinity.fill(-1);
+    if (host_cores.empty())
+        return;
+
+    const std::vector<std::string> cores = string_utils::split_string(host_cores, ',');
+    for (size_t core = 0; core < cores.size() && core < GUEST_USER_CORE_COUNT; core++) {
+        std::string value = cores[core];
+        value.erase(std::remove_if(value.begin(), value.end(), [](unsigned char c) { return std::isspace(c); }), value.end());
+
+        int host_core = -1;
+        const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), host_core);
+        if (error != std::errc() || end != value.data() + value.size() || host_core < -1 || host_core >= MAX_HOST_CORES) {
+            LOG_WARN("Invalid host core \"{}\" for guest core {}, it won't be pinned", value, core);
+            host_core = -1;
+        }
+        core_affinity[core] = host_core;
+    }
+
+#if defined(__APPLE__)
+    if (has_core_affinity())
+        LOG_WARN("Pinning threads to host cores is not supported on macOS, the host core affinity is ignored");
+#endif
+}
+
+bool HostThreadScheduler::has_core_affinity() const {
+    return std::any_of(core_affinity.begin(), core_affinity.end(), [](int host_core) { return host_core >= 0; });
+}
+
+// Number of steps, between -2 and 2, the thread is above (or below) the default game priority
+static int get_priority_level(int priority) {
+    // a lower value is a higher priority, from 64 to 191 with 160 for most game threads
+    const int level = (SCE_KERNEL_GAME_DEFAULT_PRIORITY_ACTUAL - priority) / 16;
+    return std::clamp(level, -2, 2);
+}
+
+// Host cores the guest cores allowed by affinity_mask are pinned to, 0 if none of them is
+static uint64_t get_host_core_mask(const HostThreadScheduler &scheduler, SceInt32 affinity_mask) {
+    uint64_t host_mask = 0;
+    for (int core = 0; core < GUEST_USER_CORE_COUNT; core++) {
+        const int host_core = scheduler.core_affinity[core];
+        // a thread without affinity can run on any core
+        const bool allowed = !(affinity_mask & SCE_KERNEL_CPU_MASK_USER_ALL) || (affinity_mask & (SCE_KERNEL_CPU_MASK_USER_0 << core));
+        if (host_core >= 0 && allowed)
+            host_mask |= 1ull << host_core;
+    }
+
+    return host_mask;
+}
+
+#ifdef _WIN32
+
+struct HostThread {
+    HANDLE handle = nullptr;
+
+    ~HostThread() {
+        if (handle)
+            CloseHandle(handle);
+    }
+};
+
+HostThreadPtr get_current_host_thread() {
+    const HostThreadPtr thread = std::make_shared<HostThread>();
+    // GetCurrentThread only returns a pseudo handle that can't be used from other threads
+    DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &thread->handle, 0, FALSE, DUPLICATE_SAME_ACCESS);
+    return thread;
+}
+
+void set_host_thread_priority(HostThread &thread, int priority) {
+    static constexpr int host_priorities[] = {
+        THREAD_PRIORITY_LOWEST,
+        THREAD_PRIORITY_BELOW_NORMAL,
+        THREAD_PRIORITY_NORMAL,
+        THREAD_PRIORITY_ABOVE_NORMAL,
+        THREAD_PRIORITY_HIGHEST,
+    };
+
+    if (!SetThreadPriority(thread.handle, host_priorities[get_priority_level(priority) + 2]))
+        LOG_WARN("Failed to set host thread priority, error: {}", GetLastError());
+}
+
+void set_host_thread_affinity(const HostThreadScheduler &scheduler, HostThread &thread, SceInt32 affinity_mask) {
+    DWORD_PTR host_mask = static_cast<DWORD_PTR>(get_host_core_mask(scheduler, affinity_mask));
+    if (!host_mask) {
+        DWORD_PTR system_mask;
+        GetProcessAffinityMask(GetCurrentProcess(), &host_mask, &system_mask);
+    }
+
+    if (!SetThreadAffinityMask(thread.handle, host_mask))
+        LOG_WARN("Failed to set host thread affinity to {:#x}, error: {}", host_mask, GetLastError());
+}
+
+uint64_t get_host_thread_cpu_time(const HostThread &thread) {
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (!GetThreadTimes(thread.handle, &creation_time, &exit_time, &kernel_time, &user_time))
+        return 0;
+
+    const auto to_100ns = [](const FILETIME &time) {
+        return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    };
+    return (to_100ns(kernel_time) + to_100ns(user_time)) / 10;
+}
+
+#else
+
+struct HostThread {
+    pthread_t handle;
+#ifdef __linux__
+    // nice values are set per kernel thread id
+    pid_t tid;
+    // nice value the thread started with, the guest priorities are mapped around it
+    int default_nice;
+#else
+    int policy;
+    int default_priority;
+#endif
+};
+
+HostThreadPtr get_current_host_thread() {
+    const HostThreadPtr thread = std::make_shared<HostThread>();
+    thread->handle = pthread_self();
+#ifdef __linux__
+    thread->tid = static_cast<pid_t>(syscall(SYS_gettid));
+    errno = 0;
+    thread->default_nice = getpriority(PRIO_PROCESS, thread->tid);
+    if (errno != 0)
+        thread->default_nice = 0;
+#else
+    sched_param param{};
+    pthread_getschedparam(thread->handle, &thread->policy, &param);
+    thread->default_priority = param.sched_priority;
+#endif
+    return thread;
+}
+
+#ifdef __linux__
+// Lowest nice value the process can set, a thread given a higher one can't go back below it.
+// Without CAP_SYS_NICE, RLIMIT_NICE bounds it to 20 - limit (the default limit of 0 can't lower it at all).
+static int get_lowest_nice() {
+    if (geteuid() == 0)
+        return -20;
+
+    rlimit limit;
+    if (getrlimit(RLIMIT_NICE, &limit) != 0)
+        return 20;
+    if (limit.rlim_cur == RLIM_INFINITY)
+        return -20;
+    return 20 - static_cast<int>(std::min<rlim_t>(limit.rlim_cur, 40));
+}
+
+// Set when a nice value couldn't be reverted, the threads then keep the one they started with
+static std::atomic<bool> nice_remap_disabled = false;
+#endif
+
+void set_host_thread_priority(HostThread &thread, int priority) {
+    const int level = get_priority_level(priority);
+#ifdef __linux__
+    if (nice_remap_disabled)
+        return;
+
+    // SCHED_OTHER has a single static priority on Linux, use the nice value instead. Only the values the
+    // process can go back from are used, so a thread given a low priority can get a higher one later.
+    static const int lowest_nice = get_lowest_nice();
+    if (lowest_nice > thread.default_nice) {
+        if (!nice_remap_disabled.exchange(true))
+            LOG_WARN("Host thread priorities are not remapped, a higher nice value couldn't be reverted without CAP_SYS_NICE or RLIMIT_NICE");
+        return;
+    }
+
+    const int nice = std::clamp(thread.default_nice - level * 5, lowest_nice, 19);
+    if (setpriority(PRIO_PROCESS, thread.tid, nice) != 0) {
+        const int error = errno;
+        if (!nice_remap_disabled.exchange(true))
+            LOG_WARN("Failed to set nice value {} for host thread {}, errno: {}, host thread priorities are no longer remapped", nice, thread.tid, error);
+        setpriority(PRIO_PROCESS, thread.tid, thread.default_nice);
+    }
+#else
+    const int min_priority = sched_get_priority_min(thread.policy);
+    const int max_priority = sched_get_priority_max(thread.policy);
+    sched_param param{};
+    param.sched_priority = std::clamp(thread.default_priority + level * (max_priority - min_priority) / 8, min_priority, max_priority);
+    if (const int error = pthread_setschedparam(thread.handle, thread.policy, &param))
+        LOG_WARN("Failed to set host thread priority to {}, error: {}", param.sched_priority, error);
+#endif
+}
+
+void set_host_thread_affinity(const HostThreadScheduler &scheduler, HostThread &thread, SceInt32 affinity_mask) {
+#ifdef __linux__
+    const uint64_t host_mask = get_host_core_mask(scheduler, affinity_mask);
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if (host_mask) {
+        for (int host_core = 0; host_core < MAX_HOST_CORES; host_core++) {
+            if (host_mask & (1ull << host_core))
+                CPU_SET(host_core, &cpu_set);
+        }
+    } else {
+        // none of the allowed guest cores are pinned, let it run anywhere
+        for (unsigned int host_core = 0; host_core < std::thread::hardware_concurrency(); host_core++)
+            CPU_SET(host_core, &cpu_set);
+    }
+
+    if (const int error = pthread_setaffinity_np(thread.handle, sizeof(cpu_set), &cpu_set))
+        LOG_WARN("Failed to set host thread affinity to {:#x}, error: {}", host_mask, error);
+#endif
+}
+
+uint64_t get_host_thread_cpu_time(const HostThread &thread) {
+#ifdef __APPLE__
+    const mach_port_t port = pthread_mach_thread_np(thread.handle);
+    thread_basic_info_data_t info;
+    mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+    if (thread_info(port, THREAD_BASIC_INFO, reinterpret_cast<thread_info_t>(&info), &count) != KERN_SUCCESS)
+        return 0;
+
+    return (info.user_time.seconds + info.system_time.seconds) * 1'000'000ull
+        + info.user_time.microseconds + info.system_time.microseconds;
+#else
+    clockid_t clock_id;
+    timespec time;
+    if (pthread_getcpuclockid(thread.handle, &clock_id) != 0 || clock_gettime(clock_id, &time) != 0)
+        return 0;
+
+    return static_cast<uint64_t>(time.tv_sec) * 1'000'000ull + time.tv_nsec / 1'000;
+#endif
+}
+
+#endif
@@ -0,0 +1,139 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/jit_cache.h>
+
+#include <cpu/functions.h>
+#include <kernel/state.h>
+#include <util/log.h>
+
+#include <algorithm>
+#include <optional>
+#include <thread>
+
+static constexpr uint32_t JIT_CACHE_VERSION = 2;
+static constexpr const char *JIT_CACHE_FILE_NAME = "jit-blocks.dat";
+
+// Maximum number of core numbers warmed at startup, the first created threads get them
+static constexpr uint32_t MAX_PREWARMED_JITS = 4;
+
+struct JitCacheEntry {
+    uint64_t module_hash;
+    Address pc;
+    uint32_t thumb;
+    uint32_t core_id;
+};
+
+// The hash is taken once the module is relocated, so a module loaded at
+// another address is seen as changed as well
+static std::optional<uint64_t> get_module_hash(KernelState &kernel, Address pc) {
+    const auto module = kernel.find_module_by_addr(pc);
+    if (!module)
+        return std::nullopt;
+
+    const auto lock = std::lock_guard(kernel.mutex);
+    const auto it = kernel.module_hashes.find(module->modid);
+    if (it == kernel.module_hashes.end())
+        return std::nullopt;
+
+    return it->second;
+}
+
+void load_jit_cache(KernelState &kernel, MemState &mem, const fs::path &cache_path) {
+    if (kernel.cpu_backend != CPUBackend::Dynarmic || !kernel.jit_pool)
+        return;
+
+    fs::ifstream cache_file(cache_path / JIT_CACHE_FILE_NAME, std::ios::in | std::ios::binary);
+    if (!cache_file.is_open())
+        return;
+
+    size_t size;
+    cache_file.read(reinterpret_cast<char *>(&size), sizeof(size));
+
+    uint32_t version_in_file;
+    cache_file.read(reinterpret_cast<char *>(&version_in_file), sizeof(version_in_file));
+    if (!cache_file || version_in_file != JIT_CACHE_VERSION) {
+        cache_file.close();
+        fs::remove(cache_path / JIT_CACHE_FILE_NAME);
+        LOG_WARN("Current version of JIT cache: {}, is outdated, recreate it.", version_in_file);
+        return;
+    }
+
+    // Each worker warms the jit of one core number with the blocks first translated on it,
+    // blocks of the core numbers past the workers are spread over them
+    const uint32_t worker_count = std::clamp(std::thread::hardware_concurrency(), 1u, MAX_PREWARMED_JITS);
+    std::vector<std::vector<JitBlock>> worker_blocks(worker_count);
+    size_t block_count = 0;
+    for (size_t i = 0; i < size; i++) {
+        JitCacheEntry entry;
+        if (!cache_file.read(reinterpret_cast<char *>(&entry), sizeof(entry)))
+            break;
+
+        if (get_module_hash(kernel, entry.pc) == entry.module_hash) {
+            worker_blocks[entry.core_id % worker_count].push_back({ entry.pc, entry.thumb != 0, entry.core_id });
+            block_count++;
+        }
+    }
+    cache_file.close();
+
+    LOG_INFO("Pre-translating {} of {} cached JIT blocks", block_count, size);
+    if (block_count == 0)
+        return;
+
+    std::vector<std::thread> workers;
+    for (uint32_t core_num = 0; core_num < worker_count; core_num++) {
+        if (worker_blocks[core_num].empty())
+            continue;
+
+        workers.emplace_back([&kernel, &mem, &worker_blocks, core_num]() {
+            prewarm_jit_pool(kernel.jit_pool, mem, kernel.cpu_protocol.get(), core_num, kernel.cpu_opt, worker_blocks[core_num]);
+        });
+    }
+    for (auto &worker : workers)
+        worker.join();
+}
+
+void save_jit_cache(KernelState &kernel, const fs::path &cache_path) {
+    if (kernel.cpu_backend != CPUBackend::Dynarmic || !kernel.jit_pool)
+        return;
+
+    std::vector<JitCacheEntry> entries;
+    for (const JitBlock &block : get_jit_pool_blocks(*kernel.jit_pool)) {
+        // code which doesn't belong to a module (generated at runtime) can't be checked on the next boot
+        const auto module_hash = get_module_hash(kernel, block.pc);
+        if (module_hash)
+            entries.push_back({ *module_hash, block.pc, block.thumb, block.core_id });
+    }
+
+    if (entries.empty())
+        return;
+
+    if (!fs::exists(cache_path))
+        fs::create_directories(cache_path);
+
+    fs::ofstream cache_file(cache_path / JIT_CACHE_FILE_NAME, std::ios::out | std::ios::binary);
+    if (!cache_file.is_open()) {
+        LOG_ERROR("Failed to save JIT cache to {}", cache_path.string());
+        return;
+    }
+
+    const size_t size = entries.size();
+    cache_file.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    cache_file.write(reinterpret_cast<const char *>(&JIT_CACHE_VERSION), sizeof(JIT_CACHE_VERSION));
+    cache_file.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(JitCacheEntry));
+    cache_file.close();
+}
@@ -24,6 +24,7 @@
 #include <kernel/thread/thread_state.h>
 
 #include <cpu/functions.h>
+#include <mem/functions.h>
 #include <mem/ptr.h>
 #include <util/align.h>
 #include <util/arm.h>
@@ -55,12 +56,14 @@ void CorenumAllocator::set_max_core_count(const std::size_t max) {
 struct ThreadParams {
     KernelState *kernel = nullptr;
     SceUID thid = SCE_KERNEL_ERROR_ILLEGAL_THREAD_ID;
+    HostThreadPtr *host_thread = nullptr;
     std::shared_ptr<SDL_semaphore> host_may_destroy_params = std::shared_ptr<SDL_semaphore>(SDL_CreateSemaphore(0), SDL_DestroySemaphore);
 };
 
 static int SDLCALL thread_function(void *data) {
     assert(data != nullptr);
     const ThreadParams params = *static_cast<const ThreadParams *>(data);
+    *params.host_thread = get_current_host_thread();
     SDL_SemPost(params.host_may_destroy_params.get());
     const ThreadStatePtr thread = lock_and_find(params.thid, params.kernel->threads, params.kernel->mutex);
 #ifdef TRACY_ENABLE
@@ -72,6 +75,7 @@ static int SDLCALL thread_function(void *data) {
     }
 #endif
 
+    set_allocation_thread_id(thread->id);
     thread->run_loop();
     const uint32_t r0 = read_reg(*thread->cpu, 0);
 
@@ -83,7 +87,9 @@ static int SDLCALL thread_function(void *data) {
 }
 
 KernelState::KernelState()
-    : debugger(*this) {
+    : debugger(*this)
+    , profiler(*this)
+    , save_states(*this) {
 }
 
 bool KernelState::init(MemState &mem, CallImportFunc call_import, CPUBackend cpu_backend, bool cpu_opt) {
@@ -91,6 +97,8 @@ bool KernelState::init(MemState &mem, CallImportFunc call_import, CPUBackend cpu
 
     corenum_allocator.set_max_core_count(MAX_CORE_COUNT);
     exclusive_monitor = new_exclusive_monitor(MAX_CORE_COUNT);
+    set_spin_detection(exclusive_monitor, park_spinning_threads);
+    jit_pool = new_jit_pool();
     start_tick = rtc_get_ticks(rtc_base_ticks());
     base_tick = { rtc_base_ticks() };
     cpu_protocol = std::make_unique<CPUProtocol>(*this, mem, call_import);
@@ -110,30 +118,26 @@ void KernelState::load_process_param(MemState &mem, Ptr<uint32_t> ptr) {
     process_param = ptr.cast<SceProcessParam>();
 }
 
-void KernelState::set_memory_watch(bool enabled) {
-    std::lock_guard<std::mutex> lock(mutex);
-    for (const auto &thread : threads) {
-        auto &cpu = *thread.second->cpu;
-        if (enabled != get_log_mem(cpu)) {
-            if (enabled)
-                set_log_mem(cpu, true);
-            else
-                set_log_mem(cpu, false);
-        }
-    }
-}
-
 void KernelState::invalidate_jit_cache(Address start, size_t length) {
-    std::lock_guard<std::mutex> lock(mutex);
-    for (auto thread : threads) {
-        ::invalidate_jit_cache(*thread.second->cpu, start, length);
-    }
+    // the jit pool keeps track of every jit, including the ones not owned by a thread anymore,
+    // and queues the range for the running ones so it is safe to call from any thread
+    ::invalidate_jit_pool(*jit_pool, start, length);
 }
 
 ThreadStatePtr KernelState::get_thread(SceUID thread_id) {
     return lock_and_find(thread_id, threads, mutex);
 }
 
+void KernelState::update_host_thread(ThreadState &thread) {
+    if (!thread.host_thread)
+        return;
+
+    if (host_thread_scheduler.map_priority)
+        set_host_thread_priority(*thread.host_thread, thread.priority);
+    if (host_thread_scheduler.has_core_affinity())
+        set_host_thread_affinity(host_thread_scheduler, *thread.host_thread, thread.affinity_mask);
+}
+
 ThreadStatePtr KernelState::create_thread(MemState &mem, const char *name, Ptr<const void> entry_point) {
     constexpr size_t DEFAULT_STACK_SIZE = 0x1000;
     return create_thread(mem, name, entry_point, SCE_KERNEL_DEFAULT_PRIORITY, SCE_KERNEL_THREAD_CPU_AFFINITY_MASK_DEFAULT, DEFAULT_STACK_SIZE, nullptr);
@@ -149,9 +153,11 @@ ThreadStatePtr KernelState::create_thread(MemState &mem, const char *name, Ptr<c
     ThreadParams params;
     params.kernel = this;
     params.thid = thread->id;
+    params.host_thread = &thread->host_thread;
 
     SDL_CreateThread(&thread_function, thread->name.c_str(), &params);
     SDL_SemWait(params.host_may_destroy_params.get());
+    update_host_thread(*thread);
     return thread;
 }
 
@@ -178,7 +184,8 @@ void KernelState::pause_threads() {
     const std::lock_guard<std::mutex> lock(mutex);
     for (auto [_, thread] : threads) {
         paused_threads_status[thread->id] = thread->status;
-        if (thread->status == ThreadStatus::run)
+        // a waiting thread stops once its HLE call returns
+        if (thread->status == ThreadStatus::run || thread->status == ThreadStatus::wait)
             thread->suspend();
     }
 }
@@ -186,12 +193,26 @@ void KernelState::pause_threads() {
 void KernelState::resume_threads() {
     const std::lock_guard<std::mutex> lock(mutex);
     for (auto [_, thread] : threads) {
-        if (paused_threads_status[thread->id] == ThreadStatus::run)
+        const ThreadStatus status = paused_threads_status[thread->id];
+        if (status == ThreadStatus::run || status == ThreadStatus::wait)
             thread->resume();
     }
     paused_threads_status.clear();
 }
 
+void KernelState::resume_paused_thread(SceUID thread_id) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto status = paused_threads_status.find(thread_id);
+    const auto thread = threads.find(thread_id);
+    if (status == paused_threads_status.end() || thread == threads.end())
+        return;
+
+    if (status->second == ThreadStatus::run || status->second == ThreadStatus::wait)
+        thread->second->resume();
+    // resume_threads leaves it
+    status->second = ThreadStatus::dormant;
+}
+
 std::shared_ptr<SceKernelModuleInfo> KernelState::find_module_by_addr(Address address) {
     const auto lock = std::lock_guard(mutex);
     for (auto [_, mod] : loaded_modules) {
@@ -35,6 +35,7 @@
 // clang-format on
 #include <miniz.h>
 #include <self.h>
+#include <xxh3.h>
 
 #include <cassert>
 #include <cstring>
@@ -87,7 +88,7 @@ static bool load_var_imports(const uint32_t *nids, const Ptr<uint32_t> *entries,
                 constexpr auto STUB_SYMVAL = 0xDEADBEEF;
                 LOG_WARN("\tNID NOT FOUND {} ({}) at {}, setting to stub value {}", log_hex(nid), name, log_hex(entry.address()), log_hex(STUB_SYMVAL));
 
-                auto alloc_name = fmt::format("Stub var import reloc symval, NID {} ({})", log_hex(nid), name);
+                auto alloc_name = fmt::format("Stub var import reloc symval: NID {} ({})", log_hex(nid), name);
                 auto stub_symval_ptr = Ptr<uint32_t>(alloc(mem, 4, alloc_name.c_str()));
                 *stub_symval_ptr.get(mem) = STUB_SYMVAL;
 
@@ -227,6 +228,7 @@ static bool load_func_exports(Ptr<const void> &entry_point, const uint32_t *nids
         {
             const std::unique_lock<std::shared_mutex> lock(kernel.export_nids_mutex);
             kernel.export_nids.emplace(nid, entry.address());
+            kernel.export_nids_generation++;
         }
 
         if (kernel.debugger.log_exports) {
@@ -283,12 +285,9 @@ static bool load_var_exports(const uint32_t *nids, const Ptr<uint32_t> *entries,
                     auto &late_binding_info_v = i->second;
                     if (late_binding_info_v.size > 0) {
                         if (last_module_nid != late_binding_info_v.module_nid) {
-                            // TODO: uncomment when invalidate_jit_cache will be thread safe
-                            /* if (!seg.empty()) {
-                                for (const auto &[key, value] : seg) {
-                                    kernel.invalidate_jit_cache(value.addr, value.size);
-                                }
-                            }*/
+                            for (const auto &[key, value] : seg) {
+                                kernel.invalidate_jit_cache(value.addr, value.size);
+                            }
                             seg.clear();
                             const auto module_info = kernel.loaded_modules[kernel.module_uid_by_nid[late_binding_info_v.module_nid]];
                             if (!module_info) {
@@ -319,14 +318,9 @@ static bool load_var_exports(const uint32_t *nids, const Ptr<uint32_t> *entries,
             }
         }
     }
-    // TODO: uncomment when invalidate_jit_cache will be thread safe
-    /*
-    if (!seg.empty()) {
-        for (const auto &[key, value] : seg) {
-            kernel.invalidate_jit_cache(value.addr, value.size);
-        }
+    for (const auto &[key, value] : seg) {
+        kernel.invalidate_jit_cache(value.addr, value.size);
     }
-    */
     return true;
 }
 
@@ -486,7 +480,7 @@ SceUID load_self(Ptr<const void> &entry_point, KernelState &kernel, MemState &me
         } else if (seg_header.p_type == PT_LOAD) {
             if (seg_header.p_memsz != 0) {
                 Address segment_address = 0;
-                auto alloc_name = fmt::format("{}:seg%d", self_path, seg_index);
+                auto alloc_name = fmt::format("Module segment: {}:seg{}", self_path, seg_index);
 
                 // TODO: when the virtual process bringup is fixed, uncomment this
                 // Try allocating at image base for RELEXEC to avoid having to relocate the main module
@@ -654,11 +648,19 @@ SceUID load_self(Ptr<const void> &entry_point, KernelState &kernel, MemState &me
     sceKernelModuleInfo->start_entry = entry_point;
     // TODO: module_stop
 
+    // Only the bytes loaded from the file are hashed, the rest of the segment is zero filled
+    uint64_t module_hash = 0;
+    for (const SceKernelSegmentInfo &segment : sceKernelModuleInfo->segments) {
+        if (segment.filesz)
+            module_hash = XXH_INLINE_XXH3_64bits_withSeed(segment.vaddr.get(mem), segment.filesz, module_hash);
+    }
+
     const SceUID uid = kernel.get_next_uid();
     sceKernelModuleInfo->modid = uid;
     {
         const std::lock_guard<std::mutex> lock(kernel.mutex);
         kernel.loaded_modules.emplace(uid, sceKernelModuleInfo);
+        kernel.module_hashes.emplace(uid, module_hash);
     }
     {
         const std::lock_guard<std::shared_mutex> lock(kernel.export_nids_mutex);
@@ -0,0 +1,201 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/profiler.h>
+
+#include <cpu/functions.h>
+#include <kernel/state.h>
+#include <kernel/thread/thread_state.h>
+#include <nids/functions.h>
+#include <util/log.h>
+
+#include <algorithm>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// How often the sampler picks up the threads created since
+constexpr std::chrono::milliseconds THREAD_LIST_REFRESH_INTERVAL{ 100 };
+
+// Names guest addresses after the module they belong to and the closest function it exports
+class Symbolizer {
+    KernelState &kernel;
+    std::vector<std::pair<Address, uint32_t>> exports;
+    std::unordered_map<Address, std::string> names;
+
+public:
+    explicit Symbolizer(KernelState &kernel)
+        : kernel(kernel) {
+        const std::shared_lock<std::shared_mutex> lock(kernel.export_nids_mutex);
+        exports.reserve(kernel.export_nids.size());
+        for (const auto &[nid, address] : kernel.export_nids)
+            exports.emplace_back(address & ~1, nid);
+        std::sort(exports.begin(), exports.end());
+    }
+
+    const std::string &get_name(Address address) {
+        address &= ~1;
+        const auto cached = names.find(address);
+        if (cached != names.end())
+            return cached->second;
+
+        return names[address] = make_name(address);
+    }
+
+private:
+    std::string make_name(Address address) {
+        const auto module = kernel.find_module_by_addr(address);
+        if (!module)
+            return fmt::format("0x{:08X}", address);
+
+        Address segment_start = 0;
+        for (const auto &segment : module->segments) {
+            if (segment.size && segment.vaddr.address() <= address && address <= segment.vaddr.address() + segment.memsz) {
+                segment_start = segment.vaddr.address();
+                break;
+            }
+        }
+
+        // the closest export before the address, if it is in the same segment
+        const auto next = std::upper_bound(exports.begin(), exports.end(), std::make_pair(address, UINT32_MAX));
+        if (next != exports.begin() && std::prev(next)->first >= segment_start) {
+            const auto &[export_address, nid] = *std::prev(next);
+            if (address == export_address)
+                return fmt::format("{}!{}", module->module_name, import_name(nid));
+            return fmt::format("{}!{}+0x{:X}", module->module_name, import_name(nid), address - export_address);
+        }
+
+        return fmt::format("{}+0x{:X}", module->module_name, address - segment_start);
+    }
+};
+
+} // namespace
+
+Profiler::Profiler(KernelState &kernel)
+    : parent(kernel) {
+}
+
+Profiler::~Profiler() {
+    stop();
+}
+
+void Profiler::start(std::chrono::microseconds interval) {
+    if (running)
+        return;
+
+    running = true;
+    sampler = std::thread([this, interval] { sample_loop(interval); });
+}
+
+void Profiler::stop() {
+    {
+        const std::lock_guard<std::mutex> lock(running_mutex);
+        running = false;
+    }
+    running_cond.notify_all();
+    if (sampler.joinable())
+        sampler.join();
+}
+
+void Profiler::reset() {
+    const std::lock_guard<std::mutex> lock(samples_mutex);
+    samples.clear();
+    thread_names.clear();
+    sample_count = 0;
+}
+
+void Profiler::sample_loop(std::chrono::microseconds interval) {
+    // The thread list is copied from the kernel now and then instead of locking it at every sample,
+    // the copy keeps the exited threads alive until the next refresh
+    std::vector<std::pair<SceUID, ThreadStatePtr>> threads;
+    auto threads_refresh = std::chrono::steady_clock::time_point();
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(running_mutex);
+            if (running_cond.wait_for(lock, interval, [&] { return !running; }))
+                return;
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now - threads_refresh >= THREAD_LIST_REFRESH_INTERVAL) {
+            threads_refresh = now;
+            threads.clear();
+            const std::lock_guard<std::mutex> kernel_lock(parent.mutex);
+            threads.assign(parent.threads.begin(), parent.threads.end());
+        }
+
+        const std::lock_guard<std::mutex> samples_lock(samples_mutex);
+        for (const auto &[id, thread] : threads) {
+            if (thread->status != ThreadStatus::run || !thread->cpu)
+                continue;
+
+            samples[{ id, read_pc(*thread->cpu), read_lr(*thread->cpu) }]++;
+            if (!thread_names.contains(id))
+                thread_names.emplace(id, thread->name);
+            sample_count++;
+        }
+    }
+}
+
+std::string Profiler::get_collapsed_stacks() {
+    // don't keep the samples locked while symbolizing, it locks the kernel
+    std::map<SampleKey, uint64_t> samples_copy;
+    std::map<SceUID, std::string> names_copy;
+    {
+        const std::lock_guard<std::mutex> lock(samples_mutex);
+        samples_copy = samples;
+        names_copy = thread_names;
+    }
+
+    Symbolizer symbolizer(parent);
+    std::map<std::string, uint64_t> stacks;
+    for (const auto &[key, count] : samples_copy) {
+        const auto &[thread_id, pc, lr] = key;
+        // ';' separates the frames
+        std::string stack = names_copy[thread_id];
+        std::replace(stack.begin(), stack.end(), ';', '_');
+        // the LR is only the caller in leaf functions, elsewhere it can be stale
+        if (lr)
+            stack += ';' + symbolizer.get_name(lr);
+        stack += ';' + symbolizer.get_name(pc);
+        stacks[stack] += count;
+    }
+
+    std::ostringstream output;
+    for (const auto &[stack, count] : stacks)
+        output << stack << ' ' << count << '\n';
+    return output.str();
+}
+
+bool Profiler::save_collapsed_stacks(const fs::path &path) {
+    const std::string stacks = get_collapsed_stacks();
+
+    if (path.has_parent_path() && !fs::exists(path.parent_path()))
+        fs::create_directories(path.parent_path());
+
+    fs::ofstream file(path, std::ios::out | std::ios::binary);
+    if (!file.is_open()) {
+        LOG_ERROR("Failed to save guest profile to {}", path.string());
+        return false;
+    }
+
+    file << stacks;
+    LOG_INFO("Saved {} guest profiler samples to {}", get_sample_count(), path.string());
+    return true;
+}
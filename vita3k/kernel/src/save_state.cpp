@@ -0,0 +1,300 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/save_state.h>
+
+#include <cpu/functions.h>
+#include <kernel/state.h>
+#include <kernel/thread/thread_state.h>
+#include <util/log.h>
+
+#include <thread>
+
+// Time given to the running threads to leave the HLE call they are in
+constexpr std::chrono::seconds STOP_TIMEOUT{ 1 };
+// Time given to a thread which was waiting to wait again, before the next one is resumed
+constexpr std::chrono::milliseconds REQUEUE_TIMEOUT{ 20 };
+
+SaveStates::SaveStates(KernelState &kernel)
+    : parent(kernel) {
+}
+
+static std::vector<ThreadStatePtr> get_threads(KernelState &kernel) {
+    const std::lock_guard<std::mutex> lock(kernel.mutex);
+    std::vector<ThreadStatePtr> threads;
+    for (const auto &[_, thread] : kernel.threads)
+        threads.push_back(thread);
+    return threads;
+}
+
+// The status is polled, status_cond is waited on with the mutexes of the sync primitives elsewhere
+static ThreadStatus get_status(ThreadState &thread) {
+    const std::lock_guard<std::mutex> lock(thread.mutex);
+    return thread.status;
+}
+
+static void save_wait_queue(SaveState &state, ThreadDataQueue<WaitingThreadData> &queue) {
+    std::vector<SceUID> thread_ids;
+    for (auto it = queue.begin(); it != queue.end(); ++it)
+        thread_ids.push_back((*it).thread->id);
+    if (!thread_ids.empty())
+        state.wait_queues.push_back(std::move(thread_ids));
+}
+
+template <typename T>
+static void save_wait_queues(SaveState &state, const HandleTable<T> &table) {
+    for (const auto &[_, primitive] : table.get_all()) {
+        const std::lock_guard<std::mutex> lock(primitive->mutex);
+        save_wait_queue(state, *primitive->waiting_threads);
+    }
+}
+
+// Suspends the running threads. Returns false if they were already paused.
+bool SaveStates::stop_threads() {
+    if (parent.is_threads_paused())
+        return false;
+
+    parent.pause_threads();
+    return true;
+}
+
+// Waits for the suspended threads to stop. Returns the threads still inside a HLE call, blocked in a wait
+// or running it for longer than STOP_TIMEOUT.
+std::set<SceUID> SaveStates::wait_threads_stopped() {
+    std::set<SceUID> in_hle_call;
+    const auto deadline = std::chrono::steady_clock::now() + STOP_TIMEOUT;
+    for (const ThreadStatePtr &thread : get_threads(parent)) {
+        for (;;) {
+            const ThreadStatus status = get_status(*thread);
+            if (status == ThreadStatus::wait || (status == ThreadStatus::run && std::chrono::steady_clock::now() >= deadline)) {
+                in_hle_call.insert(thread->id);
+                break;
+            }
+            if (status != ThreadStatus::run)
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    return in_hle_call;
+}
+
+// Makes the threads leave their HLE call, the context loaded would be overwritten when it returns.
+// The sync primitives check wait_aborted under their own mutex, so the notification is repeated until they see it.
+void SaveStates::cancel_waits(const std::set<SceUID> &in_hle_call) {
+    std::vector<ThreadStatePtr> threads;
+    for (const SceUID id : in_hle_call) {
+        if (const ThreadStatePtr thread = parent.get_thread(id))
+            threads.push_back(thread);
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + STOP_TIMEOUT;
+    for (;;) {
+        std::erase_if(threads, [](const ThreadStatePtr &thread) {
+            const ThreadStatus status = get_status(*thread);
+            return status != ThreadStatus::run && status != ThreadStatus::wait;
+        });
+        if (threads.empty())
+            return;
+        if (std::chrono::steady_clock::now() >= deadline)
+            break;
+
+        for (const ThreadStatePtr &thread : threads)
+            thread->abort_wait();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    for (const ThreadStatePtr &thread : threads)
+        LOG_WARN("Thread {} ({}) is still in its HLE call, its context is loaded once the call returns", thread->name, thread->id);
+}
+
+// The threads which were waiting make their call again first, in the order of the wait queues,
+// so that they are woken up in the same order as after the save
+void SaveStates::resume_threads(const SaveState &state) {
+    std::set<SceUID> resumed;
+    for (const auto &queue : state.wait_queues) {
+        for (const SceUID id : queue) {
+            if (!resumed.insert(id).second)
+                continue;
+            const ThreadStatePtr thread = parent.get_thread(id);
+            if (!thread)
+                continue;
+
+            parent.resume_paused_thread(id);
+            const auto deadline = std::chrono::steady_clock::now() + REQUEUE_TIMEOUT;
+            while (get_status(*thread) != ThreadStatus::wait && std::chrono::steady_clock::now() < deadline)
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    parent.resume_threads();
+}
+
+void SaveStates::save(MemState &mem) {
+    const auto begin = std::chrono::steady_clock::now();
+    const bool resume = stop_threads();
+    const std::set<SceUID> in_hle_call = wait_threads_stopped();
+
+    SaveState state;
+    state.time = std::time(nullptr);
+    state.mem = take_snapshot(mem);
+    state.stored_size = state.mem->data.size();
+    {
+        const std::lock_guard<std::mutex> lock(parent.mutex);
+        for (const auto &[id, thread] : parent.threads) {
+            if (thread->cpu)
+                state.thread_contexts.emplace(id, thread->get_resumable_context(in_hle_call.contains(id)));
+        }
+        for (const auto &[id, semaphore] : parent.semaphores.get_all())
+            state.semaphore_values.emplace(id, semaphore->val);
+        for (const auto &[id, eventflag] : parent.eventflags.get_all())
+            state.eventflag_flags.emplace(id, eventflag->flags);
+        for (const auto &[id, event] : parent.simple_events.get_all())
+            state.simple_event_patterns.emplace(id, event->pattern);
+        for (const auto &[id, mutex] : parent.mutexes.get_all())
+            state.mutex_locks.emplace(id, std::make_pair(mutex->lock_count, mutex->owner ? mutex->owner->id : 0));
+        for (const auto &[id, msgpipe] : parent.msgpipes.get_all()) {
+            std::vector<uint8_t> data(msgpipe->data_buffer.Used());
+            msgpipe->data_buffer.Peek(data.data(), data.size(), 0);
+            state.msgpipe_data.emplace(id, std::move(data));
+        }
+    }
+
+    // the primitives are locked after the kernel elsewhere, don't hold both
+    save_wait_queues(state, parent.simple_events);
+    save_wait_queues(state, parent.semaphores);
+    save_wait_queues(state, parent.condvars);
+    save_wait_queues(state, parent.lwcondvars);
+    save_wait_queues(state, parent.mutexes);
+    save_wait_queues(state, parent.lwmutexes);
+    save_wait_queues(state, parent.rwlocks);
+    save_wait_queues(state, parent.eventflags);
+    for (const auto &[_, msgpipe] : parent.msgpipes.get_all()) {
+        const std::lock_guard<std::mutex> lock(msgpipe->mutex);
+        save_wait_queue(state, *msgpipe->senders);
+        save_wait_queue(state, *msgpipe->receivers);
+    }
+    for (const ThreadStatePtr &thread : get_threads(parent)) {
+        const std::lock_guard<std::mutex> lock(thread->mutex);
+        std::vector<SceUID> thread_ids;
+        for (const ThreadStatePtr &waiter : thread->waiting_threads)
+            thread_ids.push_back(waiter->id);
+        if (!thread_ids.empty())
+            state.wait_queues.push_back(std::move(thread_ids));
+    }
+
+    if (resume)
+        parent.resume_threads();
+
+    state.save_duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin);
+    LOG_INFO("Saved state {}: {} MiB allocated, {} KiB stored in {} ms, {} threads in a HLE call", states.size(), state.mem->allocated_size / MiB(1),
+        state.stored_size / KiB(1), state.save_duration.count() / 1000, in_hle_call.size());
+    states.push_back(std::move(state));
+}
+
+bool SaveStates::load(MemState &mem, size_t index) {
+    if (index >= states.size())
+        return false;
+
+    const SaveState &state = states[index];
+    const bool resume = stop_threads();
+    cancel_waits(wait_threads_stopped());
+
+    restore_snapshot(mem, state.mem);
+
+    // the primitives are locked after the kernel elsewhere, don't hold both
+    const HandleReadGuard guard;
+    std::vector<std::pair<Semaphore *, int>> semaphores;
+    std::vector<std::pair<EventFlag *, int>> eventflags;
+    std::vector<std::pair<SimpleEvent *, SceUInt32>> simple_events;
+    std::vector<std::tuple<Mutex *, int, ThreadStatePtr>> mutexes;
+    std::vector<std::pair<MsgPipe *, const std::vector<uint8_t> *>> msgpipes;
+    {
+        const std::lock_guard<std::mutex> lock(parent.mutex);
+        for (const auto &[id, context] : state.thread_contexts) {
+            const auto thread = parent.threads.find(id);
+            if (thread != parent.threads.end() && !thread->second->set_restored_context(context))
+                LOG_WARN("Thread {} ({}) is dormant, its context is not restored", thread->second->name, id);
+        }
+        for (const auto &[id, value] : state.semaphore_values) {
+            if (const auto semaphore = parent.semaphores.get(id))
+                semaphores.emplace_back(semaphore, value);
+        }
+        for (const auto &[id, flags] : state.eventflag_flags) {
+            if (const auto eventflag = parent.eventflags.get(id))
+                eventflags.emplace_back(eventflag, flags);
+        }
+        for (const auto &[id, pattern] : state.simple_event_patterns) {
+            if (const auto event = parent.simple_events.get(id))
+                simple_events.emplace_back(event, pattern);
+        }
+        for (const auto &[id, lock] : state.mutex_locks) {
+            if (const auto mutex = parent.mutexes.get(id)) {
+                const auto owner = parent.threads.find(lock.second);
+                mutexes.emplace_back(mutex, lock.first, owner != parent.threads.end() ? owner->second : nullptr);
+            }
+        }
+        for (const auto &[id, data] : state.msgpipe_data) {
+            if (const auto msgpipe = parent.msgpipes.get(id))
+                msgpipes.emplace_back(msgpipe, &data);
+        }
+
+        // the code of the modules may have been patched since the save
+        for (const auto &[_, module] : parent.loaded_modules) {
+            for (const auto &segment : module->segments) {
+                if (segment.size)
+                    parent.invalidate_jit_cache(segment.vaddr.address(), segment.memsz);
+            }
+        }
+    }
+
+    for (const auto &[semaphore, value] : semaphores) {
+        const std::lock_guard<std::mutex> lock(semaphore->mutex);
+        semaphore->val = value;
+    }
+    for (const auto &[eventflag, flags] : eventflags) {
+        const std::lock_guard<std::mutex> lock(eventflag->mutex);
+        eventflag->flags = flags;
+    }
+    for (const auto &[event, pattern] : simple_events) {
+        const std::lock_guard<std::mutex> lock(event->mutex);
+        event->pattern = pattern;
+    }
+    for (const auto &[mutex, lock_count, owner] : mutexes) {
+        const std::lock_guard<std::mutex> lock(mutex->mutex);
+        mutex->lock_count = lock_count;
+        mutex->owner = owner;
+    }
+    for (const auto &[msgpipe, data] : msgpipes) {
+        const std::lock_guard<std::mutex> lock(msgpipe->mutex);
+        const std::lock_guard<std::mutex> send_lock(msgpipe->send_mutex);
+        std::vector<uint8_t> discarded(msgpipe->data_buffer.Used());
+        msgpipe->data_buffer.Remove(discarded.data(), discarded.size(), 0);
+        msgpipe->data_buffer.Insert(data->data(), data->size(), 0);
+    }
+
+    if (resume)
+        resume_threads(state);
+
+    LOG_INFO("Loaded state {}", index);
+    return true;
+}
+
+void SaveStates::clear(MemState &mem) {
+    states.clear();
+    reset_snapshots(mem);
+}
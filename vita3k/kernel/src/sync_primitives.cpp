@@ -20,6 +20,7 @@
 #include <kernel/sync_primitives.h>
 
 #include <kernel/types.h>
+#include <mem/atomic.h>
 #include <util/lock_and_find.h>
 #include <util/log.h>
 
@@ -49,9 +50,9 @@ inline CondvarPtrs &get_condvars(KernelState &kernel, SyncWeight weight) {
     return weight == SyncWeight::Light ? kernel.lwcondvars : kernel.condvars;
 }
 
-inline int find_mutex(MutexPtr &mutex_out, MutexPtrs **mutexes_out, KernelState &kernel, const char *export_name, SceUID mutexid, SyncWeight weight) {
+inline int find_mutex(Mutex *&mutex_out, MutexPtrs **mutexes_out, KernelState &kernel, const char *export_name, SceUID mutexid, SyncWeight weight) {
     MutexPtrs &mutexes = get_mutexes(kernel, weight);
-    mutex_out = lock_and_find(mutexid, mutexes, kernel.mutex);
+    mutex_out = mutexes.get(mutexid);
     if (!mutex_out) {
         return unknown_mutex_id(export_name, weight);
     }
@@ -62,9 +63,9 @@ inline int find_mutex(MutexPtr &mutex_out, MutexPtrs **mutexes_out, KernelState
     return SCE_KERNEL_OK;
 }
 
-inline int find_condvar(CondvarPtr &condvar_out, CondvarPtrs **condvars_out, KernelState &kernel, const char *export_name, SceUID condid, SyncWeight weight) {
+inline int find_condvar(Condvar *&condvar_out, CondvarPtrs **condvars_out, KernelState &kernel, const char *export_name, SceUID condid, SyncWeight weight) {
     CondvarPtrs &condvars = get_condvars(kernel, weight);
-    condvar_out = lock_and_find(condid, condvars, kernel.mutex);
+    condvar_out = condvars.get(condid);
     if (!condvar_out) {
         return unknown_cond_id(export_name, weight);
     }
@@ -75,19 +76,27 @@ inline int find_condvar(CondvarPtr &condvar_out, CondvarPtrs **condvars_out, Ker
     return SCE_KERNEL_OK;
 }
 
+// The calls which may block keep the primitive they found and don't hold the HandleReadGuard while waiting,
+// it would keep the objects erased from every table from being released for as long as they wait
+template <typename T>
+inline std::shared_ptr<T> keep_primitive(T *primitive) {
+    return primitive ? std::static_pointer_cast<T>(primitive->shared_from_this()) : nullptr;
+}
+
 // TODO: Write remaining time to timeout ptr when it's successfully signaled
 // Assumes primitive_lock is locked and thread_lock is unlocked
-inline int handle_timeout(const ThreadStatePtr &thread, std::unique_lock<std::mutex> &thread_lock,
-    std::unique_lock<std::mutex> &primitive_lock, WaitingThreadQueuePtr &queue,
+inline int handle_timeout(KernelState &kernel, const ThreadStatePtr &thread, std::unique_lock<std::mutex> &thread_lock,
+    std::unique_lock<std::mutex> &primitive_lock, SyncPrimitive *primitive, WaitingThreadQueuePtr &queue,
     const WaitingThreadData &data, const ThreadDataQueueInterator<WaitingThreadData> &data_it,
     const char *export_name, SceUInt *const timeout) {
     if (timeout) {
         bool status = false;
         auto start = std::chrono::steady_clock::now();
         if (*timeout > 0) {
-            status = thread->status_cond.wait_for(primitive_lock, std::chrono::microseconds{ *timeout }, [&] { return thread->status == ThreadStatus::run; });
+            status = kernel.timer_wheel.wait_for(primitive_lock, std::shared_ptr<std::mutex>(primitive->shared_from_this(), &primitive->mutex),
+                std::shared_ptr<std::condition_variable>(thread, &thread->status_cond), std::chrono::microseconds{ *timeout },
+                [&] { return thread->status == ThreadStatus::run || thread->wait_aborted; });
         }
-
         if (!status) {
             *timeout = 0; // Time run out, so remaining time is 0
 
@@ -108,7 +117,18 @@ inline int handle_timeout(const ThreadStatePtr &thread, std::unique_lock<std::mu
             }
         }
     } else {
-        thread->status_cond.wait(primitive_lock, [&] { return thread->status == ThreadStatus::run; });
+        thread->status_cond.wait(primitive_lock, [&] { return thread->status == ThreadStatus::run || thread->wait_aborted; });
+    }
+
+    if (thread->status != ThreadStatus::run) {
+        // a savestate is being loaded
+        thread_lock.lock();
+        thread->update_status(ThreadStatus::run, ThreadStatus::wait);
+        thread_lock.unlock();
+
+        queue->erase(data_it);
+
+        return RET_ERROR(SCE_KERNEL_ERROR_WAIT_CANCEL);
     }
 
     return SCE_KERNEL_OK;
@@ -123,15 +143,7 @@ SceUID simple_event_create(KernelState &kernel, MemState &mem, const char *expor
         return RET_ERROR(SCE_KERNEL_ERROR_UID_NAME_TOO_LONG);
     }
 
-    const SceUID uid = kernel.get_next_uid();
-
-    if (LOG_SYNC_PRIMITIVES) {
-        LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} pattern: {:#b}",
-            export_name, uid, thread_id, name, attr, init_pattern);
-    }
-
     const SimpleEventPtr event = std::make_shared<SimpleEvent>();
-    event->uid = uid;
     event->pattern = init_pattern;
     std::copy(name, name + KERNELOBJECT_MAX_NAME_LENGTH, event->name);
     event->attr = attr;
@@ -145,14 +157,24 @@ SceUID simple_event_create(KernelState &kernel, MemState &mem, const char *expor
     event->auto_reset = (event->attr & SCE_KERNEL_EVENT_ATTR_AUTO_RESET);
     event->cb_wakeup_only = (event->attr & SCE_KERNEL_ATTR_NOTIFY_CB_WAKEUP_ONLY);
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
-    kernel.simple_events.emplace(uid, event);
+    const SceUID uid = kernel.simple_events.add(event);
+    if (!uid)
+        return RET_ERROR(SCE_KERNEL_ERROR_UID_MAX_OPEN);
+
+    if (LOG_SYNC_PRIMITIVES) {
+        LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} pattern: {:#b}",
+            export_name, uid, thread_id, name, attr, init_pattern);
+    }
 
     return uid;
 }
 
 SceInt32 simple_event_waitorpoll(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, SceUInt32 wait_pattern, SceUInt32 *result_pattern, SceUInt64 *user_data, SceUInt32 *timeout, bool is_wait) {
-    const SimpleEventPtr event = lock_and_find(event_id, kernel.simple_events, kernel.mutex);
+    SimpleEventPtr event;
+    {
+        const HandleReadGuard guard;
+        event = keep_primitive(kernel.simple_events.get(event_id));
+    }
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVENT_ID);
     }
@@ -194,7 +216,7 @@ SceInt32 simple_event_waitorpoll(KernelState &kernel, const char *export_name, S
         const auto data_it = event->waiting_threads->push(data);
         thread_lock.unlock();
 
-        const int err = handle_timeout(thread, thread_lock, event_lock, event->waiting_threads, data, data_it, export_name, timeout);
+        const int err = handle_timeout(kernel, thread, thread_lock, event_lock, event.get(), event->waiting_threads, data, data_it, export_name, timeout);
         if (err < 0) {
             // set it only if a timeout occurs
             // otherwise set in simple_event_setorpulse
@@ -210,7 +232,8 @@ SceInt32 simple_event_waitorpoll(KernelState &kernel, const char *export_name, S
 }
 
 SceInt32 simple_event_setorpulse(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, SceUInt32 pattern, SceUInt64 user_data, bool is_set) {
-    const SimpleEventPtr event = lock_and_find(event_id, kernel.simple_events, kernel.mutex);
+    const HandleReadGuard guard;
+    SimpleEvent *const event = kernel.simple_events.get(event_id);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVENT_ID);
     }
@@ -265,7 +288,8 @@ SceInt32 simple_event_setorpulse(KernelState &kernel, const char *export_name, S
 }
 
 SceInt32 simple_event_clear(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, SceUInt32 clear_pattern) {
-    const SimpleEventPtr event = lock_and_find(event_id, kernel.simple_events, kernel.mutex);
+    const HandleReadGuard guard;
+    SimpleEvent *const event = kernel.simple_events.get(event_id);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVENT_ID);
     }
@@ -283,7 +307,8 @@ SceInt32 simple_event_clear(KernelState &kernel, const char *export_name, SceUID
 }
 
 SceInt32 simple_event_delete(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id) {
-    const SimpleEventPtr event = lock_and_find(event_id, kernel.simple_events, kernel.mutex);
+    const HandleReadGuard guard;
+    SimpleEvent *const event = kernel.simple_events.get(event_id);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVENT_ID);
     }
@@ -294,8 +319,7 @@ SceInt32 simple_event_delete(KernelState &kernel, const char *export_name, SceUI
     }
 
     if (event->waiting_threads->empty()) {
-        const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
-        kernel.eventflags.erase(event_id);
+        kernel.simple_events.erase(event_id);
     } else {
         // TODO:
         LOG_WARN("Can't delete sync object, it has waiting threads.");
@@ -320,8 +344,6 @@ SceUID mutex_create(SceUID *uid_out, KernelState &kernel, MemState &mem, const c
     }
 
     const MutexPtr mutex = std::make_shared<Mutex>();
-    const SceUID uid = kernel.get_next_uid();
-    mutex->uid = uid;
     mutex->init_count = init_count;
     mutex->lock_count = init_count;
     mutex->workarea = workarea;
@@ -341,14 +363,13 @@ SceUID mutex_create(SceUID *uid_out, KernelState &kernel, MemState &mem, const c
     if (weight == SyncWeight::Light) {
         SceKernelLwMutexWork *workarea_mem = workarea.get(mem);
         workarea_mem->lockCount = init_count;
-        if (workarea_mem->lockCount)
-            workarea_mem->owner = thread_id;
+        workarea_mem->owner = init_count ? thread_id : 0;
         workarea_mem->attr = attr;
     }
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
-    auto &mutexes = get_mutexes(kernel, weight);
-    mutexes.emplace(uid, mutex);
+    const SceUID uid = get_mutexes(kernel, weight).add(mutex);
+    if (!uid)
+        return RET_ERROR(SCE_KERNEL_ERROR_UID_MAX_OPEN);
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} init_count: {}",
@@ -362,13 +383,90 @@ SceUID mutex_create(SceUID *uid_out, KernelState &kernel, MemState &mem, const c
     return SCE_KERNEL_OK;
 }
 
-inline int mutex_lock_impl(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, int lock_count, MutexPtr &mutex, SyncWeight weight, SceUInt *timeout, bool only_try) {
+// The lightweight mutex state lives in the workarea owner word and lockCount.
+// The owner word is only ever set from 0 to the calling thread id outside of
+// mutex->mutex; every other transition, including setting or clearing
+// LW_MUTEX_CONTENDED and handing the mutex over, happens with it held.
+inline int lwmutex_lock_impl(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, int lock_count, Mutex *mutex, SceUInt *timeout, bool only_try) {
+    const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
+
+    std::unique_lock<std::mutex> mutex_lock(mutex->mutex);
+
+    SceKernelLwMutexWork *workarea = mutex->workarea.get(mem);
+    volatile uint32_t *owner_word = &workarea->owner;
+
+    while (true) {
+        const uint32_t owner = *owner_word;
+
+        // Not owned (anymore), take ownership!
+        if (owner == 0) {
+            if (atomic_compare_and_swap(owner_word, static_cast<uint32_t>(thread_id), 0u)) {
+                workarea->lockCount = lock_count;
+                kernel.lwmutex_stats.uncontended.fetch_add(1, std::memory_order_relaxed);
+                return SCE_KERNEL_OK;
+            }
+            continue;
+        }
+
+        // Owned by ourselves
+        if ((owner & ~LW_MUTEX_CONTENDED) == static_cast<uint32_t>(thread_id)) {
+            if (mutex->attr & SCE_KERNEL_MUTEX_ATTR_RECURSIVE) {
+                workarea->lockCount += lock_count;
+                return SCE_KERNEL_OK;
+            }
+            return RET_ERROR(SCE_KERNEL_ERROR_LW_MUTEX_RECURSIVE);
+        }
+
+        // Owned by someone else
+
+        // Don't sleep if only_try is set
+        if (only_try)
+            return RET_ERROR(SCE_KERNEL_ERROR_LW_MUTEX_FAILED_TO_OWN);
+
+        // Force the owner to unlock through the kernel so that it wakes us up
+        if ((owner & LW_MUTEX_CONTENDED) || atomic_compare_and_swap(owner_word, owner | LW_MUTEX_CONTENDED, owner))
+            break;
+    }
+
+    kernel.lwmutex_stats.contended.fetch_add(1, std::memory_order_relaxed);
+    mutex->contended_count++;
+
+    // Sleep thread!
+    std::unique_lock<std::mutex> thread_lock(thread->mutex);
+    thread->update_status(ThreadStatus::wait, ThreadStatus::run);
+
+    WaitingThreadData data;
+    data.thread = thread;
+    data.lock_count = lock_count;
+    data.priority = thread->priority;
+
+    const auto data_it = mutex->waiting_threads->push(data);
+    thread_lock.unlock();
+
+    // On success the unlocking thread has already made us the owner
+    const int res = handle_timeout(kernel, thread, thread_lock, mutex_lock, mutex, mutex->waiting_threads, data, data_it, export_name, timeout);
+
+    if ((res < 0) && mutex->waiting_threads->empty()) {
+        // Nobody is waiting anymore, let the owner unlock without the kernel
+        uint32_t owner;
+        do {
+            owner = *owner_word;
+        } while (!atomic_compare_and_swap(owner_word, owner & ~LW_MUTEX_CONTENDED, owner));
+    }
+
+    return res;
+}
+
+inline int mutex_lock_impl(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, int lock_count, Mutex *mutex, SyncWeight weight, SceUInt *timeout, bool only_try) {
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} lock_count: {} timeout: {} waiting_threads: {}",
             export_name, mutex->uid, thread_id, mutex->name, mutex->attr, mutex->lock_count, timeout ? *timeout : 0,
             mutex->waiting_threads->size());
     }
 
+    if (weight == SyncWeight::Light)
+        return lwmutex_lock_impl(kernel, mem, export_name, thread_id, lock_count, mutex, timeout, only_try);
+
     const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
 
     std::unique_lock<std::mutex> mutex_lock(mutex->mutex);
@@ -381,13 +479,8 @@ inline int mutex_lock_impl(KernelState &kernel, MemState &mem, const char *expor
         if (mutex->owner == thread) {
             if (is_recursive) {
                 mutex->lock_count += lock_count;
-                if (weight == SyncWeight::Light)
-                    mutex->workarea.get(mem)->lockCount += lock_count;
-
                 return SCE_KERNEL_OK;
             }
-            if (weight == SyncWeight::Light)
-                return RET_ERROR(SCE_KERNEL_ERROR_LW_MUTEX_RECURSIVE);
 
             return RET_ERROR(SCE_KERNEL_ERROR_MUTEX_RECURSIVE);
         }
@@ -395,9 +488,6 @@ inline int mutex_lock_impl(KernelState &kernel, MemState &mem, const char *expor
 
         // Don't sleep if only_try is set
         if (only_try) {
-            if (weight == SyncWeight::Light)
-                return RET_ERROR(SCE_KERNEL_ERROR_LW_MUTEX_FAILED_TO_OWN);
-
             return RET_ERROR(SCE_KERNEL_ERROR_MUTEX_FAILED_TO_OWN);
         }
 
@@ -413,16 +503,7 @@ inline int mutex_lock_impl(KernelState &kernel, MemState &mem, const char *expor
         const auto data_it = mutex->waiting_threads->push(data);
         thread_lock.unlock();
 
-        int res = handle_timeout(thread, thread_lock, mutex_lock, mutex->waiting_threads, data, data_it, export_name, timeout);
-
-        if (weight == SyncWeight::Light) {
-            mutex->workarea.get(mem)->lockCount = mutex->lock_count;
-            if (mutex->owner == thread) {
-                mutex->workarea.get(mem)->owner = thread_id;
-            }
-        }
-
-        return res;
+        return handle_timeout(kernel, thread, thread_lock, mutex_lock, mutex, mutex->waiting_threads, data, data_it, export_name, timeout);
     }
     // Not owned
     // Take ownership!
@@ -430,13 +511,6 @@ inline int mutex_lock_impl(KernelState &kernel, MemState &mem, const char *expor
     mutex->lock_count += lock_count;
     mutex->owner = thread;
 
-    if (weight == SyncWeight::Light) {
-        mutex->workarea.get(mem)->lockCount = mutex->lock_count;
-        if (mutex->owner == thread) {
-            mutex->workarea.get(mem)->owner = thread_id;
-        }
-    }
-
     return SCE_KERNEL_OK;
 }
 
@@ -444,23 +518,73 @@ int mutex_lock(KernelState &kernel, MemState &mem, const char *export_name, SceU
     assert(mutexid >= 0);
 
     MutexPtr mutex;
-    if (auto error = find_mutex(mutex, nullptr, kernel, export_name, mutexid, weight))
-        return error;
+    {
+        const HandleReadGuard guard;
+        Mutex *found = nullptr;
+        if (auto error = find_mutex(found, nullptr, kernel, export_name, mutexid, weight))
+            return error;
+        mutex = keep_primitive(found);
+    }
 
-    return mutex_lock_impl(kernel, mem, export_name, thread_id, lock_count, mutex, weight, timeout, false);
+    return mutex_lock_impl(kernel, mem, export_name, thread_id, lock_count, mutex.get(), weight, timeout, false);
 }
 
 int mutex_try_lock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID mutexid, int lock_count, SyncWeight weight) {
     assert(mutexid >= 0);
 
-    MutexPtr mutex;
+    const HandleReadGuard guard;
+    Mutex *mutex = nullptr;
     if (auto error = find_mutex(mutex, nullptr, kernel, export_name, mutexid, weight))
         return error;
 
     return mutex_lock_impl(kernel, mem, export_name, thread_id, lock_count, mutex, weight, nullptr, true);
 }
 
-inline int mutex_unlock_impl(KernelState &kernel, const char *export_name, SceUID thread_id, int unlock_count, MutexPtr &mutex) {
+inline int lwmutex_unlock_impl(MemState &mem, const char *export_name, SceUID thread_id, int unlock_count, Mutex *mutex) {
+    const std::lock_guard<std::mutex> mutex_lock(mutex->mutex);
+
+    SceKernelLwMutexWork *workarea = mutex->workarea.get(mem);
+    volatile uint32_t *owner_word = &workarea->owner;
+    const uint32_t owner = *owner_word;
+
+    if ((owner & ~LW_MUTEX_CONTENDED) != static_cast<uint32_t>(thread_id))
+        return SCE_KERNEL_OK;
+
+    if (unlock_count > static_cast<int>(workarea->lockCount)) {
+        return RET_ERROR(SCE_KERNEL_ERROR_LW_MUTEX_UNLOCK_UDF);
+    }
+
+    workarea->lockCount -= unlock_count;
+    if (workarea->lockCount > 0)
+        return SCE_KERNEL_OK;
+
+    if (mutex->waiting_threads->empty()) {
+        atomic_compare_and_swap(owner_word, 0u, owner);
+        return SCE_KERNEL_OK;
+    }
+
+    const auto waiting_thread_data = *mutex->waiting_threads->begin();
+    const auto waiting_thread = waiting_thread_data.thread;
+
+    const std::lock_guard<std::mutex> waiting_thread_lock(waiting_thread->mutex);
+    waiting_thread->update_status(ThreadStatus::run, ThreadStatus::wait);
+
+    mutex->waiting_threads->pop();
+    workarea->lockCount = waiting_thread_data.lock_count;
+
+    // Keep the contended bit while there are threads left to hand the mutex over to
+    uint32_t new_owner = static_cast<uint32_t>(waiting_thread->id);
+    if (!mutex->waiting_threads->empty())
+        new_owner |= LW_MUTEX_CONTENDED;
+    atomic_compare_and_swap(owner_word, new_owner, owner);
+
+    return SCE_KERNEL_OK;
+}
+
+inline int mutex_unlock_impl(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, int unlock_count, Mutex *mutex, SyncWeight weight) {
+    if (weight == SyncWeight::Light)
+        return lwmutex_unlock_impl(mem, export_name, thread_id, unlock_count, mutex);
+
     const ThreadStatePtr current_thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
 
     const std::lock_guard<std::mutex> mutex_lock(mutex->mutex);
@@ -493,10 +617,11 @@ inline int mutex_unlock_impl(KernelState &kernel, const char *export_name, SceUI
     return SCE_KERNEL_OK;
 }
 
-int mutex_unlock(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID mutexid, int unlock_count, SyncWeight weight) {
+int mutex_unlock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID mutexid, int unlock_count, SyncWeight weight) {
     assert(mutexid >= 0);
 
-    MutexPtr mutex;
+    const HandleReadGuard guard;
+    Mutex *mutex = nullptr;
     if (auto error = find_mutex(mutex, nullptr, kernel, export_name, mutexid, weight))
         return error;
 
@@ -506,13 +631,14 @@ int mutex_unlock(KernelState &kernel, const char *export_name, SceUID thread_id,
             mutex->waiting_threads->size());
     }
 
-    return mutex_unlock_impl(kernel, export_name, thread_id, unlock_count, mutex);
+    return mutex_unlock_impl(kernel, mem, export_name, thread_id, unlock_count, mutex, weight);
 }
 
 int mutex_delete(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID mutexid, SyncWeight weight) {
     assert(mutexid >= 0);
 
-    MutexPtr mutex;
+    const HandleReadGuard guard;
+    Mutex *mutex = nullptr;
     MutexPtrs *mutexes;
     if (auto error = find_mutex(mutex, &mutexes, kernel, export_name, mutexid, weight))
         return error;
@@ -524,7 +650,6 @@ int mutex_delete(KernelState &kernel, const char *export_name, SceUID thread_id,
     }
 
     if (mutex->waiting_threads->empty()) {
-        const std::lock_guard<std::mutex> kernel_guard(kernel.mutex);
         mutexes->erase(mutexid);
     } else {
         // TODO:
@@ -534,10 +659,10 @@ int mutex_delete(KernelState &kernel, const char *export_name, SceUID thread_id,
     return SCE_KERNEL_OK;
 }
 
-MutexPtr mutex_get(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID mutexid, SyncWeight weight) {
+Mutex *mutex_get(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID mutexid, SyncWeight weight) {
     assert(mutexid >= 0);
 
-    MutexPtr mutex;
+    Mutex *mutex = nullptr;
     MutexPtrs *mutexes;
     if (auto error = find_mutex(mutex, &mutexes, kernel, export_name, mutexid, weight))
         return nullptr;
@@ -550,6 +675,73 @@ MutexPtr mutex_get(KernelState &kernel, const char *export_name, SceUID thread_i
     return mutex;
 }
 
+// *********************
+// * Lightweight Mutex *
+// *********************
+
+// Uncontended lock done on the workarea alone, returns false if the kernel has to handle it
+inline bool lwmutex_fast_lock(KernelState &kernel, SceKernelLwMutexWork &workarea, SceUID thread_id, int lock_count) {
+    if (workarea.uid <= 0 || lock_count <= 0)
+        return false;
+
+    volatile uint32_t *owner_word = &workarea.owner;
+    const uint32_t owner = *owner_word;
+    if (owner == 0) {
+        if (!atomic_compare_and_swap(owner_word, static_cast<uint32_t>(thread_id), 0u))
+            return false;
+        workarea.lockCount = lock_count;
+    } else if ((owner & ~LW_MUTEX_CONTENDED) == static_cast<uint32_t>(thread_id) && (workarea.attr & SCE_KERNEL_MUTEX_ATTR_RECURSIVE)) {
+        workarea.lockCount += lock_count;
+    } else {
+        return false;
+    }
+
+    kernel.lwmutex_stats.uncontended.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+int lwmutex_lock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, Ptr<SceKernelLwMutexWork> workarea, int lock_count, unsigned int *timeout) {
+    SceKernelLwMutexWork *workarea_mem = workarea.get(mem);
+    if (lwmutex_fast_lock(kernel, *workarea_mem, thread_id, lock_count))
+        return SCE_KERNEL_OK;
+
+    return mutex_lock(kernel, mem, export_name, thread_id, workarea_mem->uid, lock_count, timeout, SyncWeight::Light);
+}
+
+int lwmutex_try_lock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, Ptr<SceKernelLwMutexWork> workarea, int lock_count) {
+    SceKernelLwMutexWork *workarea_mem = workarea.get(mem);
+    if (lwmutex_fast_lock(kernel, *workarea_mem, thread_id, lock_count))
+        return SCE_KERNEL_OK;
+
+    return mutex_try_lock(kernel, mem, export_name, thread_id, workarea_mem->uid, lock_count, SyncWeight::Light);
+}
+
+int lwmutex_unlock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, Ptr<SceKernelLwMutexWork> workarea, int unlock_count) {
+    SceKernelLwMutexWork *workarea_mem = workarea.get(mem);
+    volatile uint32_t *owner_word = &workarea_mem->owner;
+
+    // Only the owner touches lockCount, and a set contended bit means someone must be woken up
+    if (*owner_word == static_cast<uint32_t>(thread_id) && unlock_count > 0 && unlock_count <= static_cast<int>(workarea_mem->lockCount)) {
+        if (unlock_count < static_cast<int>(workarea_mem->lockCount)) {
+            workarea_mem->lockCount -= unlock_count;
+            return SCE_KERNEL_OK;
+        }
+
+        workarea_mem->lockCount = 0;
+        if (atomic_compare_and_swap(owner_word, 0u, static_cast<uint32_t>(thread_id)))
+            return SCE_KERNEL_OK;
+
+        // A thread started waiting in the meantime, hand the mutex over in the kernel
+        workarea_mem->lockCount = unlock_count;
+    }
+
+    return mutex_unlock(kernel, mem, export_name, thread_id, workarea_mem->uid, unlock_count, SyncWeight::Light);
+}
+
+SceUID lwmutex_owner(const SceKernelLwMutexWork &workarea) {
+    return static_cast<SceUID>(workarea.owner & ~LW_MUTEX_CONTENDED);
+}
+
 // **************
 // * RWLock *
 // **************
@@ -560,8 +752,6 @@ SceUID rwlock_create(KernelState &kernel, MemState &mem, const char *export_name
     }
 
     const RWLockPtr rwlock = std::make_shared<RWLock>();
-    const SceUID uid = kernel.get_next_uid();
-    rwlock->uid = uid;
     std::copy(name, name + KERNELOBJECT_MAX_NAME_LENGTH, rwlock->name);
     rwlock->attr = attr;
 
@@ -571,8 +761,9 @@ SceUID rwlock_create(KernelState &kernel, MemState &mem, const char *export_name
         rwlock->waiting_threads = std::make_unique<FIFOThreadDataQueue<WaitingThreadData>>();
     }
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
-    kernel.rwlocks.emplace(uid, rwlock);
+    const SceUID uid = kernel.rwlocks.add(rwlock);
+    if (!uid)
+        return RET_ERROR(SCE_KERNEL_ERROR_UID_MAX_OPEN);
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {}",
@@ -584,7 +775,11 @@ SceUID rwlock_create(KernelState &kernel, MemState &mem, const char *export_name
 
 SceInt32 rwlock_lock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID lock_id, uint32_t *timeout, bool is_write) {
     const ThreadStatePtr thread = kernel.get_thread(thread_id);
-    const RWLockPtr rwlock = lock_and_find(lock_id, kernel.rwlocks, kernel.mutex);
+    RWLockPtr rwlock;
+    {
+        const HandleReadGuard guard;
+        rwlock = keep_primitive(kernel.rwlocks.get(lock_id));
+    }
 
     if (!rwlock)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_RW_LOCK_ID);
@@ -632,13 +827,14 @@ SceInt32 rwlock_lock(KernelState &kernel, MemState &mem, const char *export_name
         const auto data_it = rwlock->waiting_threads->push(data);
         thread_lock.unlock();
 
-        return handle_timeout(thread, thread_lock, rwlock_lock, rwlock->waiting_threads, data, data_it, export_name, timeout);
+        return handle_timeout(kernel, thread, thread_lock, rwlock_lock, rwlock.get(), rwlock->waiting_threads, data, data_it, export_name, timeout);
     }
 }
 
 SceInt32 rwlock_unlock(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID lock_id, bool is_write) {
     const ThreadStatePtr current_thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
-    const RWLockPtr rwlock = lock_and_find(lock_id, kernel.rwlocks, kernel.mutex);
+    const HandleReadGuard guard;
+    RWLock *const rwlock = kernel.rwlocks.get(lock_id);
 
     if (!rwlock)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_RW_LOCK_ID);
@@ -700,7 +896,8 @@ SceInt32 rwlock_unlock(KernelState &kernel, MemState &mem, const char *export_na
 
 SceInt32 rwlock_delete(KernelState &kernel, MemState &mem, const char *export_name, SceUID thread_id, SceUID lock_id) {
     const ThreadStatePtr thread = kernel.get_thread(thread_id);
-    const RWLockPtr rwlock = lock_and_find(lock_id, kernel.rwlocks, kernel.mutex);
+    const HandleReadGuard guard;
+    RWLock *const rwlock = kernel.rwlocks.get(lock_id);
 
     if (!rwlock)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_RW_LOCK_ID);
@@ -712,7 +909,6 @@ SceInt32 rwlock_delete(KernelState &kernel, MemState &mem, const char *export_na
     }
 
     if (rwlock->waiting_threads->empty()) {
-        const std::lock_guard<std::mutex> kernel_guard(kernel.mutex);
         kernel.rwlocks.erase(lock_id);
     } else {
         // TODO:
@@ -732,8 +928,6 @@ SceUID semaphore_create(KernelState &kernel, const char *export_name, const char
     }
 
     const SemaphorePtr semaphore = std::make_shared<Semaphore>();
-    const SceUID uid = kernel.get_next_uid();
-    semaphore->uid = uid;
     semaphore->init_val = init_val;
     semaphore->val = init_val;
     semaphore->max = max_val;
@@ -746,14 +940,15 @@ SceUID semaphore_create(KernelState &kernel, const char *export_name, const char
         semaphore->waiting_threads = std::make_unique<FIFOThreadDataQueue<WaitingThreadData>>();
     }
 
+    const SceUID uid = kernel.semaphores.add(semaphore);
+    if (!uid)
+        return RET_ERROR(SCE_KERNEL_ERROR_UID_MAX_OPEN);
+
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} init_val: {} max_val: {}",
             export_name, uid, thread_id, name, attr, init_val, max_val);
     }
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
-    kernel.semaphores.emplace(uid, semaphore);
-
     return uid;
 }
 
@@ -761,7 +956,11 @@ SceInt32 semaphore_wait(KernelState &kernel, const char *export_name, SceUID thr
     assert(semaId >= 0);
 
     // TODO Don't lock twice.
-    const SemaphorePtr semaphore = lock_and_find(semaId, kernel.semaphores, kernel.mutex);
+    SemaphorePtr semaphore;
+    {
+        const HandleReadGuard guard;
+        semaphore = keep_primitive(kernel.semaphores.get(semaId));
+    }
     if (!semaphore) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_SEMA_ID);
     }
@@ -791,7 +990,7 @@ SceInt32 semaphore_wait(KernelState &kernel, const char *export_name, SceUID thr
         const auto data_it = semaphore->waiting_threads->push(data);
         thread_lock.unlock();
 
-        auto res = handle_timeout(thread, thread_lock, semaphore_lock, semaphore->waiting_threads, data, data_it, export_name, pTimeout);
+        auto res = handle_timeout(kernel, thread, thread_lock, semaphore_lock, semaphore.get(), semaphore->waiting_threads, data, data_it, export_name, pTimeout);
         if (was_canceled)
             res = SCE_KERNEL_ERROR_WAIT_CANCEL;
         return res;
@@ -806,7 +1005,8 @@ int semaphore_signal(KernelState &kernel, const char *export_name, SceUID thread
     assert(semaid >= 0);
 
     // TODO Don't lock twice.
-    const SemaphorePtr semaphore = lock_and_find(semaid, kernel.semaphores, kernel.mutex);
+    const HandleReadGuard guard;
+    Semaphore *const semaphore = kernel.semaphores.get(semaid);
     if (!semaphore) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_SEMA_ID);
     }
@@ -847,7 +1047,8 @@ int semaphore_delete(KernelState &kernel, const char *export_name, SceUID thread
     assert(semaid >= 0);
 
     // TODO: Don't lock twice
-    const SemaphorePtr semaphore = lock_and_find(semaid, kernel.semaphores, kernel.mutex);
+    const HandleReadGuard guard;
+    Semaphore *const semaphore = kernel.semaphores.get(semaid);
     if (!semaphore) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_SEMA_ID);
     }
@@ -859,7 +1060,6 @@ int semaphore_delete(KernelState &kernel, const char *export_name, SceUID thread
     }
 
     if (semaphore->waiting_threads->empty()) {
-        const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
         kernel.semaphores.erase(semaid);
     } else {
         // TODO:
@@ -873,7 +1073,8 @@ int semaphore_cancel(KernelState &kernel, const char *export_name, SceUID thread
     assert(semaid >= 0);
 
     // TODO: Don't lock twice
-    const SemaphorePtr semaphore = lock_and_find(semaid, kernel.semaphores, kernel.mutex);
+    const HandleReadGuard guard;
+    Semaphore *const semaphore = kernel.semaphores.get(semaid);
     if (!semaphore) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_SEMA_ID);
     }
@@ -924,20 +1125,14 @@ SceUID condvar_create(SceUID *uid_out, KernelState &kernel, const char *export_n
     if ((strlen(name) > 31) && ((attr & 0x80) == 0x80)) {
         return RET_ERROR(SCE_KERNEL_ERROR_UID_NAME_TOO_LONG);
     }
-    MutexPtr assoc_mutex;
+    const HandleReadGuard guard;
+    Mutex *assoc_mutex = nullptr;
     if (auto error = find_mutex(assoc_mutex, nullptr, kernel, export_name, assoc_mutexid, weight))
         return error;
 
-    const SceUID uid = kernel.get_next_uid();
-
-    if (LOG_SYNC_PRIMITIVES) {
-        LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} assoc_mutexid: {}",
-            export_name, uid, thread_id, name, attr, assoc_mutexid);
-    }
-
     const CondvarPtr condvar = std::make_shared<Condvar>();
     condvar->attr = attr;
-    condvar->associated_mutex = std::move(assoc_mutex);
+    condvar->associated_mutex = std::static_pointer_cast<Mutex>(assoc_mutex->shared_from_this());
     std::copy(name, name + KERNELOBJECT_MAX_NAME_LENGTH, condvar->name);
 
     if (condvar->attr & SCE_KERNEL_ATTR_TH_PRIO) {
@@ -946,9 +1141,14 @@ SceUID condvar_create(SceUID *uid_out, KernelState &kernel, const char *export_n
         condvar->waiting_threads = std::make_unique<FIFOThreadDataQueue<WaitingThreadData>>();
     }
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
-    auto &condvars = get_condvars(kernel, weight);
-    condvars.emplace(uid, condvar);
+    const SceUID uid = get_condvars(kernel, weight).add(condvar);
+    if (!uid)
+        return RET_ERROR(SCE_KERNEL_ERROR_UID_MAX_OPEN);
+
+    if (LOG_SYNC_PRIMITIVES) {
+        LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} assoc_mutexid: {}",
+            export_name, uid, thread_id, name, attr, assoc_mutexid);
+    }
 
     if (uid_out)
         *uid_out = uid;
@@ -959,9 +1159,13 @@ int condvar_wait(KernelState &kernel, MemState &mem, const char *export_name, Sc
     assert(condid >= 0);
 
     CondvarPtr condvar;
-    CondvarPtrs *condvars;
-    if (auto error = find_condvar(condvar, &condvars, kernel, export_name, condid, weight))
-        return error;
+    {
+        const HandleReadGuard guard;
+        Condvar *found = nullptr;
+        if (auto error = find_condvar(found, nullptr, kernel, export_name, condid, weight))
+            return error;
+        condvar = keep_primitive(found);
+    }
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} name: \"{}\" attr: {} assoc_mutexid: {} timeout: {} waiting_threads: {}",
@@ -973,7 +1177,7 @@ int condvar_wait(KernelState &kernel, MemState &mem, const char *export_name, Sc
 
     std::unique_lock<std::mutex> condition_variable_lock(condvar->mutex);
 
-    if (auto error = mutex_unlock_impl(kernel, export_name, thread_id, 1, condvar->associated_mutex))
+    if (auto error = mutex_unlock_impl(kernel, mem, export_name, thread_id, 1, condvar->associated_mutex.get(), weight))
         return error;
 
     std::unique_lock<std::mutex> thread_lock(thread->mutex);
@@ -986,17 +1190,18 @@ int condvar_wait(KernelState &kernel, MemState &mem, const char *export_name, Sc
     const auto data_it = condvar->waiting_threads->push(data);
     thread_lock.unlock();
 
-    if (auto error = handle_timeout(thread, thread_lock, condition_variable_lock, condvar->waiting_threads, data, data_it, export_name, timeout))
+    if (auto error = handle_timeout(kernel, thread, thread_lock, condition_variable_lock, condvar.get(), condvar->waiting_threads, data, data_it, export_name, timeout))
         return error;
 
     condition_variable_lock.unlock();
-    return mutex_lock_impl(kernel, mem, export_name, thread_id, 1, condvar->associated_mutex, weight, timeout, false);
+    return mutex_lock_impl(kernel, mem, export_name, thread_id, 1, condvar->associated_mutex.get(), weight, timeout, false);
 }
 
 int condvar_signal(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID condid, Condvar::SignalTarget signal_target, SyncWeight weight) {
     assert(condid >= 0);
 
-    CondvarPtr condvar;
+    const HandleReadGuard guard;
+    Condvar *condvar = nullptr;
     CondvarPtrs *condvars;
     if (auto error = find_condvar(condvar, &condvars, kernel, export_name, condid, weight))
         return error;
@@ -1043,7 +1248,8 @@ int condvar_signal(KernelState &kernel, const char *export_name, SceUID thread_i
 int condvar_delete(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID condid, SyncWeight weight) {
     assert(condid >= 0);
 
-    CondvarPtr condvar;
+    const HandleReadGuard guard;
+    Condvar *condvar = nullptr;
     CondvarPtrs *condvars;
     if (auto error = find_condvar(condvar, &condvars, kernel, export_name, condid, weight))
         return error;
@@ -1055,7 +1261,6 @@ int condvar_delete(KernelState &kernel, const char *export_name, SceUID thread_i
     }
 
     if (condvar->waiting_threads->empty()) {
-        const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
         condvars->erase(condid);
     } else {
         // TODO:
@@ -1070,7 +1275,8 @@ int condvar_delete(KernelState &kernel, const char *export_name, SceUID thread_i
 // **************
 
 SceUID eventflag_clear(KernelState &kernel, const char *export_name, SceUID evfId, SceUInt32 bitPattern) {
-    const EventFlagPtr event = lock_and_find(evfId, kernel.eventflags, kernel.mutex);
+    const HandleReadGuard guard;
+    EventFlag *const event = kernel.eventflags.get(evfId);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVF_ID);
     }
@@ -1092,15 +1298,7 @@ SceUID eventflag_create(KernelState &kernel, const char *export_name, SceUID thr
         return RET_ERROR(SCE_KERNEL_ERROR_UID_NAME_TOO_LONG);
     }
 
-    const SceUID uid = kernel.get_next_uid();
-
-    if (LOG_SYNC_PRIMITIVES) {
-        LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} bitPattern: {:#b}",
-            export_name, uid, thread_id, pName, attr, initPattern);
-    }
-
     const EventFlagPtr event = std::make_shared<EventFlag>();
-    event->uid = uid;
     event->flags = initPattern;
     std::copy(pName, pName + KERNELOBJECT_MAX_NAME_LENGTH, event->name);
     event->attr = attr;
@@ -1110,8 +1308,14 @@ SceUID eventflag_create(KernelState &kernel, const char *export_name, SceUID thr
         event->waiting_threads = std::make_unique<FIFOThreadDataQueue<WaitingThreadData>>();
     }
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
-    kernel.eventflags.emplace(uid, event);
+    const SceUID uid = kernel.eventflags.add(event);
+    if (!uid)
+        return RET_ERROR(SCE_KERNEL_ERROR_UID_MAX_OPEN);
+
+    if (LOG_SYNC_PRIMITIVES) {
+        LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {} bitPattern: {:#b}",
+            export_name, uid, thread_id, pName, attr, initPattern);
+    }
 
     return uid;
 }
@@ -1120,7 +1324,11 @@ static int eventflag_waitorpoll(KernelState &kernel, const char *export_name, Sc
     assert(event_id >= 0);
 
     // TODO Don't lock twice.
-    const EventFlagPtr event = lock_and_find(event_id, kernel.eventflags, kernel.mutex);
+    EventFlagPtr event;
+    {
+        const HandleReadGuard guard;
+        event = keep_primitive(kernel.eventflags.get(event_id));
+    }
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVF_ID);
     }
@@ -1178,7 +1386,7 @@ static int eventflag_waitorpoll(KernelState &kernel, const char *export_name, Sc
         const auto data_it = event->waiting_threads->push(data);
         thread_lock.unlock();
 
-        int err = handle_timeout(thread, thread_lock, event_lock, event->waiting_threads, data, data_it, export_name, timeout);
+        int err = handle_timeout(kernel, thread, thread_lock, event_lock, event.get(), event->waiting_threads, data, data_it, export_name, timeout);
         if (err < 0 && outBits) {
             // set it only if a timeout occurs
             // otherwise set in eventflag_set
@@ -1205,7 +1413,8 @@ SceInt32 eventflag_set(KernelState &kernel, const char *export_name, SceUID thre
     assert(evfId >= 0);
 
     // TODO Don't lock twice.
-    const EventFlagPtr event = lock_and_find(evfId, kernel.eventflags, kernel.mutex);
+    const HandleReadGuard guard;
+    EventFlag *const event = kernel.eventflags.get(evfId);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVF_ID);
     }
@@ -1261,7 +1470,9 @@ SceInt32 eventflag_set(KernelState &kernel, const char *export_name, SceUID thre
 SceInt32 eventflag_cancel(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id, SceUInt32 pattern, SceUInt32 *num_wait_threads) {
     assert(event_id >= 0);
 
-    const EventFlagPtr event = lock_and_find(event_id, kernel.eventflags, kernel.mutex);
+    const HandleReadGuard guard;
+
+    EventFlag *const event = kernel.eventflags.get(event_id);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVF_ID);
     }
@@ -1302,7 +1513,9 @@ SceInt32 eventflag_cancel(KernelState &kernel, const char *export_name, SceUID t
 int eventflag_delete(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID event_id) {
     assert(event_id >= 0);
 
-    const EventFlagPtr event = lock_and_find(event_id, kernel.eventflags, kernel.mutex);
+    const HandleReadGuard guard;
+
+    EventFlag *const event = kernel.eventflags.get(event_id);
     if (!event) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVF_ID);
     }
@@ -1313,7 +1526,6 @@ int eventflag_delete(KernelState &kernel, const char *export_name, SceUID thread
     }
 
     if (event->waiting_threads->empty()) {
-        const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
         kernel.eventflags.erase(event_id);
     } else {
         // TODO:
@@ -1332,17 +1544,9 @@ SceUID msgpipe_create(KernelState &kernel, const char *export_name, const char *
         return RET_ERROR(SCE_KERNEL_ERROR_UID_NAME_TOO_LONG);
     }
 
-    const SceUID uid = kernel.get_next_uid();
-
-    if (LOG_SYNC_PRIMITIVES) {
-        LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {}",
-            export_name, uid, thread_id, name, attr);
-    }
-
     const MsgPipePtr msgpipe = std::make_shared<MsgPipe>(bufSize);
 
     msgpipe->attr = attr;
-    msgpipe->uid = uid;
     std::copy(name, name + KERNELOBJECT_MAX_NAME_LENGTH, msgpipe->name);
 
     if (msgpipe->attr & SCE_KERNEL_ATTR_TH_PRIO) {
@@ -1354,133 +1558,203 @@ SceUID msgpipe_create(KernelState &kernel, const char *export_name, const char *
     // TODO do senders respect priority?
     msgpipe->senders = std::make_unique<FIFOThreadDataQueue<WaitingThreadData>>();
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
-    kernel.msgpipes.emplace(uid, msgpipe);
+    const SceUID uid = kernel.msgpipes.add(msgpipe);
+    if (!uid)
+        return RET_ERROR(SCE_KERNEL_ERROR_UID_MAX_OPEN);
+
+    if (LOG_SYNC_PRIMITIVES) {
+        LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" attr: {}",
+            export_name, uid, thread_id, name, attr);
+    }
 
     return uid;
 }
 
 SceUID msgpipe_find(KernelState &kernel, const char *export_name, const char *name) {
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
-
     // TODO use another map
-    const auto it = std::find_if(kernel.msgpipes.begin(), kernel.msgpipes.end(), [=](auto it) {
+    const auto msgpipes = kernel.msgpipes.get_all();
+    const auto it = std::find_if(msgpipes.begin(), msgpipes.end(), [=](const auto &it) {
         return strcmp(it.second->name, name) == 0;
     });
 
-    if (it != kernel.msgpipes.end()) {
+    if (it != msgpipes.end()) {
         return it->first;
     }
 
     return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_MSG_PIPE_ID);
 }
 
+// The data goes through a lock-free ring: the senders take turns on send_mutex to be its single producer and
+// the receivers claim what they read with an atomic index. msgpipe->mutex only guards the queues of waiting
+// threads, and a side only takes it when the count of the other queue shows a thread is waiting.
+
+// Wakes the first waiting thread the pipe can serve with what is available, must be called with the msgpipe locked
+static void msgpipe_wakeup(WaitingThreadQueuePtr &queue, std::atomic<uint32_t> &waiting_count, std::size_t available) {
+    for (auto it = queue->begin(); it != queue->end(); ++it) {
+        const WaitingThreadData data = *it;
+        if (data.mp.request_size <= available) {
+            queue->erase(it);
+            waiting_count--;
+            data.thread->update_status(ThreadStatus::run, ThreadStatus::wait);
+            return;
+        }
+    }
+}
+
+static void msgpipe_wakeup_receivers(MsgPipe &msgpipe) {
+    // pairs with the fence of a receiver between counting itself as waiting and looking at the ring again
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (msgpipe.waiting_receivers == 0)
+        return;
+
+    const std::lock_guard<std::mutex> msgpipe_lock(msgpipe.mutex);
+    msgpipe_wakeup(msgpipe.receivers, msgpipe.waiting_receivers, msgpipe.data_buffer.Used());
+}
+
+static void msgpipe_wakeup_senders(MsgPipe &msgpipe) {
+    // pairs with the fence of a sender between counting itself as waiting and looking at the ring again
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (msgpipe.waiting_senders == 0)
+        return;
+
+    const std::lock_guard<std::mutex> msgpipe_lock(msgpipe.mutex);
+    msgpipe_wakeup(msgpipe.senders, msgpipe.waiting_senders, msgpipe.data_buffer.Free());
+}
+
+// Copies straight from the sender's buffer into the buffers of the waiting receivers, as long as the ring is
+// empty so no data goes ahead of what is in it. Must be called with send_mutex locked.
+static SceSize msgpipe_handoff(MsgPipe &msgpipe, const char *data, SceSize size) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (msgpipe.waiting_receivers == 0)
+        return 0;
+
+    const std::lock_guard<std::mutex> msgpipe_lock(msgpipe.mutex);
+    SceSize sent = 0;
+    while (sent < size && msgpipe.data_buffer.Empty()) {
+        auto it = msgpipe.receivers->begin();
+        // receivers that don't remove the data peek at the ring instead
+        while (it != msgpipe.receivers->end() && (!(*it).mp.buffer || (*it).mp.request_size > size - sent))
+            ++it;
+        if (it == msgpipe.receivers->end())
+            break;
+
+        const WaitingThreadData receiver = *it;
+        const SceSize copied = std::min(size - sent, receiver.mp.buffer_size);
+        memcpy(receiver.mp.buffer, data + sent, copied);
+        *receiver.mp.received = copied;
+        sent += copied;
+
+        msgpipe.receivers->erase(it);
+        msgpipe.waiting_receivers--;
+        receiver.thread->update_status(ThreadStatus::run, ThreadStatus::wait);
+    }
+    return sent;
+}
+
 SceSize msgpipe_recv(KernelState &kernel, const char *export_name, SceUID thread_id, SceUID msgPipeId, SceUInt32 waitMode, void *pRecvBuf, SceSize recvSize, SceUInt32 *pTimeout) {
     assert(msgPipeId >= 0);
 
     const bool ASAP = !(waitMode & SCE_KERNEL_MSG_PIPE_MODE_FULL);
+    const bool remove = !(waitMode & SCE_KERNEL_MSG_PIPE_MODE_DONT_REMOVE);
 
-    const MsgPipePtr msgpipe = lock_and_find(msgPipeId, kernel.msgpipes, kernel.mutex);
+    MsgPipePtr msgpipe;
+    {
+        const HandleReadGuard guard;
+        msgpipe = keep_primitive(kernel.msgpipes.get(msgPipeId));
+    }
     if (!msgpipe) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_MSG_PIPE_ID);
     }
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" pipe attr: {} wait_mode: {:#b} ({})"
-                  " senders: {} receivers: {}",
+                  " waiting senders: {} waiting receivers: {}",
             export_name, msgpipe->uid, thread_id, msgpipe->name, msgpipe->attr, waitMode, ASAP ? "ASAP" : "FULL",
-            msgpipe->senders->size(), msgpipe->receivers->size());
+            msgpipe->waiting_senders.load(), msgpipe->waiting_receivers.load());
     }
 
     if (recvSize > msgpipe->data_buffer.Capacity())
         return RET_ERROR(SCE_KERNEL_ERROR_ILLEGAL_SIZE);
+    if (recvSize == 0)
+        return 0;
 
-    const auto copyOut = [&] {
-        if (waitMode & SCE_KERNEL_MSG_PIPE_MODE_DONT_REMOVE) {
-            return msgpipe->data_buffer.Peek(pRecvBuf, recvSize);
+    const SceSize request_size = ASAP ? 1 : recvSize; // If ASAP, we can read as low as 1 byte
+    const auto copyOut = [&]() -> SceSize {
+        if (remove) {
+            return msgpipe->data_buffer.Remove(pRecvBuf, recvSize, request_size);
         } else {
-            return msgpipe->data_buffer.Remove(pRecvBuf, recvSize);
+            return msgpipe->data_buffer.Peek(pRecvBuf, recvSize, request_size);
         }
     };
+    const auto finish = [&](SceSize readSize) {
+        if (remove)
+            msgpipe_wakeup_senders(*msgpipe);
+        // another receiver may be able to use what is left
+        if (!msgpipe->data_buffer.Empty())
+            msgpipe_wakeup_receivers(*msgpipe);
+        return readSize;
+    };
 
+    // Copy out and return without locking anything if there is enough data.
+    if (const SceSize readSize = copyOut())
+        return finish(readSize);
+    if (waitMode & SCE_KERNEL_MSG_PIPE_MODE_DONT_WAIT)
+        return 0;
+
+    // Sleep until we can read
     const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
-    std::unique_lock msgpipe_lock(msgpipe->mutex);
+    SceSize received = 0;
+    WaitingThreadData wait_data;
+    wait_data.thread = thread;
+    wait_data.priority = thread->priority;
+    wait_data.mp.request_size = request_size;
+    wait_data.mp.buffer = remove ? pRecvBuf : nullptr;
+    wait_data.mp.buffer_size = recvSize;
+    wait_data.mp.received = &received;
+
+    std::unique_lock<std::mutex> msgpipe_lock(msgpipe->mutex);
     // check in case of delete happens while waiting (un)lock
     if (msgpipe->beingDeleted) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_MSG_PIPE_ID);
     }
 
-    const auto wakeup_senders = [&] {
-        if (!msgpipe->senders->empty()) {
-            for (auto it = msgpipe->senders->begin(); it != msgpipe->senders->end(); it++) {
-                auto threadInfo = (*it);
-                if (threadInfo.mp.request_size <= msgpipe->data_buffer.Free()) { // Found a thread we can service
-                    threadInfo.thread->status = ThreadStatus::run;
-                    threadInfo.thread->status_cond.notify_one();
+    while (true) {
+        std::unique_lock<std::mutex> thread_lock(thread->mutex);
+        thread->update_status(ThreadStatus::wait, ThreadStatus::run);
+        thread_lock.unlock();
 
-                    msgpipe->senders->erase(it); // Erase other thread's info - done here to avoid race
-                    break; // Should we try to signal other threads, too?
-                }
-            }
-        }
-    };
+        const auto data_it = msgpipe->receivers->push(wait_data);
+        msgpipe->waiting_receivers++;
 
-    std::size_t availableSize = msgpipe->data_buffer.Used();
-    if ((availableSize >= recvSize) || (ASAP && availableSize >= 1)) { // Copy out and return.
-        SceSize copied_size = (SceSize)copyOut();
-        wakeup_senders();
-        return copied_size;
-    } else if (waitMode & SCE_KERNEL_MSG_PIPE_MODE_DONT_WAIT) {
-        return 0;
-    } else { // sleep until we can insert
-        WaitingThreadData wait_data;
-        wait_data.thread = thread;
-        wait_data.priority = thread->priority;
-        wait_data.mp.request_size = (ASAP) ? 1 : recvSize; // If ASAP, we can read as low as 1 byte
-
-        msgpipe->receivers->push(wait_data);
-
-        std::unique_lock thread_lock(thread->mutex); // Lock thread - needed for condition variable
-        thread->update_status(ThreadStatus::wait, ThreadStatus::run); // Mark ourselves as sleeping
-
-        const auto finish = [&] {
-            thread->update_status(ThreadStatus::run); // Wake up
-
-            SceSize readSize = (SceSize)copyOut();
-            // msgpipe->receivers->erase(wait_data); //we've already been erased by the sender
-            wakeup_senders();
-            return readSize;
-        };
-
-        if (!pTimeout) { // No timeout - loop forever until we can fill the buffer
-            do {
-                // FIXME sleep on SimpleEvent
-                msgpipe_lock.unlock(); // Unlock message pipe object, else we'll deadlock
-                thread->status_cond.wait(thread_lock, [&] { return thread->status == ThreadStatus::run; });
-                if (msgpipe->beingDeleted) { // if beingDeleted then message pipe is locked, so we can't lock again
-                    std::atomic_fetch_add(&msgpipe->remainingThreads, -1);
-                    return SCE_KERNEL_ERROR_WAIT_DELETE;
-                }
-                msgpipe_lock.lock(); // Lock message pipe again
-                availableSize = msgpipe->data_buffer.Used();
-            } while (!((availableSize >= recvSize) || (ASAP && (availableSize > 0))));
-
-            return finish();
-        } else { // There's a timeout - wait until we can fill buffer or timeout
-            msgpipe_lock.unlock(); // Unlock message pipe object, else we'll deadlock
-            auto status = thread->status_cond.wait_for(thread_lock, std::chrono::microseconds{ *pTimeout }, [&] { return thread->status == ThreadStatus::run; });
-            if (msgpipe->beingDeleted) {
-                std::atomic_fetch_add(&msgpipe->remainingThreads, -1);
-                return SCE_KERNEL_ERROR_WAIT_DELETE;
-            }
+        // a sender that didn't see us waiting has left its data in the ring
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (const SceSize readSize = copyOut()) {
+            msgpipe->receivers->erase(data_it);
+            msgpipe->waiting_receivers--;
+            thread_lock.lock();
+            thread->update_status(ThreadStatus::run, ThreadStatus::wait);
+            thread_lock.unlock();
+            msgpipe_lock.unlock();
+            return finish(readSize);
+        }
 
-            if (!status) { // Timed out and buffer hasn't been touched
-                thread->update_status(ThreadStatus::run, ThreadStatus::wait);
-                return RET_ERROR(SCE_KERNEL_ERROR_WAIT_TIMEOUT);
-            }
-            msgpipe_lock.lock(); // Lock message pipe again
-            return finish();
+        if (const int error = handle_timeout(kernel, thread, thread_lock, msgpipe_lock, msgpipe.get(), msgpipe->receivers, wait_data, data_it, export_name, pTimeout)) {
+            msgpipe->waiting_receivers--;
+            return error;
         }
+        if (msgpipe->beingDeleted)
+            return SCE_KERNEL_ERROR_WAIT_DELETE;
+        // a sender copied its data straight into our buffer
+        if (received)
+            return received;
+
+        // otherwise there was enough in the ring when we were woken up, unless another receiver was faster
+        msgpipe_lock.unlock();
+        if (const SceSize readSize = copyOut())
+            return finish(readSize);
+        msgpipe_lock.lock();
+        if (msgpipe->beingDeleted)
+            return SCE_KERNEL_ERROR_WAIT_DELETE;
     }
 }
 
@@ -1490,108 +1764,115 @@ SceSize msgpipe_send(KernelState &kernel, const char *export_name, SceUID thread
 
     const bool ASAP = !(waitMode & SCE_KERNEL_MSG_PIPE_MODE_FULL);
 
-    const MsgPipePtr msgpipe = lock_and_find(msgPipeId, kernel.msgpipes, kernel.mutex);
+    MsgPipePtr msgpipe;
+    {
+        const HandleReadGuard guard;
+        msgpipe = keep_primitive(kernel.msgpipes.get(msgPipeId));
+    }
     if (!msgpipe) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_MSG_PIPE_ID);
     }
 
     if (LOG_SYNC_PRIMITIVES) {
         LOG_DEBUG("{}: uid: {} thread_id: {} name: \"{}\" pipe attr: {} wait_mode: {:#b}"
-                  " senders: {} receivers: {}",
+                  " waiting senders: {} waiting receivers: {}",
             export_name, msgpipe->uid, thread_id, msgpipe->name, msgpipe->attr, waitMode,
-            msgpipe->senders->size(), msgpipe->receivers->size());
+            msgpipe->waiting_senders.load(), msgpipe->waiting_receivers.load());
     }
 
     if (sendSize > msgpipe->data_buffer.Capacity())
         return RET_ERROR(SCE_KERNEL_ERROR_ILLEGAL_SIZE);
+    if (sendSize == 0)
+        return 0;
 
-    const auto wakeup_receivers = [&] { // TODO is this correct?
-        if (!msgpipe->receivers->empty()) {
-            for (auto it = msgpipe->receivers->begin(); it != msgpipe->receivers->end(); it++) {
-                if ((*it).mp.request_size <= msgpipe->data_buffer.Used()) { // Found a thread we can service
-                    (*it).thread->update_status(ThreadStatus::run, ThreadStatus::wait);
+    const char *data = static_cast<const char *>(pSendBuf);
+    const SceSize request_size = ASAP ? 1 : sendSize; // If ASAP, we can insert as low as 1 byte
+    // Must be called with send_mutex locked
+    const auto copyIn = [&]() -> SceSize {
+        const SceSize sent = msgpipe_handoff(*msgpipe, data, sendSize);
+        if (sent == 0)
+            return msgpipe->data_buffer.Insert(data, sendSize, request_size);
 
-                    msgpipe->receivers->erase(it); // Erase other thread's info - done here to avoid race
-                    break; // Should we try to signal other threads, too?
-                }
-            }
-        }
+        // the ring was empty when the receivers got their part, so the rest always fits
+        return sent + msgpipe->data_buffer.Insert(data + sent, sendSize - sent, 0);
     };
+    const auto finish = [&](SceSize insertedSize) {
+        msgpipe_wakeup_receivers(*msgpipe);
+        return insertedSize;
+    };
+
+    // If there's enough space, copy and return without waiting.
+    std::unique_lock<std::mutex> send_lock(msgpipe->send_mutex);
+    if (const SceSize insertedSize = copyIn()) {
+        send_lock.unlock();
+        return finish(insertedSize);
+    }
+    if (waitMode & SCE_KERNEL_MSG_PIPE_MODE_DONT_WAIT)
+        return 0;
 
+    // Go to sleep until there's more space
     const ThreadStatePtr thread = lock_and_find(thread_id, kernel.threads, kernel.mutex);
+    WaitingThreadData wait_data;
+    wait_data.thread = thread;
+    wait_data.priority = thread->priority;
+    wait_data.mp.request_size = request_size;
+    wait_data.mp.buffer = nullptr;
+
     std::unique_lock<std::mutex> msgpipe_lock(msgpipe->mutex);
     // check in case of delete happens while waiting (un)lock
     if (msgpipe->beingDeleted) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_MSG_PIPE_ID);
     }
 
-    // If ASAP and there's at least 1 free byte, or FULL and there's enough space, copy and return directly.
-    std::size_t freeSize = msgpipe->data_buffer.Free();
-    if ((freeSize >= sendSize) || (ASAP && (freeSize >= 1))) {
-        SceSize copied_size = (SceSize)msgpipe->data_buffer.Insert(pSendBuf, sendSize);
+    while (true) {
+        std::unique_lock<std::mutex> thread_lock(thread->mutex);
+        thread->update_status(ThreadStatus::wait, ThreadStatus::run);
+        thread_lock.unlock();
 
-        wakeup_receivers();
+        const auto data_it = msgpipe->senders->push(wait_data);
+        msgpipe->waiting_senders++;
 
-        return copied_size;
-    } else if (waitMode & SCE_KERNEL_MSG_PIPE_MODE_DONT_WAIT) {
-        return 0;
-    } else { // Go to sleep until there's more space
-        WaitingThreadData wait_data;
-        wait_data.thread = thread;
-        wait_data.priority = thread->priority;
-        wait_data.mp.request_size = (ASAP) ? 1 : sendSize; // If ASAP, we can insert as low as 1 byte
-
-        msgpipe->senders->push(wait_data);
-
-        std::unique_lock thread_lock(thread->mutex); // Lock thread - needed for condition variable
-        thread->update_status(ThreadStatus::wait, ThreadStatus::run); // Mark ourselves as sleeping
-
-        const auto finish = [&] {
-            thread->update_status(ThreadStatus::run); // Wake up
-
-            SceSize insertedSize = (SceSize)msgpipe->data_buffer.Insert(pSendBuf, sendSize);
-            // msgpipe->senders->erase(wait_data); //Don't erase ourselves - recv will do it
-            wakeup_receivers();
-            return (int)insertedSize;
-        };
-
-        if (!pTimeout) { // No timeout - loop forever until we can fill the buffer
-            do {
-                // FIXME sleep on SimpleEvent
-                msgpipe_lock.unlock(); // Unlock message pipe object, else we'll deadlock
-                thread->status_cond.wait(thread_lock, [&] { return thread->status == ThreadStatus::run; });
-                if (msgpipe->beingDeleted) { // if beingDeleted then message pipe is locked, so we can't lock again
-                    std::atomic_fetch_add(&msgpipe->remainingThreads, -1);
-                    return SCE_KERNEL_ERROR_WAIT_DELETE;
-                }
-                msgpipe_lock.lock(); // Lock message pipe before read from data_buffer
-                freeSize = msgpipe->data_buffer.Free();
-            } while (!((freeSize >= sendSize) || (ASAP && (freeSize >= 1))));
-
-            // Message pipe is still locked here, so we can read from data_buffer in finish()
-            return finish();
-        } else { // There's a timeout - wait until we can fill buffer or timeout
-            msgpipe_lock.unlock(); // Unlock message pipe object, else we'll deadlock
-            auto status = thread->status_cond.wait_for(thread_lock, std::chrono::microseconds{ *pTimeout }, [&] { return thread->status == ThreadStatus::run; });
-            if (msgpipe->beingDeleted) {
-                std::atomic_fetch_add(&msgpipe->remainingThreads, -1);
-                return SCE_KERNEL_ERROR_WAIT_DELETE;
-            }
+        // a receiver that didn't see us waiting has left the space it freed. No receiver can be
+        // waiting for a handoff while the ring has too little space, inserting is enough.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (const SceSize insertedSize = msgpipe->data_buffer.Insert(data, sendSize, request_size)) {
+            msgpipe->senders->erase(data_it);
+            msgpipe->waiting_senders--;
+            thread_lock.lock();
+            thread->update_status(ThreadStatus::run, ThreadStatus::wait);
+            thread_lock.unlock();
+            msgpipe_lock.unlock();
+            send_lock.unlock();
+            return finish(insertedSize);
+        }
 
-            if (!status) { // Timed out and buffer hasn't been touched
-                thread->update_status(ThreadStatus::run, ThreadStatus::wait);
-                return RET_ERROR(SCE_KERNEL_ERROR_WAIT_TIMEOUT);
-            }
-            msgpipe_lock.lock(); // Lock message pipe before read from data_buffer in finish()
-            return finish();
+        send_lock.unlock();
+        if (const int error = handle_timeout(kernel, thread, thread_lock, msgpipe_lock, msgpipe.get(), msgpipe->senders, wait_data, data_it, export_name, pTimeout)) {
+            msgpipe->waiting_senders--;
+            return error;
+        }
+        if (msgpipe->beingDeleted)
+            return SCE_KERNEL_ERROR_WAIT_DELETE;
+
+        // send_mutex goes first
+        msgpipe_lock.unlock();
+        send_lock.lock();
+        if (const SceSize insertedSize = copyIn()) {
+            send_lock.unlock();
+            return finish(insertedSize);
         }
+        msgpipe_lock.lock();
+        if (msgpipe->beingDeleted)
+            return SCE_KERNEL_ERROR_WAIT_DELETE;
     }
 }
 
 SceUID msgpipe_delete(KernelState &kernel, const char *export_name, const char *name, SceUID thread_id, SceUID msgpipe_id) {
     assert(msgpipe_id >= 0);
 
-    const MsgPipePtr msgpipe = lock_and_find(msgpipe_id, kernel.msgpipes, kernel.mutex);
+    const HandleReadGuard guard;
+
+    MsgPipe *const msgpipe = kernel.msgpipes.get(msgpipe_id);
     if (!msgpipe) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_MSG_PIPE_ID);
     }
@@ -1601,24 +1882,25 @@ SceUID msgpipe_delete(KernelState &kernel, const char *export_name, const char *
             export_name, msgpipe->uid, thread_id, msgpipe->name, msgpipe->attr);
     }
 
-    if (!msgpipe->receivers->empty() || !msgpipe->senders->empty()) {
-        const std::lock_guard<std::mutex> event_lock(msgpipe->mutex);
-        msgpipe->remainingThreads = (msgpipe->senders->size() + msgpipe->receivers->size());
+    {
+        const std::lock_guard<std::mutex> msgpipe_lock(msgpipe->mutex);
         msgpipe->beingDeleted = true;
-        std::atomic_thread_fence(std::memory_order_release);
 
-        // Wake up every thread
+        // Wake up every thread, they keep the pipe alive until they see it was deleted
         for (auto it : *msgpipe->senders) {
             it.thread->update_status(ThreadStatus::run, ThreadStatus::wait);
         }
         for (auto it : *msgpipe->receivers) {
             it.thread->update_status(ThreadStatus::run, ThreadStatus::wait);
         }
-        while (std::atomic_load(&msgpipe->remainingThreads) != 0) // FIXME busy loop bad
-            std::this_thread::yield();
+        while (!msgpipe->senders->empty())
+            msgpipe->senders->pop();
+        while (!msgpipe->receivers->empty())
+            msgpipe->receivers->pop();
+        msgpipe->waiting_senders = 0;
+        msgpipe->waiting_receivers = 0;
     }
 
-    const std::lock_guard<std::mutex> kernel_lock(kernel.mutex);
     kernel.msgpipes.erase(msgpipe->uid);
 
     return SCE_KERNEL_OK;
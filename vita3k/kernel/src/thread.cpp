@@ -80,15 +80,12 @@ int ThreadState::init(KernelState &kernel, const char *name, Ptr<const void> ent
     if (kernel.debugger.watch_code) {
         set_log_code(*cpu, true);
     }
-    if (kernel.debugger.watch_memory) {
-        set_log_mem(*cpu, true);
-    }
 
-    std::string alloc_name = fmt::format("Stack for thread {} (#{})", name, id);
+    std::string alloc_name = fmt::format("Thread stack: {} (#{})", name, id);
     stack = alloc_block(mem, stack_size, alloc_name.c_str());
     memset(stack.get_ptr<void>().get(mem), 0xcc, stack_size);
 
-    alloc_name = fmt::format("TLS for thread {} (#{})", name, id);
+    alloc_name = fmt::format("Thread TLS: {} (#{})", name, id);
     const size_t tls_size = KERNEL_TLS_SIZE + kernel.tls_msize;
     tls = alloc_block(mem, tls_size, alloc_name.c_str());
     const Ptr<uint8_t> base_tls_ptr = tls.get_ptr<uint8_t>();
@@ -190,6 +187,18 @@ bool ThreadState::run_loop() {
                 break;
             }
 
+            if (restored_context) {
+                if (run_level > 1) {
+                    // the context is the one of the outermost level, leave the callback first
+                    call_level = 1;
+                    return true;
+                }
+                load_context(*cpu, *restored_context);
+                restored_context.reset();
+            }
+            // the HLE call a savestate load aborted has returned
+            wait_aborted = false;
+
             update_status(ThreadStatus::run);
 
             // Run the cpu
@@ -203,9 +212,12 @@ bool ThreadState::run_loop() {
 
             // handle svc call if this was what stopped the cpu
             if (cpu->svc_called) {
-                cpu->protocol->call_svc(*cpu, cpu->svc_called, read_pc(*cpu), *this);
+                cpu->protocol->call_svc(*cpu, cpu->svc, read_pc(*cpu), *this);
             }
 
+            // the accesses which hit a watch, from the guest or the import, are done
+            cpu->protocol->update_watches();
+
             lock.lock();
 
             // Handle errors
@@ -269,6 +281,7 @@ uint32_t ThreadState::run_callback(Address callback_address, const std::vector<u
 
     std::unique_lock<std::mutex> thread_lock(mutex);
     call_level++;
+    callback_return_contexts.push_back(previous_ctx);
     // we shouldn't have to clean the context I believe
     write_pc(*cpu, callback_address);
     write_lr(*cpu, cpu->halt_instruction_pc);
@@ -280,6 +293,7 @@ uint32_t ThreadState::run_callback(Address callback_address, const std::vector<u
     run_loop();
 
     thread_lock.lock();
+    callback_return_contexts.pop_back();
 
     // restore the previous context
     // actually, in most case I don't think this is necessary as the caller
@@ -345,7 +359,9 @@ Address ThreadState::stack_top() const {
 }
 
 void ThreadState::suspend() {
-    assert(to_do == ThreadToDo::run);
+    // a thread waiting in a HLE call may already be stopping
+    if (to_do != ThreadToDo::run)
+        return;
     to_do = ThreadToDo::suspend;
     stop(*cpu);
 }
@@ -360,6 +376,40 @@ void ThreadState::resume(bool step) {
     something_to_do.notify_one();
 }
 
+// The import stubs call the HLE functions with an ARM svc, see load_func_imports
+constexpr uint32_t IMPORT_SVC_SIZE = 4;
+
+CPUContext ThreadState::get_resumable_context(bool in_hle_call) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    CPUContext context;
+    if (!callback_return_contexts.empty()) {
+        // the callbacks run inside a HLE call, it is made again with them
+        context = callback_return_contexts.front();
+        in_hle_call = true;
+    } else {
+        context = save_context(*cpu);
+    }
+
+    if (in_hle_call)
+        context.set_pc(context.get_pc() - IMPORT_SVC_SIZE);
+    return context;
+}
+
+bool ThreadState::set_restored_context(const CPUContext &context) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    if (call_level == 0)
+        return false;
+
+    restored_context = context;
+    return true;
+}
+
+void ThreadState::abort_wait() {
+    const std::lock_guard<std::mutex> lock(mutex);
+    wait_aborted = true;
+    status_cond.notify_all();
+}
+
 std::string ThreadState::log_stack_traceback(KernelState &kernel) const {
     constexpr Address START_OFFSET = 0;
     constexpr Address END_OFFSET = 1024;
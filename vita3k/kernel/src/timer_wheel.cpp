@@ -0,0 +1,237 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/timer_wheel.h>
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+TimerWheel::TimerWheel(GuestClock &clock)
+    : clock(clock)
+    , epoch(clock.now()) {
+    // the time it takes the clock to reach the next slot has changed
+    clock_listener = clock.add_listener([this] {
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+            wake_at = 0;
+        }
+        cond.notify_all();
+    });
+    thread = std::thread([this] { run(); });
+}
+
+TimerWheel::~TimerWheel() {
+    clock.remove_listener(clock_listener);
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake_at = 0;
+    cond.notify_all();
+    thread.join();
+}
+
+uint64_t TimerWheel::now() const {
+    // the guest clock follows the system one at speed 1, which may be set back
+    return std::max(clock.now(), epoch) - epoch;
+}
+
+WheelTimerPtr TimerWheel::start(std::chrono::microseconds timeout, std::shared_ptr<std::mutex> timer_mutex, std::shared_ptr<std::condition_variable> timer_cond) {
+    const WheelTimerPtr timer = std::make_shared<WheelTimer>();
+    timer->deadline = now() + timeout.count();
+    if (timeout.count() <= 0) {
+        // the caller holds the mutex of the timer
+        timer->expired = true;
+        return timer;
+    }
+
+    timer->mutex = std::move(timer_mutex);
+    timer->cond = std::move(timer_cond);
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    std::vector<WheelTimerPtr> due;
+    insert(timer, due);
+    assert(due.empty());
+
+    if (timer->deadline < wake_at) {
+        wake_at = timer->deadline;
+        cond.notify_one();
+    }
+    return timer;
+}
+
+void TimerWheel::cancel(const WheelTimerPtr &timer) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    if (timer->level == WheelTimer::NOT_QUEUED)
+        return;
+
+    unlink(*timer);
+    stats.cancelled++;
+}
+
+void TimerWheel::insert(const WheelTimerPtr &timer, std::vector<WheelTimerPtr> &due) {
+    if (timer->deadline <= current) {
+        timer->level = WheelTimer::NOT_QUEUED;
+        due.push_back(timer);
+        return;
+    }
+
+    // the level is given by the highest group of bits in which the deadline differs from now
+    const uint32_t level = (63 - std::countl_zero(timer->deadline ^ current)) / LEVEL_BITS;
+    std::vector<WheelTimerPtr> *list;
+    if (level >= LEVEL_COUNT) {
+        timer->level = LEVEL_COUNT;
+        list = &overflow;
+    } else {
+        timer->level = level;
+        timer->slot = (timer->deadline >> (level * LEVEL_BITS)) & (SLOT_COUNT - 1);
+        occupied[level] |= uint64_t(1) << timer->slot;
+        list = &slots[level][timer->slot];
+    }
+    timer->position = list->size();
+    list->push_back(timer);
+    queued++;
+}
+
+void TimerWheel::unlink(WheelTimer &timer) {
+    std::vector<WheelTimerPtr> &list = timer.level == LEVEL_COUNT ? overflow : slots[timer.level][timer.slot];
+    if (timer.position != list.size() - 1) {
+        list[timer.position] = std::move(list.back());
+        list[timer.position]->position = timer.position;
+    }
+    list.pop_back();
+    if (list.empty() && timer.level < LEVEL_COUNT)
+        occupied[timer.level] &= ~(uint64_t(1) << timer.slot);
+
+    timer.level = WheelTimer::NOT_QUEUED;
+    queued--;
+}
+
+// Time of the next slot to expire or to move down a level
+uint64_t TimerWheel::next_event() const {
+    uint64_t next = UINT64_MAX;
+    for (uint32_t level = 0; level < LEVEL_COUNT; level++) {
+        const uint32_t shift = level * LEVEL_BITS;
+        const uint32_t current_slot = (current >> shift) & (SLOT_COUNT - 1);
+        // the slots of a level are always after the current one
+        const uint64_t later = current_slot == SLOT_COUNT - 1 ? 0 : occupied[level] & (~uint64_t(0) << (current_slot + 1));
+        if (!later)
+            continue;
+
+        const uint64_t block_start = (current >> (shift + LEVEL_BITS)) << (shift + LEVEL_BITS);
+        next = std::min(next, block_start | (uint64_t(std::countr_zero(later)) << shift));
+    }
+    if (!overflow.empty()) {
+        constexpr uint32_t overflow_shift = LEVEL_COUNT * LEVEL_BITS;
+        next = std::min(next, ((current >> overflow_shift) + 1) << overflow_shift);
+    }
+    return next;
+}
+
+void TimerWheel::advance(uint64_t time, std::vector<WheelTimerPtr> &due) {
+    for (uint64_t next = next_event(); next <= time; next = next_event()) {
+        current = next;
+
+        std::vector<WheelTimerPtr> moved;
+        if ((current & ((uint64_t(1) << (LEVEL_COUNT * LEVEL_BITS)) - 1)) == 0)
+            moved.swap(overflow);
+        // from the top, a timer can move down several levels at once
+        for (uint32_t level = LEVEL_COUNT; level-- > 0;) {
+            const uint32_t shift = level * LEVEL_BITS;
+            if (current & ((uint64_t(1) << shift) - 1))
+                continue;
+            const uint32_t slot = (current >> shift) & (SLOT_COUNT - 1);
+            if (!(occupied[level] & (uint64_t(1) << slot)))
+                continue;
+
+            occupied[level] &= ~(uint64_t(1) << slot);
+            std::vector<WheelTimerPtr> &list = slots[level][slot];
+            moved.insert(moved.end(), std::make_move_iterator(list.begin()), std::make_move_iterator(list.end()));
+            list.clear();
+        }
+
+        queued -= moved.size();
+        for (const WheelTimerPtr &timer : moved)
+            insert(timer, due);
+    }
+
+    // nothing is due until the next event, so skipping to the time doesn't pass any slot
+    current = std::max(current, time);
+}
+
+void TimerWheel::record_lateness(const std::vector<WheelTimerPtr> &due, uint64_t time) {
+    for (const WheelTimerPtr &timer : due) {
+        const uint64_t lateness = time - timer->deadline;
+        stats.fired++;
+        stats.total_lateness_us += lateness;
+        stats.max_lateness_us = std::max(stats.max_lateness_us, lateness);
+        const size_t bucket = std::min<size_t>(std::bit_width(lateness), TimerWheelStats::BUCKET_COUNT - 1);
+        stats.lateness_histogram[bucket]++;
+    }
+}
+
+void TimerWheel::run() {
+    std::vector<WheelTimerPtr> due;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        const uint64_t time = now();
+        advance(time, due);
+        if (!due.empty()) {
+            record_lateness(due, now());
+            lock.unlock();
+            for (const WheelTimerPtr &timer : due) {
+                {
+                    const std::lock_guard<std::mutex> timer_lock(*timer->mutex);
+                    timer->expired = true;
+                }
+                timer->cond->notify_all();
+            }
+            // the waiters may already be gone, release what the timers kept alive
+            due.clear();
+            lock.lock();
+            continue;
+        }
+
+        const uint64_t next = next_event();
+        wake_at = next;
+        const std::optional<std::chrono::nanoseconds> sleep_time = next == UINT64_MAX ? std::nullopt : clock.host_time_until(epoch + next);
+        if (!sleep_time) {
+            // woken up by a new timer or the clock
+            cond.wait(lock);
+        } else if (*sleep_time > SPIN_TIME) {
+            cond.wait_for(lock, *sleep_time - SPIN_TIME);
+        } else {
+            // sleeping isn't precise enough for the last few hundred us
+            lock.unlock();
+            while (now() < wake_at)
+                std::this_thread::yield();
+            lock.lock();
+        }
+        wake_at = UINT64_MAX;
+    }
+}
+
+TimerWheelStats TimerWheel::get_stats() {
+    const std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void TimerWheel::reset_stats() {
+    const std::lock_guard<std::mutex> lock(mutex);
+    stats = {};
+}
@@ -0,0 +1,156 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <util/byte_ring_buffer.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(byte_ring_buffer, insert_remove_wraps_around) {
+    ByteRingBuffer ring(8);
+    const char in[] = "abcdefgh";
+    char out[8] = {};
+
+    ASSERT_EQ(ring.Insert(in, 6), 6);
+    ASSERT_EQ(ring.Remove(out, 4), 4);
+    ASSERT_EQ(std::string(out, 4), "abcd");
+    ASSERT_EQ(ring.Used(), 2);
+    ASSERT_EQ(ring.Free(), 6);
+
+    // the end of this goes to the start of the buffer
+    ASSERT_EQ(ring.Insert(in, 8), 6);
+    ASSERT_TRUE(ring.Full());
+    ASSERT_EQ(ring.Remove(out, 8), 8);
+    ASSERT_EQ(std::string(out, 8), "efabcdef");
+    ASSERT_TRUE(ring.Empty());
+}
+
+TEST(byte_ring_buffer, min_size_is_all_or_nothing) {
+    ByteRingBuffer ring(8);
+    const char in[] = "abcdefgh";
+    char out[8] = {};
+
+    ASSERT_EQ(ring.Insert(in, 5), 5);
+    // like a msgpipe in FULL mode
+    ASSERT_EQ(ring.Insert(in, 4, 4), 0);
+    ASSERT_EQ(ring.Remove(out, 6, 6), 0);
+    ASSERT_EQ(ring.Used(), 5);
+
+    ASSERT_EQ(ring.Peek(out, 3, 3), 3);
+    ASSERT_EQ(std::string(out, 3), "abc");
+    ASSERT_EQ(ring.Used(), 5);
+    ASSERT_EQ(ring.Remove(out, 5, 5), 5);
+    ASSERT_EQ(ring.Remove(out, 1), 0);
+}
+
+TEST(byte_ring_buffer, empty_ring) {
+    ByteRingBuffer ring(0);
+    char byte = 0;
+    ASSERT_EQ(ring.Insert(&byte, 1), 0);
+    ASSERT_EQ(ring.Remove(&byte, 1), 0);
+    ASSERT_EQ(ring.Peek(&byte, 1), 0);
+}
+
+namespace {
+
+// The previous msgpipe buffer, a ring behind the mutex of the pipe
+class LockedRing {
+public:
+    explicit LockedRing(std::size_t size)
+        : buffer(size) {}
+
+    std::size_t Insert(const void *in, std::size_t size, std::size_t min_size) {
+        const std::lock_guard<std::mutex> lock(mutex);
+        if (buffer.Free() < min_size)
+            return 0;
+        return buffer.Insert(in, size, min_size);
+    }
+
+    std::size_t Remove(void *out, std::size_t size, std::size_t min_size) {
+        const std::lock_guard<std::mutex> lock(mutex);
+        return buffer.Remove(out, size, min_size);
+    }
+
+private:
+    std::mutex mutex;
+    ByteRingBuffer buffer;
+};
+
+// One producer sends numbered messages to several consumers, like a job queue; returns messages per second
+template <typename Ring>
+double transfer_messages(int consumer_count, uint32_t message_count, std::vector<std::atomic<int>> &seen) {
+    Ring ring(4096);
+    std::atomic<uint32_t> received = 0;
+
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < consumer_count; i++) {
+        consumers.emplace_back([&] {
+            uint32_t message[4];
+            while (received < message_count) {
+                if (ring.Remove(message, sizeof(message), sizeof(message)) == sizeof(message)) {
+                    EXPECT_EQ(message[1], message[0] * 3);
+                    seen[message[0]]++;
+                    received++;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    const auto begin = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < message_count;) {
+        const uint32_t message[4] = { i, i * 3, 0, 0 };
+        if (ring.Insert(message, sizeof(message), sizeof(message)))
+            i++;
+        else
+            std::this_thread::yield();
+    }
+    for (std::thread &consumer : consumers)
+        consumer.join();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    return message_count / elapsed.count();
+}
+
+} // namespace
+
+TEST(byte_ring_buffer, every_message_is_received_once) {
+    constexpr uint32_t message_count = 200000;
+    std::vector<std::atomic<int>> seen(message_count);
+    transfer_messages<ByteRingBuffer>(4, message_count, seen);
+    for (uint32_t i = 0; i < message_count; i++)
+        ASSERT_EQ(seen[i], 1) << "message " << i;
+}
+
+// Only prints timings, run it with --gtest_also_run_disabled_tests
+TEST(byte_ring_buffer, DISABLED_benchmark_job_queue) {
+    constexpr uint32_t message_count = 500000;
+    for (const int consumer_count : { 1, 2, 4 }) {
+        std::vector<std::atomic<int>> seen(message_count);
+        const double locked = transfer_messages<LockedRing>(consumer_count, message_count, seen);
+        const double lock_free = transfer_messages<ByteRingBuffer>(consumer_count, message_count, seen);
+        std::printf("%d consumer(s): locked ring %.2f Mmsg/s, lock-free ring %.2f Mmsg/s\n",
+            consumer_count, locked / 1e6, lock_free / 1e6);
+    }
+}
@@ -0,0 +1,338 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/handle_table.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <map>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Object {
+    SceUID uid = 0;
+    int value = 0;
+};
+
+typedef std::shared_ptr<Object> ObjectPtr;
+
+ObjectPtr make_object(int value) {
+    auto object = std::make_shared<Object>();
+    object->value = value;
+    return object;
+}
+
+// Like the sync primitives, which the calls that may block keep with shared_from_this
+struct SharedObject : std::enable_shared_from_this<SharedObject> {
+    SceUID uid = 0;
+};
+
+// Blocks until released, like a guest thread waiting on a primitive without a timeout
+class Blocker {
+public:
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        waiting = true;
+        cond.notify_all();
+        cond.wait(lock, [&] { return released; });
+    }
+
+    void wait_until_blocked() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&] { return waiting; });
+    }
+
+    void release() {
+        const std::lock_guard<std::mutex> lock(mutex);
+        released = true;
+        cond.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool waiting = false;
+    bool released = false;
+};
+
+// The previous storage of the sync primitives, a map behind the kernel mutex
+class LockedTable {
+public:
+    explicit LockedTable(uint32_t) {}
+
+    ObjectPtr get(SceUID uid) const {
+        const std::lock_guard<std::mutex> lock(mutex);
+        const auto it = objects.find(uid);
+        return it == objects.end() ? nullptr : it->second;
+    }
+
+    SceUID add(const ObjectPtr &object) {
+        const std::lock_guard<std::mutex> lock(mutex);
+        object->uid = next_uid++;
+        objects.emplace(object->uid, object);
+        return object->uid;
+    }
+
+    bool erase(SceUID uid) {
+        const std::lock_guard<std::mutex> lock(mutex);
+        return objects.erase(uid) != 0;
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::map<SceUID, ObjectPtr> objects;
+    SceUID next_uid = 1;
+};
+
+} // namespace
+
+TEST(handle_table, add_get_erase) {
+    HandleTable<Object> table(1);
+    const auto object = make_object(42);
+    const SceUID uid = table.add(object);
+    ASSERT_GT(uid, 0);
+    ASSERT_EQ(object->uid, uid);
+    {
+        const HandleReadGuard guard;
+        ASSERT_EQ(table.get(uid), object.get());
+    }
+    ASSERT_EQ(table.size(), 1);
+
+    ASSERT_TRUE(table.erase(uid));
+    {
+        const HandleReadGuard guard;
+        ASSERT_EQ(table.get(uid), nullptr);
+    }
+    ASSERT_FALSE(table.erase(uid));
+    ASSERT_EQ(table.size(), 0);
+
+    // no guard was held while erasing, the table doesn't keep a reference to the object
+    ASSERT_EQ(object.use_count(), 1);
+}
+
+TEST(handle_table, erased_object_lives_while_a_guard_is_held) {
+    HandleTable<Object> table(1);
+    const auto object = make_object(1);
+    const SceUID uid = table.add(object);
+    {
+        const HandleReadGuard guard;
+        const Object *borrowed = table.get(uid);
+        ASSERT_TRUE(table.erase(uid));
+        table.erase(table.add(make_object(2)));
+        ASSERT_EQ(object.use_count(), 2);
+        ASSERT_EQ(borrowed->value, 1);
+    }
+
+    // released by the next change of the table
+    table.erase(table.add(make_object(3)));
+    ASSERT_EQ(object.use_count(), 1);
+}
+
+TEST(handle_table, long_lived_guard_pins_objects_erased_meanwhile) {
+    HandleTable<Object> table(1);
+    Blocker blocker;
+    std::thread holder([&] {
+        const HandleReadGuard guard;
+        blocker.wait();
+    });
+    blocker.wait_until_blocked();
+
+    // erased after the guard was taken, by a thread which never saw them
+    std::vector<std::weak_ptr<Object>> erased;
+    for (int i = 0; i < 100; i++) {
+        const auto object = make_object(i);
+        erased.push_back(object);
+        ASSERT_TRUE(table.erase(table.add(object)));
+    }
+    for (const auto &object : erased)
+        ASSERT_FALSE(object.expired());
+
+    blocker.release();
+    holder.join();
+    table.erase(table.add(make_object(0)));
+    for (const auto &object : erased)
+        ASSERT_TRUE(object.expired());
+}
+
+TEST(handle_table, reference_kept_across_a_wait_does_not_pin) {
+    HandleTable<SharedObject> table(1);
+    const SceUID waited_on = table.add(std::make_shared<SharedObject>());
+    Blocker blocker;
+    std::thread waiter([&] {
+        std::shared_ptr<SharedObject> object;
+        {
+            const HandleReadGuard guard;
+            object = std::static_pointer_cast<SharedObject>(table.get(waited_on)->shared_from_this());
+        }
+        blocker.wait();
+        ASSERT_EQ(object->uid, waited_on);
+    });
+    blocker.wait_until_blocked();
+
+    std::vector<std::weak_ptr<SharedObject>> erased;
+    for (int i = 0; i < 100; i++) {
+        const auto object = std::make_shared<SharedObject>();
+        erased.push_back(object);
+        ASSERT_TRUE(table.erase(table.add(object)));
+    }
+    // the object waited on is erased while the waiter holds it
+    ASSERT_TRUE(table.erase(waited_on));
+    table.erase(table.add(std::make_shared<SharedObject>()));
+    for (const auto &object : erased)
+        ASSERT_TRUE(object.expired());
+
+    blocker.release();
+    waiter.join();
+}
+
+TEST(handle_table, stale_uid_does_not_find_reused_slot) {
+    const HandleReadGuard guard;
+    HandleTable<Object> table(1);
+    const SceUID first = table.add(make_object(1));
+    table.erase(first);
+
+    const SceUID second = table.add(make_object(2));
+    ASSERT_NE(first, second);
+    ASSERT_EQ(table.get(first), nullptr);
+    ASSERT_FALSE(table.erase(first));
+    ASSERT_EQ(table.get(second)->value, 2);
+}
+
+TEST(handle_table, uids_of_other_tables_are_rejected) {
+    const HandleReadGuard guard;
+    HandleTable<Object> first(1);
+    HandleTable<Object> second(2);
+    const SceUID first_uid = first.add(make_object(1));
+    const SceUID second_uid = second.add(make_object(2));
+    ASSERT_NE(first_uid, second_uid);
+    ASSERT_EQ(first.get(second_uid), nullptr);
+    ASSERT_EQ(second.get(first_uid), nullptr);
+    ASSERT_EQ(first.get(0), nullptr);
+    ASSERT_EQ(first.get(-1), nullptr);
+    ASSERT_EQ(first.get(1), nullptr);
+}
+
+TEST(handle_table, full_table) {
+    HandleTable<Object> table(1);
+    std::vector<SceUID> uids;
+    for (uint32_t i = 0; i < HandleTable<Object>::MAX_OBJECT_COUNT; i++)
+        uids.push_back(table.add(make_object(i)));
+    ASSERT_EQ(table.add(make_object(0)), 0);
+    ASSERT_EQ(table.get_all().size(), HandleTable<Object>::MAX_OBJECT_COUNT);
+
+    table.erase(uids[100]);
+    ASSERT_GT(table.add(make_object(0)), 0);
+    const HandleReadGuard guard;
+    ASSERT_EQ(table.get(uids.back())->value, HandleTable<Object>::MAX_OBJECT_COUNT - 1);
+}
+
+TEST(handle_table, lookups_during_erase) {
+    constexpr int reader_count = 4;
+    constexpr int rounds = 20000;
+
+    HandleTable<Object> table(1);
+    std::atomic<SceUID> current = table.add(make_object(7));
+    std::atomic<bool> done = false;
+    std::atomic<int> wrong_values = 0;
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < reader_count; i++) {
+        readers.emplace_back([&] {
+            while (!done) {
+                // an erased object is either not found or still alive
+                const HandleReadGuard guard;
+                if (const auto object = table.get(current.load()); object && object->value != 7)
+                    wrong_values++;
+            }
+        });
+    }
+
+    for (int round = 0; round < rounds; round++) {
+        const SceUID uid = current.load();
+        current = table.add(make_object(7));
+        ASSERT_TRUE(table.erase(uid));
+    }
+    done = true;
+    for (std::thread &reader : readers)
+        reader.join();
+
+    ASSERT_EQ(wrong_values, 0);
+    ASSERT_EQ(table.size(), 1);
+}
+
+// Threads look objects up while another one keeps creating and deleting some, like a game
+// waiting on semaphores while it streams assets
+template <typename Table>
+static double measure_lookups(int thread_count) {
+    constexpr int object_count = 256;
+    constexpr int lookups = 1000000;
+
+    Table table(1);
+    std::vector<SceUID> uids;
+    for (int i = 0; i < object_count; i++)
+        uids.push_back(table.add(make_object(1)));
+
+    std::vector<std::thread> threads;
+    std::atomic<bool> start = false;
+    std::atomic<bool> done = false;
+    std::atomic<int64_t> sum = 0;
+    for (int i = 0; i < thread_count; i++) {
+        threads.emplace_back([&, i] {
+            while (!start)
+                std::this_thread::yield();
+            int64_t local_sum = 0;
+            for (int j = 0; j < lookups; j++) {
+                const HandleReadGuard guard;
+                local_sum += table.get(uids[(i * 7 + j) % object_count])->value;
+            }
+            sum += local_sum;
+        });
+    }
+    std::thread churn([&] {
+        while (!start)
+            std::this_thread::yield();
+        while (!done)
+            table.erase(table.add(make_object(0)));
+    });
+
+    const auto begin = std::chrono::steady_clock::now();
+    start = true;
+    for (std::thread &thread : threads)
+        thread.join();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    done = true;
+    churn.join();
+
+    EXPECT_EQ(sum, static_cast<int64_t>(thread_count) * lookups);
+    return static_cast<double>(thread_count) * lookups / elapsed.count();
+}
+
+// Only prints timings, run it with --gtest_also_run_disabled_tests
+TEST(handle_table, DISABLED_benchmark_contended_lookups) {
+    for (const int thread_count : { 1, 2, 4, 8 }) {
+        const double locked = measure_lookups<LockedTable>(thread_count);
+        const double table = measure_lookups<HandleTable<Object>>(thread_count);
+        std::printf("%d thread(s): mutex + map %.1f Mlookups/s, handle table %.1f Mlookups/s\n",
+            thread_count, locked / 1e6, table / 1e6);
+    }
+}
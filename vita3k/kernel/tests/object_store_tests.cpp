@@ -0,0 +1,121 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/object_store.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct FirstState {
+    int value = 1;
+};
+
+struct SecondState {
+    explicit SecondState(int value)
+        : value(value) {}
+    int value;
+};
+
+// The previous ObjectStore, a map behind a mutex
+class LockedObjectStore {
+public:
+    template <typename T>
+    T *get() {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = objs.find(TypeInfo::get_index<T>());
+        assert(it != objs.end());
+        return reinterpret_cast<T *>(it->second.get());
+    }
+
+    template <typename T, typename... Args>
+    bool create(Args &&...args) {
+        std::lock_guard<std::mutex> lock(mutex);
+        objs.emplace(TypeInfo::get_index<T>(), std::make_shared<T>(std::forward<Args>(args)...));
+        return true;
+    }
+
+private:
+    std::mutex mutex;
+    std::map<uint32_t, std::shared_ptr<void>> objs;
+};
+
+} // namespace
+
+TEST(object_store, create_get_erase) {
+    ObjectStore store;
+    store.create<FirstState>();
+    store.create<SecondState>(42);
+    ASSERT_EQ(store.get<FirstState>()->value, 1);
+    ASSERT_EQ(store.get<SecondState>()->value, 42);
+
+    // an existing object is kept
+    store.create<SecondState>(7);
+    ASSERT_EQ(store.get<SecondState>()->value, 42);
+
+    store.erase<SecondState>();
+    store.create<SecondState>(7);
+    ASSERT_EQ(store.get<SecondState>()->value, 7);
+}
+
+template <typename Store>
+static double measure_lookups(int thread_count) {
+    constexpr int lookups = 2000000;
+
+    Store store;
+    store.template create<FirstState>();
+    store.template create<SecondState>(1);
+
+    std::vector<std::thread> threads;
+    std::atomic<bool> start = false;
+    std::atomic<int64_t> sum = 0;
+    for (int i = 0; i < thread_count; i++) {
+        threads.emplace_back([&] {
+            while (!start)
+                std::this_thread::yield();
+            int64_t local_sum = 0;
+            for (int j = 0; j < lookups; j++)
+                local_sum += (j & 1) ? store.template get<FirstState>()->value : store.template get<SecondState>()->value;
+            sum += local_sum;
+        });
+    }
+
+    const auto begin = std::chrono::steady_clock::now();
+    start = true;
+    for (std::thread &thread : threads)
+        thread.join();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+    EXPECT_EQ(sum, static_cast<int64_t>(thread_count) * lookups);
+    return static_cast<double>(thread_count) * lookups / elapsed.count();
+}
+
+// Only prints timings, run it with --gtest_also_run_disabled_tests
+TEST(object_store, DISABLED_benchmark_lookups) {
+    for (const int thread_count : { 1, 2, 4, 8 }) {
+        const double locked = measure_lookups<LockedObjectStore>(thread_count);
+        const double lock_free = measure_lookups<ObjectStore>(thread_count);
+        std::printf("%d thread(s): mutex + map %.1f Mlookups/s, array %.1f Mlookups/s\n",
+            thread_count, locked / 1e6, lock_free / 1e6);
+    }
+}
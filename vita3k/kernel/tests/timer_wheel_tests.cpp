@@ -0,0 +1,187 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <kernel/timer_wheel.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+// What a waiting guest thread provides to the wheel
+struct Waiter {
+    std::shared_ptr<std::mutex> mutex = std::make_shared<std::mutex>();
+    std::shared_ptr<std::condition_variable> cond = std::make_shared<std::condition_variable>();
+    bool signaled = false;
+
+    // returns the time waited in us, or -1 if the wait was signaled
+    int64_t wait(TimerWheel &wheel, std::chrono::microseconds timeout) {
+        const auto begin = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(*mutex);
+        if (wheel.wait_for(lock, mutex, cond, timeout, [&] { return signaled; }))
+            return -1;
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+    }
+};
+
+} // namespace
+
+TEST(timer_wheel, timeouts_expire_after_their_time) {
+    TimerWheel wheel;
+    // each one ends up in a different level of the wheel
+    for (const auto timeout : { 50us, 700us, 5000us, 70000us, 300000us }) {
+        Waiter waiter;
+        const int64_t waited = waiter.wait(wheel, timeout);
+        ASSERT_GE(waited, timeout.count());
+        ASSERT_LT(waited, timeout.count() + 50000);
+    }
+
+    const TimerWheelStats stats = wheel.get_stats();
+    ASSERT_EQ(stats.fired, 5);
+    ASSERT_EQ(stats.cancelled, 0);
+}
+
+TEST(timer_wheel, zero_timeout_expires_immediately) {
+    TimerWheel wheel;
+    Waiter waiter;
+    ASSERT_GE(waiter.wait(wheel, 0us), 0);
+}
+
+TEST(timer_wheel, speed_shortens_timeouts) {
+    GuestClock clock;
+    TimerWheel wheel(clock);
+    clock.set_speed(4.0f);
+    Waiter waiter;
+    const int64_t waited = waiter.wait(wheel, 200ms);
+    ASSERT_GE(waited, 50000);
+    ASSERT_LT(waited, 150000);
+}
+
+TEST(timer_wheel, vblanks_expire_timeouts_as_fast_as_possible) {
+    GuestClock clock;
+    TimerWheel wheel(clock);
+    clock.set_speed(0);
+    Waiter waiter;
+    std::atomic<bool> expired = false;
+    std::thread thread([&] {
+        waiter.wait(wheel, 40ms);
+        expired = true;
+    });
+
+    // between two vblanks, the clock doesn't move by more than a vblank period
+    std::this_thread::sleep_for(100ms);
+    ASSERT_FALSE(expired);
+
+    for (int i = 0; i < 3; i++)
+        clock.vblank(16667us);
+    thread.join();
+    ASSERT_TRUE(expired);
+}
+
+TEST(timer_wheel, signal_cancels_the_timer) {
+    TimerWheel wheel;
+    Waiter waiter;
+    std::thread signaler([&] {
+        std::this_thread::sleep_for(5ms);
+        {
+            const std::lock_guard<std::mutex> lock(*waiter.mutex);
+            waiter.signaled = true;
+        }
+        waiter.cond->notify_all();
+    });
+    ASSERT_EQ(waiter.wait(wheel, 10s), -1);
+    signaler.join();
+
+    const TimerWheelStats stats = wheel.get_stats();
+    ASSERT_EQ(stats.fired, 0);
+    ASSERT_EQ(stats.cancelled, 1);
+}
+
+TEST(timer_wheel, many_threads_share_the_wheel) {
+    constexpr int thread_count = 32;
+
+    TimerWheel wheel;
+    std::vector<int64_t> waited(thread_count);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; i++) {
+        threads.emplace_back([&, i] {
+            Waiter waiter;
+            // some timeouts share a tick
+            waited[i] = waiter.wait(wheel, std::chrono::microseconds(1000 + (i / 2) * 1500));
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+
+    for (int i = 0; i < thread_count; i++)
+        ASSERT_GE(waited[i], 1000 + (i / 2) * 1500);
+    ASSERT_EQ(wheel.get_stats().fired, thread_count);
+}
+
+// Threads polling with short timeouts, the lateness of condition_variable::wait_for against the wheel
+static void measure_lateness(bool use_wheel, int thread_count, std::vector<int64_t> &lateness) {
+    constexpr int rounds = 100;
+    constexpr auto timeout = 500us;
+
+    TimerWheel wheel;
+    std::mutex lateness_mutex;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; i++) {
+        threads.emplace_back([&] {
+            Waiter waiter;
+            std::vector<int64_t> local;
+            for (int round = 0; round < rounds; round++) {
+                int64_t waited;
+                if (use_wheel) {
+                    waited = waiter.wait(wheel, timeout);
+                } else {
+                    const auto begin = std::chrono::steady_clock::now();
+                    std::unique_lock<std::mutex> lock(*waiter.mutex);
+                    waiter.cond->wait_for(lock, timeout, [&] { return waiter.signaled; });
+                    waited = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+                }
+                local.push_back(waited - timeout.count());
+            }
+            const std::lock_guard<std::mutex> lock(lateness_mutex);
+            lateness.insert(lateness.end(), local.begin(), local.end());
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    std::sort(lateness.begin(), lateness.end());
+}
+
+// Only prints timings, run it with --gtest_also_run_disabled_tests
+TEST(timer_wheel, DISABLED_benchmark_lateness) {
+    for (const int thread_count : { 1, 8, 32 }) {
+        std::vector<int64_t> host, wheel;
+        measure_lateness(false, thread_count, host);
+        measure_lateness(true, thread_count, wheel);
+        const auto percentile = [](const std::vector<int64_t> &values, size_t p) { return values[values.size() * p / 100]; };
+        std::printf("%d thread(s), 500 us timeouts: wait_for late by %lld us median, %lld us p99 / wheel late by %lld us median, %lld us p99\n",
+            thread_count, static_cast<long long>(percentile(host, 50)), static_cast<long long>(percentile(host, 99)),
+            static_cast<long long>(percentile(wheel, 50)), static_cast<long long>(percentile(wheel, 99)));
+    }
+}
@@ -255,6 +255,8 @@ struct LangState {
         { "toggle_touch_note", "Toggles between back touch and screen touch." },
         { "toggle_gui_visibility", "Toggle GUI Visibility" },
         { "toggle_gui_visibility_note", "Toggles between showing and hiding the GUI at the top of the screen while the app is running." },
+        { "toggle_fast_forward", "Toggle Fast-Forward" },
+        { "toggle_fast_forward_note", "Toggles between normal speed and the fast-forward speed of the configuration." },
         { "error", "Error" },
         { "error_duplicate_key", "The key is used for other bindings or it is reserved." }
     };
@@ -382,7 +384,9 @@ struct LangState {
     std::map<std::string, std::string> performance_overlay = {
         { "avg", "Avg" },
         { "min", "Min" },
-        { "max", "Max" }
+        { "max", "Max" },
+        { "vblank_jitter", "Vblank jitter" },
+        { "unlimited", "Max" }
     };
     struct Settings {
         std::map<std::string, std::string> main = { { "title", "Settings" } };
@@ -25,6 +25,7 @@
 #include <gui/functions.h>
 #include <gui/state.h>
 #include <io/state.h>
+#include <kernel/jit_cache.h>
 #include <kernel/state.h>
 #include <modules/module_parent.h>
 #include <packages/functions.h>
@@ -377,6 +378,13 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    // Pre-Translate guest code
+    const auto jit_cache_path{ fs::path(emuenv.base_path) / "cache/shaders" / emuenv.io.title_id / emuenv.self_name };
+    if (emuenv.cfg.jit_cache) {
+        SDL_SetWindowTitle(emuenv.window.get(), fmt::format("{} | {} ({}) | Please wait, translating guest code...", window_title, emuenv.current_app_title, emuenv.io.title_id).c_str());
+        load_jit_cache(emuenv.kernel, emuenv.mem, jit_cache_path);
+    }
+
     if (const auto err = run_app(emuenv, entry_point) != Success)
         return err;
 
@@ -442,6 +450,9 @@ int main(int argc, char *argv[]) {
     CoUninitialize();
 #endif
 
+    if (emuenv.cfg.jit_cache)
+        save_jit_cache(emuenv.kernel, jit_cache_path);
+
     emuenv.renderer->preclose_action();
     app::destroy(emuenv, gui.imgui_state.get());
 
@@ -0,0 +1,121 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <mem/util.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct AllocationEvent {
+    uint64_t time_us; // Since the tracking was enabled
+    Address address;
+    uint32_t size;
+    int32_t thread_id; // Guest thread, 0 for the host threads
+    uint16_t category;
+    bool is_free;
+};
+
+// Allocation sizes in powers of 2, from 4 KiB (and less) to 2 GiB (and more)
+constexpr size_t ALLOCATION_SIZE_BUCKET_COUNT = 20;
+
+struct AllocationCategoryStats {
+    std::string name;
+    uint64_t current_size = 0;
+    uint64_t peak_size = 0;
+    uint64_t total_size = 0;
+    uint32_t live_count = 0;
+    uint64_t alloc_count = 0;
+    uint64_t free_count = 0;
+    std::array<uint32_t, ALLOCATION_SIZE_BUCKET_COUNT> size_histogram = {};
+};
+
+struct AllocationUsageSample {
+    uint64_t time_us;
+    uint64_t current_size; // At the end of the interval
+    uint64_t peak_size; // During the interval
+};
+
+/*! \brief Records the guest allocations while it is enabled.
+ *
+ * The last events are kept in a fixed size ring, the totals are aggregated by category. The category of an
+ * allocation is its name up to the first ": ", so "Thread stack: main (#1)" is counted as "Thread stack".
+ * Only the allocations made while enabled are counted, their free is recorded even after it is disabled.
+ */
+class AllocationTracker {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 1 << 16;
+    static constexpr std::chrono::milliseconds USAGE_SAMPLE_INTERVAL{ 500 };
+    static constexpr size_t MAX_USAGE_SAMPLES = 1200;
+
+    explicit AllocationTracker(size_t capacity = DEFAULT_CAPACITY);
+
+    void set_enabled(bool enabled);
+    bool is_enabled() const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+    void reset();
+
+    void record_alloc(Address address, uint32_t size, const char *name, int32_t thread_id);
+    void record_free(Address address, int32_t thread_id);
+    // The front of the last allocation has been given back, to align it
+    void record_realign(Address address, Address new_address, uint32_t new_size);
+
+    uint64_t get_current_size() const;
+    uint64_t get_peak_size() const;
+    std::vector<AllocationEvent> get_events() const; // Oldest first
+    std::vector<AllocationCategoryStats> get_category_stats() const;
+    std::vector<AllocationUsageSample> get_usage_history() const;
+
+    // One line per event, then one per category
+    std::string get_events_csv() const;
+    std::string get_summary_csv() const;
+
+    static std::string_view get_category(std::string_view name);
+    static size_t get_size_bucket(uint32_t size);
+
+private:
+    struct LiveAllocation {
+        uint32_t size;
+        uint16_t category;
+    };
+
+    std::atomic<bool> enabled = false;
+    std::chrono::steady_clock::time_point start_time;
+
+    mutable std::mutex mutex;
+    std::vector<AllocationEvent> events;
+    uint64_t event_count = 0;
+    std::vector<AllocationCategoryStats> categories;
+    std::unordered_map<std::string, uint16_t> category_indices;
+    std::unordered_map<Address, LiveAllocation> live_allocations;
+    uint64_t current_size = 0;
+    uint64_t peak_size = 0;
+    std::vector<AllocationUsageSample> usage_history;
+
+    uint64_t now_us() const;
+    uint16_t get_category_index(const char *name);
+    void push_event(const AllocationEvent &event);
+    void sample_usage(uint64_t time_us);
+};
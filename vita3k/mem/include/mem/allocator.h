@@ -21,12 +21,28 @@
 #include <mutex>
 #include <vector>
 
+// Bitmap of free slots (bit set = free), the slot n is the bit (31 - n % 32) of the word n / 32.
+// A binary tree summarizes the free runs of the words, so that searching a free run or counting free slots
+// skips the parts of the bitmap which can't match instead of scanning every word.
 struct BitmapAllocator {
+    struct Summary {
+        std::uint32_t free = 0; // Free slots
+        std::uint32_t prefix = 0; // Free slots at the start
+        std::uint32_t suffix = 0; // Free slots at the end
+        std::uint32_t longest = 0; // Longest run of free slots
+    };
+
     std::vector<std::uint32_t> words;
     std::size_t max_offset;
 
+    // Node 1 is the root, the children of node n are 2n and 2n + 1, leaf_count + i is the leaf of words[i]
+    std::vector<Summary> summary;
+    std::size_t leaf_count = 0;
+
 protected:
     int force_fill(const std::uint32_t offset, const int size, const bool or_mode = false);
+    void update_summary(const std::size_t first_word, const std::size_t last_word);
+    int find_free_run(const std::uint32_t start_offset, const int size, const bool best_fit) const;
 
 public:
     BitmapAllocator() = default;
@@ -39,6 +55,13 @@ public:
     void free(const std::uint32_t offset, const int size);
     void reset();
 
+    // Must be called after modifying words directly
+    void rebuild_summary();
+
+    bool is_free(const std::uint32_t offset) const {
+        return offset < max_offset && (words[offset >> 5] & (0x80000000U >> (offset & 31)));
+    }
+
     // Count free bits in [offset, offset_end) (exclusive)
     int free_slot_count(const std::uint32_t offset, const std::uint32_t offset_end) const;
 };
@@ -20,7 +20,10 @@
 #include <mem/block.h>
 #include <mem/util.h>
 
+#include <memory>
+
 struct MemState;
+struct MemSnapshot;
 
 typedef std::function<bool(uint8_t *addr, bool write)> AccessViolationHandler;
 
@@ -33,17 +36,29 @@ enum struct MemPerm {
     ReadWrite = ReadOnly | WriteOnly
 };
 
-bool init(MemState &state, const bool use_page_table);
+// How the writes to protected pages are caught
+enum struct WriteTracking {
+    Mprotect, // Page protection and the access violation handler
+    Userfaultfd, // Write-protect mode of userfaultfd, Linux only. Only for MemPerm::ReadOnly, other permissions use Mprotect.
+};
+
+bool init(MemState &state, const bool use_page_table, const WriteTracking write_tracking = WriteTracking::Mprotect);
 Address alloc(MemState &state, uint32_t size, const char *name);
 Address alloc(MemState &state, uint32_t size, const char *name, unsigned int alignment);
 void protect_inner(MemState &state, Address addr, uint32_t size, const MemPerm perm);
 void unprotect_inner(MemState &state, Address addr, uint32_t size);
-bool add_protect(MemState &state, Address addr, const uint32_t size, const MemPerm perm, ProtectCallback callback);
-void open_access_parent_protect_segment(MemState &mem, Address addr);
-void close_access_parent_protect_segment(MemState &mem, Address addr);
+// The block is removed when its callback returns true, or by remove_protect
+ProtectBlockPtr add_protect(MemState &state, Address addr, const uint32_t size, const MemPerm perm, ProtectCallback callback);
+void remove_protect(MemState &state, const ProtectBlockPtr &block);
+void open_access_parent_protect_segment(MemState &mem, Address addr, uint32_t size);
+void close_access_parent_protect_segment(MemState &mem, Address addr, uint32_t size);
 void add_external_mapping(MemState &mem, Address addr, uint32_t size, uint8_t *addr_ptr);
 void remove_external_mapping(MemState &mem, uint8_t *addr_ptr);
 bool is_protecting(MemState &state, Address addr, MemPerm *perm = nullptr);
+// Lets caches know if the memory they use changed without hashing it. Take the snapshot before reading the data,
+// any write to the range after it makes pages_changed_since return true.
+uint64_t snapshot_write_generation(MemState &state, Address addr, uint32_t size);
+bool pages_changed_since(const MemState &state, Address addr, uint32_t size, uint64_t generation);
 bool is_valid_addr(const MemState &state, Address addr);
 bool is_valid_addr_range(const MemState &state, Address start, Address end);
 bool handle_access_violation(MemState &state, uint8_t *addr, bool write) noexcept;
@@ -52,4 +67,24 @@ Address alloc_at(MemState &state, Address address, uint32_t size, const char *na
 Address try_alloc_at(MemState &state, Address address, uint32_t size, const char *name);
 void free(MemState &state, Address address);
 uint32_t mem_available(MemState &state);
+
+// The guest must not run while a snapshot is taken or restored.
+// A snapshot only stores the pages which changed since the previous one, they are found by hashing the allocated memory.
+std::shared_ptr<const MemSnapshot> take_snapshot(MemState &state);
+// Writes go through the access violation handler like guest writes, so the caches watching the memory see them
+void restore_snapshot(MemState &state, const std::shared_ptr<const MemSnapshot> &snapshot);
+// Forgets the snapshots taken so far, the next one stores all the allocated memory
+void reset_snapshots(MemState &state);
+
+struct MemResidency {
+    uint64_t allocated = 0; // Guest pages allocated
+    uint64_t resident = 0; // Host memory backing the guest memory
+    uint64_t huge_pages = 0; // Part of resident in transparent huge pages, Linux only
+    bool resident_available = false;
+};
+
+// Slow, it checks all the guest memory
+MemResidency get_residency(MemState &state);
 const char *mem_name(Address address, MemState &state);
+// Guest thread of the calling host thread, recorded by the allocation tracker
+void set_allocation_thread_id(int32_t thread_id);
@@ -78,7 +78,7 @@ public:
     }
 
     bool valid(const MemState &mem) const {
-        return is_valid_addr(mem, addr);
+        return addr && is_valid_page(mem, addr);
     }
 
     void reset() {
@@ -17,13 +17,17 @@
 
 #pragma once
 
+#include <mem/allocation_tracker.h>
 #include <mem/allocator.h>
 #include <mem/util.h>
 
 #include <array>
+#include <atomic>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <set>
+#include <vector>
 
 struct AllocMemPage {
     uint32_t allocated : 4;
@@ -36,27 +40,53 @@ typedef uint8_t *PagePtr;
 typedef std::unique_ptr<uint8_t[], std::function<void(uint8_t *)>> Memory;
 typedef std::unique_ptr<AllocMemPage[]> AllocPageTable;
 typedef std::unique_ptr<PagePtr[]> PageTable;
+typedef std::unique_ptr<std::atomic<uint8_t>[]> ValidPageTable;
+typedef std::unique_ptr<std::atomic<uint64_t>[]> WriteGenerationTable;
 typedef std::map<int, std::string> PageNameMap;
 
 struct ProtectBlockInfo {
+    Address addr = 0;
     uint32_t size = 0;
+    MemPerm perm = MemPerm::None;
     ProtectCallback callback;
+
+    // A block spanning several pages can be hit by faults on all of them at the same time
+    std::mutex callback_mutex;
+    std::atomic<bool> removed = false;
 };
 
-struct ProtectSegmentInfo {
-    std::multimap<Address, ProtectBlockInfo> blocks;
-    uint32_t size = 0;
+// Protection of a single page, a block is referenced by all the pages it covers
+struct ProtectPageInfo {
+    std::vector<ProtectBlockPtr> blocks;
     int32_t ref_count = 0; // When reference count is active, we don't interfere protection.
-    MemPerm perm = MemPerm::None;
+    MemPerm perm = MemPerm::ReadWrite;
+};
 
-    explicit ProtectSegmentInfo() = default;
-    explicit ProtectSegmentInfo(uint32_t size, MemPerm perm)
-        : size(size)
-        , perm(perm) {
-    }
+typedef std::unique_ptr<std::unique_ptr<ProtectPageInfo>[]> ProtectPageTable;
+
+// Pages are locked by stripes, so that faults on different pages are handled in parallel
+constexpr size_t PROTECT_STRIPE_COUNT = 64;
+
+struct alignas(64) ProtectStripe {
+    std::mutex mutex;
 };
 
-typedef std::map<Address, ProtectSegmentInfo, std::greater<Address>> ProtectSegmentTrees;
+// Guest memory at one point in time. Only the pages which changed since the parent are stored,
+// the other ones are shared with the parent chain.
+struct MemSnapshot {
+    std::shared_ptr<const MemSnapshot> parent;
+
+    // Sorted page numbers, and their content one after the other
+    std::vector<uint32_t> pages;
+    std::vector<uint8_t> data;
+
+    std::vector<uint32_t> allocator_words;
+    std::vector<std::pair<uint32_t, AllocMemPage>> allocations;
+    PageNameMap page_names;
+    uint64_t allocated_size = 0;
+};
+
+typedef std::shared_ptr<const MemSnapshot> MemSnapshotPtr;
 
 struct MemExternalMapping {
     Address address;
@@ -65,17 +95,44 @@ struct MemExternalMapping {
 
 struct MemState {
     std::mutex generation_mutex;
-    std::mutex protect_mutex;
+    std::mutex external_mapping_mutex;
 
     uint32_t page_size = 0;
     Memory memory;
     AllocPageTable alloc_table;
     BitmapAllocator allocator;
-    ProtectSegmentTrees protect_tree;
+    std::array<ProtectStripe, PROTECT_STRIPE_COUNT> protect_stripes;
+    ProtectPageTable protect_pages;
+
+    // Generation of the last write seen on each page, shifted left by one. The low bit is set while the page is watched.
+    std::atomic<uint64_t> write_generation = 1;
+    WriteGenerationTable page_write_generations;
+
+    // The backend in use, Mprotect if the requested one is not available
+    WriteTracking write_tracking = WriteTracking::Mprotect;
+    std::atomic<uint64_t> access_violation_count = 0;
+    std::atomic<uint64_t> userfaultfd_fault_count = 0;
 
+    // The names are only kept while the tracker is enabled
+    AllocationTracker allocation_tracker;
     PageNameMap page_name_map;
 
+    // Hash of every allocated page at the last snapshot taken or restored, 0 if unknown
+    std::vector<uint64_t> snapshot_page_hashes;
+    MemSnapshotPtr last_snapshot;
+
+    // One byte per 4 KiB page, set when it is allocated. Read without any lock by the slow memory path of the CPU.
+    ValidPageTable valid_pages;
+
+    // Set before init. Big allocations are aligned to 2 MiB and advised to use transparent huge pages,
+    // freed memory is given back to the host and allocated memory is committed when touched.
+    bool use_huge_pages = false;
+
     bool use_page_table = false;
     PageTable page_table;
     std::map<uint64_t, MemExternalMapping, std::greater<uint64_t>> external_mapping;
 };
+
+inline bool is_valid_page(const MemState &state, Address addr) {
+    return state.valid_pages[addr / KiB(4)].load(std::memory_order_relaxed) != 0;
+}
@@ -25,9 +25,11 @@
 
 struct CPUState;
 struct MemState;
+struct ProtectBlockInfo;
 
 typedef uint32_t Address;
 typedef std::function<bool(Address, bool)> ProtectCallback;
+typedef std::shared_ptr<ProtectBlockInfo> ProtectBlockPtr;
 
 // Powers of 10
 constexpr size_t KB(size_t kb) {
@@ -0,0 +1,235 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <mem/allocation_tracker.h>
+
+#include <algorithm>
+#include <bit>
+#include <sstream>
+
+AllocationTracker::AllocationTracker(size_t capacity)
+    : events(capacity) {
+}
+
+void AllocationTracker::set_enabled(bool enabled) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    if (enabled && !this->enabled && event_count == 0)
+        start_time = std::chrono::steady_clock::now();
+    this->enabled = enabled;
+}
+
+void AllocationTracker::reset() {
+    const std::lock_guard<std::mutex> lock(mutex);
+    start_time = std::chrono::steady_clock::now();
+    event_count = 0;
+    categories.clear();
+    category_indices.clear();
+    live_allocations.clear();
+    current_size = 0;
+    peak_size = 0;
+    usage_history.clear();
+}
+
+uint64_t AllocationTracker::now_us() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+std::string_view AllocationTracker::get_category(std::string_view name) {
+    return name.substr(0, name.find(": "));
+}
+
+size_t AllocationTracker::get_size_bucket(uint32_t size) {
+    const uint32_t pages = std::max<uint32_t>(size >> 12, 1);
+    return std::min<size_t>(std::bit_width(pages) - 1, ALLOCATION_SIZE_BUCKET_COUNT - 1);
+}
+
+uint16_t AllocationTracker::get_category_index(const char *name) {
+    std::string category{ get_category(name ? name : "") };
+    const auto it = category_indices.find(category);
+    if (it != category_indices.end())
+        return it->second;
+
+    // the last index is shared by all the categories past the limit
+    if (categories.size() == UINT16_MAX) {
+        categories.back().name = "Other";
+        return UINT16_MAX - 1;
+    }
+
+    const uint16_t index = static_cast<uint16_t>(categories.size());
+    categories.emplace_back().name = category;
+    category_indices.emplace(std::move(category), index);
+    return index;
+}
+
+void AllocationTracker::push_event(const AllocationEvent &event) {
+    events[event_count % events.size()] = event;
+    event_count++;
+}
+
+void AllocationTracker::sample_usage(uint64_t time_us) {
+    const uint64_t interval = std::chrono::duration_cast<std::chrono::microseconds>(USAGE_SAMPLE_INTERVAL).count();
+    const uint64_t sample_time = time_us - time_us % interval;
+    if (usage_history.empty() || usage_history.back().time_us != sample_time) {
+        if (usage_history.size() == MAX_USAGE_SAMPLES)
+            usage_history.erase(usage_history.begin());
+        usage_history.push_back({ sample_time, current_size, current_size });
+    }
+
+    AllocationUsageSample &sample = usage_history.back();
+    sample.current_size = current_size;
+    sample.peak_size = std::max(sample.peak_size, current_size);
+}
+
+void AllocationTracker::record_alloc(Address address, uint32_t size, const char *name, int32_t thread_id) {
+    if (!is_enabled())
+        return;
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    const uint64_t time_us = now_us();
+    const uint16_t category = get_category_index(name);
+    push_event({ time_us, address, size, thread_id, category, false });
+    live_allocations[address] = { size, category };
+
+    AllocationCategoryStats &stats = categories[category];
+    stats.current_size += size;
+    stats.peak_size = std::max(stats.peak_size, stats.current_size);
+    stats.total_size += size;
+    stats.live_count++;
+    stats.alloc_count++;
+    stats.size_histogram[get_size_bucket(size)]++;
+
+    current_size += size;
+    peak_size = std::max(peak_size, current_size);
+    sample_usage(time_us);
+}
+
+void AllocationTracker::record_free(Address address, int32_t thread_id) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto it = live_allocations.find(address);
+    if (it == live_allocations.end())
+        return;
+
+    const uint64_t time_us = now_us();
+    const LiveAllocation allocation = it->second;
+    live_allocations.erase(it);
+    push_event({ time_us, address, allocation.size, thread_id, allocation.category, true });
+
+    AllocationCategoryStats &stats = categories[allocation.category];
+    stats.current_size -= allocation.size;
+    stats.live_count--;
+    stats.free_count++;
+
+    current_size -= allocation.size;
+    sample_usage(time_us);
+}
+
+void AllocationTracker::record_realign(Address address, Address new_address, uint32_t new_size) {
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto it = live_allocations.find(address);
+    if (it == live_allocations.end())
+        return;
+
+    const LiveAllocation allocation{ new_size, it->second.category };
+    const uint32_t removed_size = it->second.size - new_size;
+    live_allocations.erase(it);
+    live_allocations[new_address] = allocation;
+
+    AllocationCategoryStats &stats = categories[allocation.category];
+    stats.current_size -= removed_size;
+    stats.total_size -= removed_size;
+    stats.size_histogram[get_size_bucket(allocation.size + removed_size)]--;
+    stats.size_histogram[get_size_bucket(new_size)]++;
+    current_size -= removed_size;
+
+    // the allocation is the last event, the alloc lock is still held
+    AllocationEvent &event = events[(event_count - 1) % events.size()];
+    if (event.address == address && !event.is_free) {
+        event.address = new_address;
+        event.size = new_size;
+    }
+}
+
+uint64_t AllocationTracker::get_current_size() const {
+    const std::lock_guard<std::mutex> lock(mutex);
+    return current_size;
+}
+
+uint64_t AllocationTracker::get_peak_size() const {
+    const std::lock_guard<std::mutex> lock(mutex);
+    return peak_size;
+}
+
+std::vector<AllocationEvent> AllocationTracker::get_events() const {
+    const std::lock_guard<std::mutex> lock(mutex);
+    const uint64_t count = std::min<uint64_t>(event_count, events.size());
+    std::vector<AllocationEvent> result;
+    result.reserve(count);
+    for (uint64_t i = event_count - count; i < event_count; i++)
+        result.push_back(events[i % events.size()]);
+    return result;
+}
+
+std::vector<AllocationCategoryStats> AllocationTracker::get_category_stats() const {
+    const std::lock_guard<std::mutex> lock(mutex);
+    return categories;
+}
+
+std::vector<AllocationUsageSample> AllocationTracker::get_usage_history() const {
+    const std::lock_guard<std::mutex> lock(mutex);
+    return usage_history;
+}
+
+static std::string quote_csv(const std::string &value) {
+    std::string quoted = "\"";
+    for (const char c : value) {
+        if (c == '"')
+            quoted += '"';
+        quoted += c;
+    }
+    return quoted + '"';
+}
+
+std::string AllocationTracker::get_events_csv() const {
+    const std::vector<AllocationEvent> events_copy = get_events();
+    const std::vector<AllocationCategoryStats> categories_copy = get_category_stats();
+
+    std::ostringstream csv;
+    csv << "time_us,event,address,size,category,thread_id\n";
+    for (const AllocationEvent &event : events_copy) {
+        csv << event.time_us << ',' << (event.is_free ? "free" : "alloc") << ",0x" << std::hex << event.address << std::dec << ','
+            << event.size << ',' << quote_csv(categories_copy[event.category].name) << ',' << event.thread_id << '\n';
+    }
+    return csv.str();
+}
+
+std::string AllocationTracker::get_summary_csv() const {
+    const std::vector<AllocationCategoryStats> categories_copy = get_category_stats();
+
+    std::ostringstream csv;
+    csv << "category,live_count,current_size,peak_size,total_size,alloc_count,free_count";
+    for (size_t bucket = 0; bucket < ALLOCATION_SIZE_BUCKET_COUNT; bucket++)
+        csv << ",size_" << (KiB(4) << bucket);
+    csv << '\n';
+    for (const AllocationCategoryStats &stats : categories_copy) {
+        csv << quote_csv(stats.name) << ',' << stats.live_count << ',' << stats.current_size << ',' << stats.peak_size << ','
+            << stats.total_size << ',' << stats.alloc_count << ',' << stats.free_count;
+        for (const uint32_t count : stats.size_histogram)
+            csv << ',' << count;
+        csv << '\n';
+    }
+    return csv.str();
+}
@@ -17,9 +17,13 @@
 
 #include <mem/allocator.h>
 
+#include <algorithm>
+#include <bit>
+
 BitmapAllocator::BitmapAllocator(const std::size_t total_bits)
     : words((total_bits >> 5) + ((total_bits % 32 != 0) ? 1 : 0), 0xFFFFFFFF)
     , max_offset(total_bits) {
+    rebuild_summary();
 }
 
 void BitmapAllocator::set_maximum(const std::size_t total_bits) {
@@ -35,10 +39,88 @@ void BitmapAllocator::set_maximum(const std::size_t total_bits) {
     }
 
     max_offset = total_bits;
+    rebuild_summary();
 }
 
 void BitmapAllocator::reset() {
     words.clear();
+    summary.clear();
+    leaf_count = 0;
+}
+
+// Value of the word with the slots past max_offset marked as used
+static std::uint32_t get_valid_bits(const std::vector<std::uint32_t> &words, const std::size_t max_offset, const std::size_t index) {
+    if (index >= words.size()) {
+        return 0;
+    }
+
+    const std::size_t first_slot = index << 5;
+    if (first_slot + 32 <= max_offset) {
+        return words[index];
+    }
+
+    const std::size_t valid_count = max_offset > first_slot ? max_offset - first_slot : 0;
+    return valid_count == 0 ? 0 : (words[index] & ~(0xFFFFFFFFU >> valid_count));
+}
+
+static BitmapAllocator::Summary summarize_word(std::uint32_t word) {
+    BitmapAllocator::Summary result;
+    result.free = std::popcount(word);
+    result.prefix = std::countl_one(word);
+    result.suffix = std::countr_one(word);
+
+    // Each step shortens all the runs by one
+    while (word != 0) {
+        word &= word << 1;
+        result.longest++;
+    }
+
+    return result;
+}
+
+static BitmapAllocator::Summary merge_summaries(const BitmapAllocator::Summary &left, const BitmapAllocator::Summary &right, const std::uint32_t child_size) {
+    BitmapAllocator::Summary result;
+    result.free = left.free + right.free;
+    result.prefix = left.prefix == child_size ? child_size + right.prefix : left.prefix;
+    result.suffix = right.suffix == child_size ? child_size + left.suffix : right.suffix;
+    result.longest = std::max({ left.longest, right.longest, left.suffix + right.prefix });
+    return result;
+}
+
+void BitmapAllocator::rebuild_summary() {
+    leaf_count = std::bit_ceil(std::max<std::size_t>(words.size(), 1));
+    summary.assign(leaf_count * 2, Summary{});
+
+    for (std::size_t i = 0; i < words.size(); i++) {
+        summary[leaf_count + i] = summarize_word(get_valid_bits(words, max_offset, i));
+    }
+
+    std::uint32_t child_size = 32;
+    for (std::size_t level_start = leaf_count / 2; level_start >= 1; level_start /= 2) {
+        for (std::size_t node = level_start; node < level_start * 2; node++) {
+            summary[node] = merge_summaries(summary[node * 2], summary[node * 2 + 1], child_size);
+        }
+        child_size *= 2;
+    }
+}
+
+void BitmapAllocator::update_summary(const std::size_t first_word, const std::size_t last_word) {
+    std::size_t first = leaf_count + first_word;
+    std::size_t last = leaf_count + std::min(last_word, words.size() - 1);
+
+    for (std::size_t node = first; node <= last; node++) {
+        summary[node] = summarize_word(get_valid_bits(words, max_offset, node - leaf_count));
+    }
+
+    std::uint32_t child_size = 32;
+    while (first > 1) {
+        first /= 2;
+        last /= 2;
+        for (std::size_t node = first; node <= last; node++) {
+            summary[node] = merge_summaries(summary[node * 2], summary[node * 2 + 1], child_size);
+        }
+        child_size *= 2;
+    }
 }
 
 int BitmapAllocator::force_fill(const std::uint32_t offset, const int size, const bool or_mode) {
@@ -58,6 +140,7 @@ int BitmapAllocator::force_fill(const std::uint32_t offset, const int size, cons
             *word = wval & (~mask);
         }
 
+        update_summary(offset >> 5, offset >> 5);
         return std::min<int>(size, static_cast<int>((words.size() << 5) - set_bit));
     }
 
@@ -85,6 +168,7 @@ int BitmapAllocator::force_fill(const std::uint32_t offset, const int size, cons
         }
     }
 
+    update_summary(offset >> 5, (word - words.data()) - 1);
     return std::min<int>(size, static_cast<int>((words.size() << 5) - set_bit));
 }
 
@@ -96,84 +180,124 @@ void BitmapAllocator::free(const std::uint32_t offset, const int size) {
     force_fill(offset, size, true);
 }
 
-int BitmapAllocator::allocate_from(const std::uint32_t start_offset, int &size, const bool best_fit) {
-    if (words.empty()) {
-        return -1;
+namespace {
+
+// State of a search walking the free runs in increasing offset order
+struct RunSearch {
+    std::uint32_t size;
+    bool best_fit;
+
+    std::uint32_t run_start = 0;
+    std::uint32_t run_size = 0;
+
+    int result = -1;
+    std::uint32_t result_size = UINT32_MAX;
+    bool done = false;
+
+    void extend_run(const std::uint32_t offset, const std::uint32_t count) {
+        if (run_size == 0) {
+            run_start = offset;
+        }
+        run_size += count;
+
+        // The first fit doesn't need to know where the run ends
+        if (!best_fit && run_size >= size) {
+            result = static_cast<int>(run_start);
+            done = true;
+        }
     }
 
-    std::uint32_t *word = &words[0] + (start_offset >> 5);
-
-    // We have arrived at le word that still have free position (bit 1)
-    std::uint32_t *word_end = &words[words.size() - 1];
-
-    int bflmin = 0xFFFFFF;
-    int bofmin = -1;
-    std::uint32_t *wordmin = nullptr;
-
-    // Keep finding
-    while (word <= word_end) {
-        std::uint32_t wv = *word;
-
-        if (wv != 0) {
-            // Still have free stuff
-            int bflen = 0;
-            int boff = 0;
-            std::uint32_t *bword = nullptr;
-
-            int cursor = 31;
-
-            while (cursor >= 0) {
-                if (((wv >> cursor) & 1) == 1) {
-                    boff = cursor;
-                    bflen = 0;
-                    bword = word;
-
-                    while (cursor >= 0 && (((wv >> cursor) & 1) == 1)) {
-                        bflen++;
-                        cursor--;
-
-                        if (cursor < 0 && (word + 1 <= word_end)) {
-                            cursor = 31;
-                            word++;
-                            wv = *word;
-                        }
-                    }
-
-                    if (bflen >= size) {
-                        if (!best_fit) {
-                            // Force allocate and then return
-                            const int offset = static_cast<int>(31 - boff + ((bword - &words[0]) << 5));
-                            if ((static_cast<std::size_t>(offset) + size) <= max_offset) {
-                                size = force_fill(static_cast<const std::uint32_t>(offset), size, false);
-                                return offset;
-                            }
-                        } else {
-                            if (bflen < bflmin) {
-                                bflmin = bflen;
-                                bofmin = boff;
-                                wordmin = bword;
-                            }
-                        }
-                    }
+    void end_run() {
+        if (run_size >= size && run_size < result_size) {
+            result = static_cast<int>(run_start);
+            result_size = run_size;
+            // Nothing can fit better
+            done = run_size == size;
+        }
+        run_size = 0;
+    }
+};
+
+} // namespace
+
+static void search_free_run(const BitmapAllocator &allocator, RunSearch &search, const std::size_t node, const std::uint32_t node_start, const std::uint32_t node_size, const std::uint32_t start_offset) {
+    const std::uint32_t node_end = node_start + node_size;
+    if (search.done || node_end <= start_offset) {
+        return;
+    }
+
+    const BitmapAllocator::Summary &info = allocator.summary[node];
+    if (node_start >= start_offset) {
+        if (info.free == node_size) {
+            search.extend_run(node_start, node_size);
+            return;
+        }
+
+        // No run inside the node is big enough, only the ones going through its boundaries matter
+        if (info.longest < search.size) {
+            if (info.prefix != 0) {
+                search.extend_run(node_start, info.prefix);
+                if (search.done) {
+                    return;
                 }
+            }
+            search.end_run();
+            if (info.suffix != 0 && !search.done) {
+                search.extend_run(node_end - info.suffix, info.suffix);
+            }
+            return;
+        }
+    }
 
-                cursor--;
+    if (node_size == 32) {
+        const std::uint32_t word = get_valid_bits(allocator.words, allocator.max_offset, node - allocator.leaf_count);
+        std::uint32_t offset = std::max(node_start, start_offset);
+
+        while (offset < node_end && !search.done) {
+            const std::uint32_t remaining = word << (offset - node_start);
+            if (remaining & 0x80000000U) {
+                const std::uint32_t count = std::countl_one(remaining);
+                search.extend_run(offset, count);
+                offset += count;
+            } else {
+                search.end_run();
+                offset += std::min<std::uint32_t>(std::countl_zero(remaining), node_end - offset);
             }
         }
+        return;
+    }
 
-        word++;
+    const std::uint32_t child_size = node_size / 2;
+    search_free_run(allocator, search, node * 2, node_start, child_size, start_offset);
+    search_free_run(allocator, search, node * 2 + 1, node_start + child_size, child_size, start_offset);
+}
+
+int BitmapAllocator::find_free_run(const std::uint32_t start_offset, const int size, const bool best_fit) const {
+    if (size <= 0 || summary.empty() || summary[1].longest < static_cast<std::uint32_t>(size)) {
+        return -1;
     }
 
-    if (best_fit && bofmin != -1) {
-        // Force allocate and then return
-        const int offset = static_cast<int>(31 - bofmin + ((wordmin - &words[0]) << 5));
-        if ((static_cast<std::size_t>(offset) + size) <= max_offset) {
-            size = force_fill(static_cast<std::uint32_t>(offset), size, false);
-            return offset;
-        }
+    RunSearch search{ static_cast<std::uint32_t>(size), best_fit };
+    search_free_run(*this, search, 1, 0, static_cast<std::uint32_t>(leaf_count << 5), start_offset);
+    if (!search.done) {
+        search.end_run();
     }
 
-    return -1;
+    return search.result;
+}
+
+int BitmapAllocator::allocate_from(const std::uint32_t start_offset, int &size, const bool best_fit) {
+    if (words.empty()) {
+        return -1;
+    }
+
+    const int offset = find_free_run(start_offset, size, best_fit);
+    if (offset < 0) {
+        return -1;
+    }
+
+    size = force_fill(static_cast<std::uint32_t>(offset), size, false);
+    return offset;
 }
 
 int BitmapAllocator::allocate_at(const std::uint32_t start_offset, int size) {
@@ -208,15 +332,39 @@ int BitmapAllocator::free_slot_count(const std::uint32_t offset, const std::uint
 
     std::uint32_t free_count = 0;
 
-    while (start_bit < end_bit) {
-        const std::uint32_t next_end_bit = std::min<std::uint32_t>(((start_bit + 32) >> 5) << 5, end_bit);
-
+    // Counts the bits in [start_bit, next_end_bit), both in the same word
+    const auto count_in_word = [&](const std::uint32_t next_end_bit) {
         const int left_shift = start_bit & 31;
         const int right_shift = (31 - (next_end_bit - 1) & 31);
         std::uint32_t word_to_scan = words[start_bit >> 5] << left_shift >> right_shift >> left_shift;
         free_count += number_of_set_bits(word_to_scan);
 
         start_bit = next_end_bit;
+    };
+
+    if (start_bit < end_bit && (start_bit & 31) != 0) {
+        count_in_word(std::min<std::uint32_t>(((start_bit + 32) >> 5) << 5, end_bit));
+    }
+
+    // The full words in the middle are summed up from the tree
+    std::size_t first_node = leaf_count + (start_bit >> 5);
+    std::size_t end_node = leaf_count + (end_bit >> 5);
+    if (start_bit < end_bit && first_node < end_node) {
+        start_bit = end_bit & ~31U;
+        while (first_node < end_node) {
+            if (first_node & 1) {
+                free_count += summary[first_node++].free;
+            }
+            if (end_node & 1) {
+                free_count += summary[--end_node].free;
+            }
+            first_node /= 2;
+            end_node /= 2;
+        }
+    }
+
+    if (start_bit < end_bit) {
+        count_in_word(end_bit);
     }
 
     return free_count;
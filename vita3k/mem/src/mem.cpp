@@ -22,10 +22,18 @@
 #include <util/float_to_half.h>
 #include <util/log.h>
 
+#include <xxh3.h>
+
 #include <algorithm>
+#include <bitset>
 #include <cassert>
+#include <cinttypes>
 #include <cmath>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
+#include <thread>
+#include <vector>
 
 #ifdef WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -36,10 +44,24 @@
 #include <unistd.h>
 #endif
 
+#if defined(__linux__) && __has_include(<linux/userfaultfd.h>)
+#include <fcntl.h>
+#include <linux/userfaultfd.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#ifdef UFFDIO_WRITEPROTECT
+#define HAS_USERFAULTFD_WP
+#endif
+#endif
+
 constexpr uint32_t STANDARD_PAGE_SIZE = KiB(4);
 constexpr size_t TOTAL_MEM_SIZE = GiB(4);
+constexpr size_t HUGE_PAGE_SIZE = MiB(2);
 constexpr bool LOG_PROTECT = false;
-constexpr bool PAGE_NAME_TRACKING = false;
+
+static thread_local int32_t allocation_thread_id = 0;
 
 // TODO: support multiple handlers
 static AccessViolationHandler access_violation_handler;
@@ -58,7 +80,86 @@ static std::string get_error_msg() {
 }
 #endif
 
-bool init(MemState &state, const bool use_page_table) {
+#ifdef HAS_USERFAULTFD_WP
+static int userfaultfd_fd = -1;
+
+static void userfaultfd_write_protect(uint8_t *addr, uint32_t size, bool protect) {
+    uffdio_writeprotect write_protect = {};
+    write_protect.range.start = reinterpret_cast<uintptr_t>(addr);
+    write_protect.range.len = size;
+    // Removing the protection also wakes up the threads waiting on it
+    write_protect.mode = protect ? UFFDIO_WRITEPROTECT_MODE_WP : 0;
+    const int ret = ioctl(userfaultfd_fd, UFFDIO_WRITEPROTECT, &write_protect);
+    LOG_CRITICAL_IF(ret == -1, "UFFDIO_WRITEPROTECT failed: {}", get_error_msg());
+}
+
+// The faulting thread sleeps in the kernel until its page is unprotected, no signal is involved
+static void userfaultfd_thread(MemState &state) {
+    pollfd poll_fd = { userfaultfd_fd, POLLIN, 0 };
+    for (;;) {
+        if (poll(&poll_fd, 1, -1) == -1) {
+            if (errno == EINTR)
+                continue;
+            LOG_CRITICAL("userfaultfd poll failed: {}", get_error_msg());
+            return;
+        }
+
+        uffd_msg msg;
+        if (read(userfaultfd_fd, &msg, sizeof(msg)) != sizeof(msg) || msg.event != UFFD_EVENT_PAGEFAULT)
+            continue;
+
+        uint8_t *const addr = reinterpret_cast<uint8_t *>(msg.arg.pagefault.address);
+        uint8_t *const page = reinterpret_cast<uint8_t *>(align_down(reinterpret_cast<uintptr_t>(addr), state.page_size));
+        state.userfaultfd_fault_count++;
+        if (!handle_access_violation(state, addr, true)) {
+            LOG_CRITICAL("Unhandled write protect fault at {}", log_hex(reinterpret_cast<uintptr_t>(addr)));
+            userfaultfd_write_protect(page, state.page_size, false);
+        }
+
+        // Retry the write even if a callback kept the page protected, it will fault again
+        uffdio_range range = { reinterpret_cast<uintptr_t>(page), state.page_size };
+        ioctl(userfaultfd_fd, UFFDIO_WAKE, &range);
+    }
+}
+
+static bool init_userfaultfd(MemState &state) {
+    // Host syscalls write to guest buffers as well (file reads for example), their faults are only
+    // handled without UFFD_USER_MODE_ONLY. Omitting it needs vm.unprivileged_userfaultfd or CAP_SYS_PTRACE.
+    int fd = static_cast<int>(syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK));
+#ifdef UFFD_USER_MODE_ONLY
+    if (fd == -1 && errno == EPERM) {
+        fd = static_cast<int>(syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY));
+        // like with mprotect, a syscall writing to a protected page fails with EFAULT
+        LOG_WARN_IF(fd != -1, "userfaultfd can only handle faults of user code, host writes to write tracked guest memory will fail");
+    }
+#endif
+    if (fd == -1) {
+        LOG_WARN("userfaultfd is not available: {}", get_error_msg());
+        return false;
+    }
+
+    uffdio_api api = {};
+    api.api = UFFD_API;
+    api.features = UFFD_FEATURE_PAGEFAULT_FLAG_WP;
+    uffdio_register range = {};
+    range.range.start = reinterpret_cast<uintptr_t>(state.memory.get());
+    range.range.len = TOTAL_MEM_SIZE;
+    range.mode = UFFDIO_REGISTER_MODE_WP;
+    if (ioctl(fd, UFFDIO_API, &api) == -1 || ioctl(fd, UFFDIO_REGISTER, &range) == -1
+        || !(range.ioctls & (1ULL << _UFFDIO_WRITEPROTECT))) {
+        LOG_WARN("userfaultfd write protection is not supported: {}", get_error_msg());
+        close(fd);
+        return false;
+    }
+
+    userfaultfd_fd = fd;
+    // Lives as long as the process, like the access violation handler
+    std::thread(userfaultfd_thread, std::ref(state)).detach();
+    return true;
+}
+#endif
+
+bool init(MemState &state, const bool use_page_table, const WriteTracking write_tracking) {
 #ifdef WIN32
     SYSTEM_INFO system_info = {};
     GetSystemInfo(&system_info);
@@ -103,8 +204,12 @@ bool init(MemState &state, const bool use_page_table) {
     memset(state.alloc_table.get(), 0, sizeof(AllocMemPage) * table_length);
 
     state.allocator.set_maximum(table_length);
+    state.protect_pages = ProtectPageTable(new std::unique_ptr<ProtectPageInfo>[table_length]);
+    state.valid_pages = ValidPageTable(new std::atomic<uint8_t>[TOTAL_MEM_SIZE / KiB(4)]());
+    state.page_write_generations = WriteGenerationTable(new std::atomic<uint64_t>[table_length]());
 
     const auto handler = [&state](uint8_t *addr, bool write) noexcept {
+        state.access_violation_count++;
         return handle_access_violation(state, addr, write);
     };
     register_access_violation_handler(handler);
@@ -127,6 +232,28 @@ bool init(MemState &state, const bool use_page_table) {
         std::fill_n(state.page_table.get(), TOTAL_MEM_SIZE / KiB(4), state.memory.get());
     }
 
+    if (state.use_huge_pages) {
+#ifdef MADV_HUGEPAGE
+        if (reinterpret_cast<uintptr_t>(state.memory.get()) % HUGE_PAGE_SIZE != 0)
+            LOG_WARN("Guest memory is not aligned to huge pages, they will only be used partially");
+#else
+        LOG_WARN("Huge pages are not supported on this platform");
+        state.use_huge_pages = false;
+#endif
+    }
+
+    if (write_tracking == WriteTracking::Userfaultfd) {
+#ifdef HAS_USERFAULTFD_WP
+        // External mappings are outside of the registered range
+        if (use_page_table)
+            LOG_WARN("userfaultfd write tracking is not supported with a page table, using mprotect");
+        else if (init_userfaultfd(state))
+            state.write_tracking = WriteTracking::Userfaultfd;
+#else
+        LOG_WARN("userfaultfd write tracking is not supported on this platform, using mprotect");
+#endif
+    }
+
     return true;
 }
 
@@ -141,9 +268,15 @@ static void delete_memory(uint8_t *memory) {
     }
 }
 
+static void set_pages_valid(MemState &state, uint32_t page_num, uint32_t page_count, bool valid) {
+    const size_t first = static_cast<size_t>(page_num) * state.page_size / KiB(4);
+    const size_t count = static_cast<size_t>(page_count) * state.page_size / KiB(4);
+    for (size_t i = first; i < first + count; i++)
+        state.valid_pages[i].store(valid, std::memory_order_release);
+}
+
 bool is_valid_addr(const MemState &state, Address addr) {
-    const uint32_t page_num = addr / state.page_size;
-    return addr && state.allocator.free_slot_count(page_num, page_num + 1) == 0;
+    return addr && is_valid_page(state, addr);
 }
 
 bool is_valid_addr_range(const MemState &state, Address start, Address end) {
@@ -152,6 +285,47 @@ bool is_valid_addr_range(const MemState &state, Address start, Address end) {
     return state.allocator.free_slot_count(start_page, end_page) == 0;
 }
 
+static void decommit_pages(MemState &state, uint32_t page_num, uint32_t page_count) {
+    uint8_t *const memory = &state.memory[page_num * state.page_size];
+    const size_t size = static_cast<size_t>(page_count) * state.page_size;
+
+#ifdef WIN32
+    const BOOL ret = VirtualFree(memory, size, MEM_DECOMMIT);
+    LOG_CRITICAL_IF(!ret, "VirtualFree failed: {}", get_error_msg());
+#else
+    const int ret = mprotect(memory, size, PROT_NONE);
+    LOG_CRITICAL_IF(ret == -1, "mprotect failed: {}", get_error_msg());
+    if (state.use_huge_pages) {
+        // Give the memory back to the host, it reads as zero when allocated again
+        const int advise_ret = madvise(memory, size, MADV_DONTNEED);
+        LOG_CRITICAL_IF(advise_ret == -1, "madvise failed: {}", get_error_msg());
+    }
+#endif
+}
+
+// Make memory chunck available to access
+static void commit_pages(MemState &state, uint32_t page_num, uint32_t page_count) {
+    uint8_t *const memory = &state.memory[page_num * state.page_size];
+    const size_t size = static_cast<size_t>(page_count) * state.page_size;
+
+#ifdef WIN32
+    const void *const ret = VirtualAlloc(memory, size, MEM_COMMIT, PAGE_READWRITE);
+    LOG_CRITICAL_IF(!ret, "VirtualAlloc failed: {}", get_error_msg());
+#else
+    const int ret = mprotect(memory, size, PROT_READ | PROT_WRITE);
+    LOG_CRITICAL_IF(ret == -1, "mprotect failed: {}", get_error_msg());
+#ifdef HAS_USERFAULTFD_WP
+    // free doesn't discard the pages, they may still be write protected
+    if (state.write_tracking == WriteTracking::Userfaultfd)
+        userfaultfd_write_protect(memory, size, false);
+#endif
+#ifdef MADV_HUGEPAGE
+    if (state.use_huge_pages && size >= HUGE_PAGE_SIZE)
+        madvise(memory, size, MADV_HUGEPAGE);
+#endif
+#endif
+}
+
 static Address alloc_inner(MemState &state, uint32_t start_page, int page_count, const char *name, const bool force) {
     int page_num;
     if (force) {
@@ -169,23 +343,20 @@ static Address alloc_inner(MemState &state, uint32_t start_page, int page_count,
     const Address addr = page_num * state.page_size;
     uint8_t *const memory = &state.memory[addr];
 
-    // Make memory chunck available to access
-#ifdef WIN32
-    const void *const ret = VirtualAlloc(memory, size, MEM_COMMIT, PAGE_READWRITE);
-    LOG_CRITICAL_IF(!ret, "VirtualAlloc failed: {}", get_error_msg());
-#else
-    const int ret = mprotect(memory, size, PROT_READ | PROT_WRITE);
-    LOG_CRITICAL_IF(ret == -1, "mprotect failed: {}", get_error_msg());
-#endif
-    std::memset(memory, 0, size);
+    commit_pages(state, page_num, page_count);
+    // With huge pages, freed memory is discarded and the pages are only committed when first touched
+    if (!state.use_huge_pages)
+        std::memset(memory, 0, size);
+    set_pages_valid(state, page_num, page_count, true);
 
     AllocMemPage &page = state.alloc_table[page_num];
     assert(!page.allocated);
     page.allocated = 1;
     page.size = page_count;
 
-    if (PAGE_NAME_TRACKING) {
+    if (state.allocation_tracker.is_enabled()) {
         state.page_name_map.emplace(page_num, name);
+        state.allocation_tracker.record_alloc(addr, size, name, allocation_thread_id);
     }
 
     return addr;
@@ -207,20 +378,23 @@ Address alloc(MemState &state, uint32_t size, const char *name, unsigned int ali
         AllocMemPage &align_page = state.alloc_table[align_page_num];
         const uint32_t remnant_front = align_page_num - page_num;
         state.allocator.free(page_num, remnant_front);
+        set_pages_valid(state, page_num, remnant_front, false);
+        decommit_pages(state, page_num, remnant_front);
         page.allocated = 0;
         align_page.allocated = 1;
         align_page.size = page.size - remnant_front;
+
+        const auto name = state.page_name_map.find(page_num);
+        if (name != state.page_name_map.end()) {
+            state.page_name_map.emplace(align_page_num, std::move(name->second));
+            state.page_name_map.erase(name);
+        }
+        state.allocation_tracker.record_realign(addr, align_page_num * state.page_size, align_page.size * state.page_size);
     }
 
     return align_addr;
 }
 
-static void align_to_page(MemState &state, Address &addr, Address &size) {
-    const Address end = align(addr + size, state.page_size);
-    addr = align_down(addr, state.page_size);
-    size = end - addr;
-}
-
 void unprotect_inner(MemState &state, Address addr, uint32_t size) {
     if (LOG_PROTECT) {
         fmt::print("Unprotect: {} {}\n", log_hex(addr), size);
@@ -234,6 +408,10 @@ void unprotect_inner(MemState &state, Address addr, uint32_t size) {
 #else
     const int ret = mprotect(&addr_ptr[addr], size, PROT_READ | PROT_WRITE);
     LOG_CRITICAL_IF(ret == -1, "mprotect failed: {}", get_error_msg());
+#ifdef HAS_USERFAULTFD_WP
+    if (state.write_tracking == WriteTracking::Userfaultfd)
+        userfaultfd_write_protect(&addr_ptr[addr], size, false);
+#endif
 #endif
 }
 
@@ -245,20 +423,133 @@ void protect_inner(MemState &state, Address addr, uint32_t size, const MemPerm p
     const BOOL ret = VirtualProtect(&addr_ptr[addr], size - 1, (perm == MemPerm::None) ? PAGE_NOACCESS : ((perm == MemPerm::ReadOnly) ? PAGE_READONLY : PAGE_READWRITE), &old_protect);
     LOG_CRITICAL_IF(!ret, "VirtualAlloc failed: {}", get_error_msg());
 #else
+#ifdef HAS_USERFAULTFD_WP
+    if (state.write_tracking == WriteTracking::Userfaultfd && perm == MemPerm::ReadOnly) {
+        // the page must be writable for the write to reach userfaultfd
+        const int ret = mprotect(&addr_ptr[addr], size, PROT_READ | PROT_WRITE);
+        LOG_CRITICAL_IF(ret == -1, "mprotect failed: {}", get_error_msg());
+        userfaultfd_write_protect(&addr_ptr[addr], size, true);
+        return;
+    }
+#endif
     const int ret = mprotect(&addr_ptr[addr], size, (perm == MemPerm::None) ? PROT_NONE : ((perm == MemPerm::ReadOnly) ? PROT_READ : (PROT_READ | PROT_WRITE)));
     LOG_CRITICAL_IF(ret == -1, "mprotect failed: {}", get_error_msg());
 #endif
 }
 
+// Locks the stripes of the pages [first_page, end_page), always in the same order so that two ranges can't deadlock
+class ProtectRangeLock {
+    MemState &state;
+    std::bitset<PROTECT_STRIPE_COUNT> stripes;
+
+public:
+    ProtectRangeLock(MemState &state, uint32_t first_page, uint32_t end_page)
+        : state(state) {
+        if (end_page - first_page >= PROTECT_STRIPE_COUNT) {
+            stripes.set();
+        } else {
+            for (uint32_t page = first_page; page < end_page; page++)
+                stripes.set(page % PROTECT_STRIPE_COUNT);
+        }
+
+        for (size_t i = 0; i < PROTECT_STRIPE_COUNT; i++) {
+            if (stripes.test(i))
+                state.protect_stripes[i].mutex.lock();
+        }
+    }
+
+    ~ProtectRangeLock() {
+        for (size_t i = 0; i < PROTECT_STRIPE_COUNT; i++) {
+            if (stripes.test(i))
+                state.protect_stripes[i].mutex.unlock();
+        }
+    }
+};
+
+static void get_protect_page_range(const MemState &state, Address addr, uint32_t size, uint32_t &first_page, uint32_t &end_page) {
+    first_page = addr / state.page_size;
+    end_page = static_cast<uint32_t>((static_cast<uint64_t>(addr) + std::max<uint32_t>(size, 1) + state.page_size - 1) / state.page_size);
+}
+
+static void remove_dead_blocks(ProtectPageInfo &info) {
+    std::erase_if(info.blocks, [](const ProtectBlockPtr &block) { return block->removed.load(); });
+
+    // the most restrictive permission of the blocks wins
+    uint32_t perm = static_cast<uint32_t>(MemPerm::ReadWrite);
+    for (const ProtectBlockPtr &block : info.blocks)
+        perm &= static_cast<uint32_t>(block->perm);
+    info.perm = static_cast<MemPerm>(perm);
+}
+
+// Makes the host protection of the pages [first_page, end_page) match their protect info. The stripes must be locked.
+static void update_page_protection(MemState &state, uint32_t first_page, uint32_t end_page) {
+    enum class Action {
+        Keep,
+        Unprotect,
+        Protect,
+    };
+
+    Action run_action = Action::Keep;
+    MemPerm run_perm = MemPerm::None;
+    uint32_t run_start = first_page;
+
+    const auto flush_run = [&](uint32_t run_end) {
+        const Address addr = run_start * state.page_size;
+        const uint32_t size = (run_end - run_start) * state.page_size;
+        if (run_action == Action::Unprotect)
+            unprotect_inner(state, addr, size);
+        else if (run_action == Action::Protect)
+            protect_inner(state, addr, size, run_perm);
+    };
+
+    for (uint32_t page = first_page; page < end_page; page++) {
+        std::unique_ptr<ProtectPageInfo> &info = state.protect_pages[page];
+
+        Action action = Action::Unprotect;
+        MemPerm perm = MemPerm::None;
+        if (info && info->ref_count > 0) {
+            action = Action::Keep;
+        } else if (info && !info->blocks.empty()) {
+            action = Action::Protect;
+            perm = info->perm;
+        } else {
+            info.reset();
+        }
+
+        if (action != run_action || perm != run_perm) {
+            flush_run(page);
+            run_action = action;
+            run_perm = perm;
+            run_start = page;
+        }
+    }
+
+    flush_run(end_page);
+}
+
+// Drops a block which has been hit from all the pages it covers
+static void remove_protect_block(MemState &state, const ProtectBlockInfo &block) {
+    uint32_t first_page, end_page;
+    get_protect_page_range(state, block.addr, block.size, first_page, end_page);
+
+    const ProtectRangeLock lock(state, first_page, end_page);
+    for (uint32_t page = first_page; page < end_page; page++) {
+        if (state.protect_pages[page])
+            remove_dead_blocks(*state.protect_pages[page]);
+    }
+
+    update_page_protection(state, first_page, end_page);
+}
+
 bool handle_access_violation(MemState &state, uint8_t *addr, bool write) noexcept {
     const uintptr_t memory_addr = reinterpret_cast<uintptr_t>(state.memory.get());
     const uintptr_t fault_addr = reinterpret_cast<uintptr_t>(addr);
 
     Address vaddr = 0;
-    const std::unique_lock<std::mutex> lock(state.protect_mutex);
     if (fault_addr < memory_addr || fault_addr >= memory_addr + TOTAL_MEM_SIZE) {
         if (state.use_page_table) {
             // this may come from an external mapping
+            const std::lock_guard<std::mutex> lock(state.external_mapping_mutex);
             uint64_t addr_val = std::bit_cast<uint64_t>(addr);
             auto it = state.external_mapping.lower_bound(addr_val);
             if (it != state.external_mapping.end() && addr_val < it->first + it->second.size) {
@@ -280,148 +571,180 @@ bool handle_access_violation(MemState &state, uint8_t *addr, bool write) noexcep
         fmt::print("Access: {}\n", log_hex(vaddr));
     }
 
-    auto it = state.protect_tree.lower_bound(vaddr);
-    if (it == state.protect_tree.end()) {
-        // HACK: keep going
-        unprotect_inner(state, vaddr, 4);
-        LOG_CRITICAL("Unhandled write protected region was valid. Address=0x{:X}", vaddr);
-        return true;
-    }
+    const uint32_t page = vaddr / state.page_size;
+    std::vector<ProtectBlockPtr> hit_blocks;
+    {
+        const std::lock_guard<std::mutex> lock(state.protect_stripes[page % PROTECT_STRIPE_COUNT].mutex);
+        ProtectPageInfo *info = state.protect_pages[page].get();
+        if (!info || info->blocks.empty()) {
+            // HACK: keep going
+            unprotect_inner(state, vaddr, 4);
+            LOG_CRITICAL("Unhandled write protected region was valid. Address=0x{:X}", vaddr);
+            return true;
+        }
 
-    ProtectSegmentInfo &info = it->second;
-    if (vaddr < it->first || vaddr >= it->first + info.size) {
-        // HACK: keep going
-        unprotect_inner(state, vaddr, 4);
-        LOG_CRITICAL("Unhandled write protected region was valid. Address=0x{:X}", vaddr);
-        return true;
+        // The whole page is protected, so the fault belongs to all its blocks.
+        // A block already removed by a fault on another page may not have been unprotected yet, finish the job.
+        for (const ProtectBlockPtr &block : info->blocks) {
+            const std::lock_guard<std::mutex> block_lock(block->callback_mutex);
+            if (block->removed || block->callback(vaddr, write)) {
+                block->removed = true;
+                hit_blocks.push_back(block);
+            }
+        }
     }
 
-    Address previous_beg = it->first;
-    for (auto ite = info.blocks.begin(); ite != info.blocks.end();) {
-        if (vaddr >= ite->first && vaddr < ite->first + ite->second.size && ite->second.callback(vaddr, write)) {
-            Address beg_unpr = align_down(ite->first, state.page_size);
-            Address end_unpr = align(ite->first + ite->second.size, state.page_size);
-            unprotect_inner(state, beg_unpr, end_unpr - beg_unpr);
+    // Can't be done with the page locked, the blocks may cover pages of other stripes
+    for (const ProtectBlockPtr &block : hit_blocks)
+        remove_protect_block(state, *block);
 
-            ite = info.blocks.erase(ite);
-        } else {
-            ite++;
-        }
+    return true;
+}
+
+// Adds the block to the pages it covers, the stripes must be locked and the host protection updated after
+static ProtectBlockPtr insert_protect_block(MemState &state, Address addr, const uint32_t size, const MemPerm perm, ProtectCallback callback) {
+    const ProtectBlockPtr block = std::make_shared<ProtectBlockInfo>();
+    block->addr = addr;
+    block->size = size;
+    block->perm = (perm == MemPerm::WriteOnly) ? MemPerm::ReadWrite : perm;
+    block->callback = std::move(callback);
+
+    uint32_t first_page, end_page;
+    get_protect_page_range(state, addr, size, first_page, end_page);
+    for (uint32_t page = first_page; page < end_page; page++) {
+        std::unique_ptr<ProtectPageInfo> &info = state.protect_pages[page];
+        if (!info)
+            info = std::make_unique<ProtectPageInfo>();
+
+        info->blocks.push_back(block);
+        remove_dead_blocks(*info);
     }
 
-    if (info.blocks.size() == 0 && info.ref_count == 0) {
-        unprotect_inner(state, it->first, info.size);
-        state.protect_tree.erase(it);
-    } else {
-        Address beg_region = info.blocks.begin()->first;
-        Address end_region = info.blocks.rbegin()->first + info.blocks.rbegin()->second.size;
+    return block;
+}
 
-        beg_region = align_down(beg_region, state.page_size);
-        end_region = align(end_region, state.page_size);
+ProtectBlockPtr add_protect(MemState &state, Address addr, const uint32_t size, const MemPerm perm, ProtectCallback callback) {
+    uint32_t first_page, end_page;
+    get_protect_page_range(state, addr, size, first_page, end_page);
 
-        if (beg_region != previous_beg) {
-            ProtectSegmentInfo new_info = std::move(info);
-            new_info.size = end_region - beg_region;
+    const ProtectRangeLock lock(state, first_page, end_page);
+    ProtectBlockPtr block = insert_protect_block(state, addr, size, perm, std::move(callback));
+    update_page_protection(state, first_page, end_page);
+    return block;
+}
 
-            state.protect_tree.erase(it);
-            state.protect_tree.emplace(beg_region, std::move(new_info));
-        } else {
-            info.size = end_region - beg_region;
-        }
+void remove_protect(MemState &state, const ProtectBlockPtr &block) {
+    {
+        // the callback may be running on another thread, it won't be called once the block is removed
+        const std::lock_guard<std::mutex> lock(block->callback_mutex);
+        block->removed = true;
     }
-
-    return true;
+    remove_protect_block(state, *block);
 }
 
-bool add_protect(MemState &state, Address addr, const uint32_t size, const MemPerm perm, ProtectCallback callback) {
-    const std::lock_guard<std::mutex> lock(state.protect_mutex);
-    ProtectSegmentInfo protect(size, perm);
-    align_to_page(state, addr, protect.size);
-
-    ProtectBlockInfo block;
-    block.size = size;
-    block.callback = callback;
+bool is_protecting(MemState &state, Address addr, MemPerm *perm) {
+    const uint32_t page = addr / state.page_size;
+    const std::lock_guard<std::mutex> lock(state.protect_stripes[page % PROTECT_STRIPE_COUNT].mutex);
+    const ProtectPageInfo *info = state.protect_pages[page].get();
 
-    protect.blocks.emplace(addr, std::move(block));
+    if (info && !info->blocks.empty()) {
+        if (perm)
+            *perm = info->perm;
 
-    auto it = state.protect_tree.lower_bound(addr);
-    if (it == state.protect_tree.end() || it->first + it->second.size <= addr) {
-        if (it == state.protect_tree.begin())
-            it = state.protect_tree.end();
-        else
-            it--;
+        return true;
     }
 
-    while (it != state.protect_tree.end() && it->first < addr + size) {
-        const Address start = std::min(it->first, addr);
-        protect.size = std::max(it->first + it->second.size, addr + protect.size) - start;
-        addr = start;
-        protect.ref_count += it->second.ref_count; // Transfer access count to new block
-        protect.blocks.merge(it->second.blocks); // transfer blocks to the new protect
+    return false;
+}
 
-        if (it == state.protect_tree.begin()) {
-            state.protect_tree.erase(it);
-            break;
-        }
+// Gives the pages a new generation and stops watching them
+static void mark_pages_written(MemState &state, uint32_t first_page, uint32_t end_page) {
+    const uint64_t generation = ++state.write_generation;
+    for (uint32_t page = first_page; page < end_page; page++)
+        state.page_write_generations[page].store(generation << 1, std::memory_order_release);
+}
 
-        // protect tree is in reverse order, so decrease it
-        state.protect_tree.erase(it--);
-    }
+uint64_t snapshot_write_generation(MemState &state, Address addr, uint32_t size) {
+    uint32_t first_page, end_page;
+    get_protect_page_range(state, addr, size, first_page, end_page);
+
+    // The pages are protected and marked as watched with their stripes locked, the fault of a write
+    // can't be handled in between. This also keeps another snapshot of the same pages waiting.
+    const ProtectRangeLock lock(state, first_page, end_page);
+    const uint64_t generation = state.write_generation;
+
+    // Each run of pages which are not watched yet is protected with a single block.
+    // The whole block is unprotected by the first write, so it marks all its pages as written.
+    uint32_t run_start = first_page;
+    for (uint32_t page = first_page; page <= end_page; page++) {
+        bool opened = false;
+        if (page < end_page) {
+            const ProtectPageInfo *info = state.protect_pages[page].get();
+            opened = info && info->ref_count > 0;
+            if (!opened && !(state.page_write_generations[page].load(std::memory_order_acquire) & 1))
+                continue;
+        }
 
-    if (protect.ref_count == 0) {
-        protect_inner(state, addr, protect.size, perm);
+        if (run_start < page) {
+            insert_protect_block(state, run_start * state.page_size, (page - run_start) * state.page_size, MemPerm::ReadOnly, [&state, run_start, page](Address, bool) {
+                mark_pages_written(state, run_start, page);
+                return true;
+            });
+            for (uint32_t watched = run_start; watched < page; watched++)
+                state.page_write_generations[watched].fetch_or(1);
+        }
+        // The host protection of an opened page is off, it can be written anytime
+        if (opened)
+            mark_pages_written(state, page, page + 1);
+        run_start = page + 1;
     }
 
-    state.protect_tree.emplace(addr, std::move(protect));
-    return true;
+    update_page_protection(state, first_page, end_page);
+    return generation;
 }
 
-bool is_protecting(MemState &state, Address addr, MemPerm *perm) {
-    const std::lock_guard<std::mutex> lock(state.protect_mutex);
-    auto ite = state.protect_tree.lower_bound(addr);
+bool pages_changed_since(const MemState &state, Address addr, uint32_t size, uint64_t generation) {
+    uint32_t first_page, end_page;
+    get_protect_page_range(state, addr, size, first_page, end_page);
 
-    if (ite != state.protect_tree.end() && addr < ite->first + ite->second.size) {
-        if (perm)
-            *perm = ite->second.perm;
-
-        return true;
+    for (uint32_t page = first_page; page < end_page; page++) {
+        if ((state.page_write_generations[page].load(std::memory_order_acquire) >> 1) > generation)
+            return true;
     }
 
     return false;
 }
 
-void open_access_parent_protect_segment(MemState &state, Address addr) {
-    const std::lock_guard<std::mutex> lock(state.protect_mutex);
-    auto ite = state.protect_tree.lower_bound(addr);
+void open_access_parent_protect_segment(MemState &state, Address addr, uint32_t size) {
+    uint32_t first_page, end_page;
+    get_protect_page_range(state, addr, size, first_page, end_page);
 
-    if (ite != state.protect_tree.end() && addr < ite->first + ite->second.size) {
-        ite->second.ref_count++;
-    } else {
-        ProtectSegmentInfo protect(0, MemPerm::ReadWrite);
-        protect.ref_count = 1;
+    const ProtectRangeLock lock(state, first_page, end_page);
+    for (uint32_t page = first_page; page < end_page; page++) {
+        std::unique_ptr<ProtectPageInfo> &info = state.protect_pages[page];
+        if (!info)
+            info = std::make_unique<ProtectPageInfo>();
 
-        state.protect_tree.emplace(align_down(addr, state.page_size), std::move(protect));
+        info->ref_count++;
     }
-}
 
-void close_access_parent_protect_segment(MemState &state, Address addr) {
-    const std::lock_guard<std::mutex> lock(state.protect_mutex);
-    auto ite = state.protect_tree.lower_bound(addr);
+    // The caller removes the host protection to write without faults, the watched pages won't see it
+    mark_pages_written(state, first_page, end_page);
+}
 
-    if (ite != state.protect_tree.end()) {
-        ProtectSegmentInfo &info = ite->second;
-        if (info.ref_count > 0) {
-            info.ref_count--;
-        }
+void close_access_parent_protect_segment(MemState &state, Address addr, uint32_t size) {
+    uint32_t first_page, end_page;
+    get_protect_page_range(state, addr, size, first_page, end_page);
 
-        if (info.ref_count == 0) {
-            if (info.blocks.size() == 0 || info.size == 0) {
-                state.protect_tree.erase(ite);
-            } else {
-                protect_inner(state, ite->first, info.size, info.perm);
-            }
-        }
+    const ProtectRangeLock lock(state, first_page, end_page);
+    for (uint32_t page = first_page; page < end_page; page++) {
+        ProtectPageInfo *info = state.protect_pages[page].get();
+        if (info && info->ref_count > 0)
+            info->ref_count--;
     }
+
+    mark_pages_written(state, first_page, end_page);
+    update_page_protection(state, first_page, end_page);
 }
 
 void add_external_mapping(MemState &mem, Address addr, uint32_t size, uint8_t *addr_ptr) {
@@ -441,7 +764,7 @@ void add_external_mapping(MemState &mem, Address addr, uint32_t size, uint8_t *a
     protect_inner(mem, addr, size, MemPerm::None);
     mem.page_table[addr / KiB(4)] = page_table_entry;
 
-    const std::unique_lock<std::mutex> lock(mem.protect_mutex);
+    const std::unique_lock<std::mutex> lock(mem.external_mapping_mutex);
     mem.external_mapping[addr_value] = { addr, size };
 }
 
@@ -449,7 +772,7 @@ void remove_external_mapping(MemState &mem, uint8_t *addr_ptr) {
     uint64_t addr_value = std::bit_cast<uint64_t>(addr_ptr);
     MemExternalMapping mapping;
     {
-        const std::unique_lock<std::mutex> lock(mem.protect_mutex);
+        const std::unique_lock<std::mutex> lock(mem.external_mapping_mutex);
         auto it = mem.external_mapping.find(addr_value);
         assert(it != mem.external_mapping.end());
 
@@ -460,23 +783,13 @@ void remove_external_mapping(MemState &mem, uint8_t *addr_ptr) {
     // remove all protections on this range
     unprotect_inner(mem, mapping.address, mapping.size);
     {
-        const std::unique_lock<std::mutex> lock(mem.protect_mutex);
-        auto prot_it = mem.protect_tree.lower_bound(mapping.address);
-        if (prot_it->first + prot_it->second.size <= mapping.address) {
-            if (prot_it == mem.protect_tree.begin())
-                prot_it = mem.protect_tree.end();
-            else
-                prot_it--;
-        }
-
-        while (prot_it != mem.protect_tree.end() && prot_it->first < mapping.address + mapping.size) {
-            if (prot_it == mem.protect_tree.begin()) {
-                mem.protect_tree.erase(prot_it);
-                break;
-            }
+        uint32_t first_page, end_page;
+        get_protect_page_range(mem, mapping.address, mapping.size, first_page, end_page);
 
-            mem.protect_tree.erase(prot_it--);
-        }
+        const ProtectRangeLock lock(mem, first_page, end_page);
+        for (uint32_t page = first_page; page < end_page; page++)
+            mem.protect_pages[page].reset();
+        mark_pages_written(mem, first_page, end_page);
     }
 
     // unprotect the original memory range
@@ -490,9 +803,27 @@ void remove_external_mapping(MemState &mem, uint8_t *addr_ptr) {
     }
 }
 
+// Big allocations start on a huge page boundary, so that the host can back them with huge pages
+static Address alloc_huge_page_aligned(MemState &state, uint32_t page_count, const char *name) {
+    const uint32_t huge_page_count = HUGE_PAGE_SIZE / state.page_size;
+    int search_count = page_count + huge_page_count - 1;
+    const int page_num = state.allocator.allocate_from(0, search_count, false);
+    if (page_num < 0)
+        return 0;
+
+    state.allocator.free(page_num, search_count);
+    return alloc_inner(state, align(page_num, huge_page_count), page_count, name, true);
+}
+
 Address alloc(MemState &state, uint32_t size, const char *name) {
     const std::lock_guard<std::mutex> lock(state.generation_mutex);
     const uint32_t page_count = align(size, state.page_size) / state.page_size;
+    if (state.use_huge_pages && size >= HUGE_PAGE_SIZE) {
+        const Address addr = alloc_huge_page_aligned(state, page_count, name);
+        if (addr)
+            return addr;
+    }
+
     const Address addr = alloc_inner(state, 0, page_count, name, false);
     return addr;
 }
@@ -535,21 +866,237 @@ void free(MemState &state, Address address) {
     }
     page.allocated = 0;
 
+    // invalid before being decommitted, so that the slow path doesn't access it
+    set_pages_valid(state, page_num, page.size, false);
+    // the pages will be unprotected when allocated again, the caches watching them can't trust them anymore
+    mark_pages_written(state, page_num, page_num + page.size);
     state.allocator.free(page_num, page.size);
-    if (PAGE_NAME_TRACKING) {
-        state.page_name_map.erase(page_num);
-    }
+    state.page_name_map.erase(page_num);
+    state.allocation_tracker.record_free(page_num * state.page_size, allocation_thread_id);
 
     assert(!state.use_page_table || state.page_table[address / KiB(4)] == state.memory.get());
-    uint8_t *const memory = &state.memory[page_num * state.page_size];
+    decommit_pages(state, page_num, page.size);
+}
 
-#ifdef WIN32
-    const BOOL ret = VirtualFree(memory, page.size * state.page_size, MEM_DECOMMIT);
-    LOG_CRITICAL_IF(!ret, "VirtualFree failed: {}", get_error_msg());
+static uint64_t hash_page(const uint8_t *page, uint32_t page_size) {
+    const uint64_t hash = XXH_INLINE_XXH3_64bits(page, page_size);
+    // 0 means unknown
+    return hash ? hash : 1;
+}
+
+MemSnapshotPtr take_snapshot(MemState &state) {
+    const std::lock_guard<std::mutex> lock(state.generation_mutex);
+    const uint32_t page_count = static_cast<uint32_t>(state.allocator.max_offset);
+    std::vector<uint64_t> &hashes = state.snapshot_page_hashes;
+    if (hashes.empty())
+        hashes.resize(page_count, 0);
+
+    const auto snapshot = std::make_shared<MemSnapshot>();
+    snapshot->parent = state.last_snapshot;
+    snapshot->allocator_words = state.allocator.words;
+    snapshot->page_names = state.page_name_map;
+
+    // the null page is never accessible, it is allocated but not stored
+    std::vector<uint32_t> allocated_pages;
+    for (uint32_t page = 0; page < page_count;) {
+        const AllocMemPage &allocation = state.alloc_table[page];
+        if (!allocation.allocated) {
+            hashes[page++] = 0;
+            continue;
+        }
+
+        snapshot->allocations.emplace_back(page, allocation);
+        snapshot->allocated_size += static_cast<uint64_t>(allocation.size) * state.page_size;
+        for (const uint32_t end_page = page + allocation.size; page < end_page; page++) {
+            if (page != 0)
+                allocated_pages.push_back(page);
+        }
+    }
+
+    // Hashing is bound by the memory bandwidth, split it between the host cores when there is a lot of memory
+    constexpr size_t MIN_PAGES_PER_WORKER = MiB(16) / STANDARD_PAGE_SIZE;
+    const size_t worker_count = std::clamp<size_t>(allocated_pages.size() / MIN_PAGES_PER_WORKER, 1, std::max(std::thread::hardware_concurrency(), 1u));
+    const size_t pages_per_worker = (allocated_pages.size() + worker_count - 1) / worker_count;
+    std::vector<std::vector<uint32_t>> changed_pages(worker_count);
+    const auto hash_pages = [&](size_t worker) {
+        const size_t end = std::min(allocated_pages.size(), (worker + 1) * pages_per_worker);
+        for (size_t i = worker * pages_per_worker; i < end; i++) {
+            const uint32_t page = allocated_pages[i];
+            const uint64_t hash = hash_page(&state.memory[static_cast<size_t>(page) * state.page_size], state.page_size);
+            if (hash != hashes[page]) {
+                hashes[page] = hash;
+                changed_pages[worker].push_back(page);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t worker = 1; worker < worker_count; worker++)
+        workers.emplace_back(hash_pages, worker);
+    hash_pages(0);
+    for (std::thread &worker : workers)
+        worker.join();
+
+    for (const std::vector<uint32_t> &pages : changed_pages)
+        snapshot->pages.insert(snapshot->pages.end(), pages.begin(), pages.end());
+    snapshot->data.resize(snapshot->pages.size() * state.page_size);
+    for (size_t i = 0; i < snapshot->pages.size(); i++)
+        std::memcpy(&snapshot->data[i * state.page_size], &state.memory[static_cast<size_t>(snapshot->pages[i]) * state.page_size], state.page_size);
+
+    state.last_snapshot = snapshot;
+    return snapshot;
+}
+
+void restore_snapshot(MemState &state, const MemSnapshotPtr &snapshot) {
+    const std::lock_guard<std::mutex> lock(state.generation_mutex);
+    const uint32_t page_count = static_cast<uint32_t>(state.allocator.max_offset);
+    std::vector<uint64_t> &hashes = state.snapshot_page_hashes;
+    if (hashes.empty())
+        hashes.resize(page_count, 0);
+
+    // the newest content of each page along the chain
+    std::vector<const uint8_t *> contents(page_count, nullptr);
+    for (const MemSnapshot *current = snapshot.get(); current; current = current->parent.get()) {
+        for (size_t i = 0; i < current->pages.size(); i++) {
+            if (!contents[current->pages[i]])
+                contents[current->pages[i]] = &current->data[i * state.page_size];
+        }
+    }
+
+    std::vector<bool> was_allocated(page_count, false);
+    for (uint32_t page = 0; page < page_count;) {
+        const AllocMemPage &allocation = state.alloc_table[page];
+        if (!allocation.allocated) {
+            page++;
+            continue;
+        }
+        std::fill_n(was_allocated.begin() + page, allocation.size, true);
+        page += allocation.size;
+    }
+
+    std::vector<bool> allocated(page_count, false);
+    std::fill_n(state.alloc_table.get(), page_count, AllocMemPage{});
+    for (const auto &[page, allocation] : snapshot->allocations) {
+        state.alloc_table[page] = allocation;
+        std::fill_n(allocated.begin() + page, allocation.size, true);
+    }
+    state.allocator.words = snapshot->allocator_words;
+    state.allocator.rebuild_summary();
+    state.page_name_map = snapshot->page_names;
+
+    // free and allocate the pages the same way free and alloc do, by runs
+    for (uint32_t page = 0; page < page_count;) {
+        uint32_t end_page = page + 1;
+        while (end_page < page_count && allocated[end_page] == allocated[page] && was_allocated[end_page] == was_allocated[page])
+            end_page++;
+
+        if (was_allocated[page] && !allocated[page]) {
+            set_pages_valid(state, page, end_page - page, false);
+            mark_pages_written(state, page, end_page);
+            decommit_pages(state, page, end_page - page);
+        } else if (!was_allocated[page] && allocated[page]) {
+            commit_pages(state, page, end_page - page);
+            set_pages_valid(state, page, end_page - page, true);
+        }
+        page = end_page;
+    }
+
+    for (uint32_t page = 1; page < page_count; page++) {
+        if (!allocated[page]) {
+            hashes[page] = 0;
+            continue;
+        }
+
+        assert(contents[page]);
+        uint8_t *const memory = &state.memory[static_cast<size_t>(page) * state.page_size];
+        if (std::memcmp(memory, contents[page], state.page_size) != 0)
+            std::memcpy(memory, contents[page], state.page_size);
+        hashes[page] = hash_page(contents[page], state.page_size);
+    }
+
+    state.last_snapshot = snapshot;
+}
+
+void reset_snapshots(MemState &state) {
+    const std::lock_guard<std::mutex> lock(state.generation_mutex);
+    state.snapshot_page_hashes.clear();
+    state.snapshot_page_hashes.shrink_to_fit();
+    state.last_snapshot.reset();
+}
+
+MemResidency get_residency(MemState &state) {
+    MemResidency residency;
+
+    // Runs of allocated pages, only those are checked
+    std::vector<std::pair<uint32_t, uint32_t>> runs;
+    {
+        const std::lock_guard<std::mutex> lock(state.generation_mutex);
+        const BitmapAllocator &allocator = state.allocator;
+        residency.allocated = static_cast<uint64_t>(allocator.max_offset - allocator.free_slot_count(0, allocator.max_offset)) * state.page_size;
+
+        uint32_t run_start = 0;
+        bool in_run = false;
+        for (uint32_t page = 0; page < allocator.max_offset; page++) {
+            // whole words of free slots are skipped at once
+            if (!in_run && (page & 31) == 0 && allocator.words[page >> 5] == UINT32_MAX && page + 32 <= allocator.max_offset) {
+                page += 31;
+                continue;
+            }
+
+            const bool allocated = !allocator.is_free(page);
+            if (allocated && !in_run)
+                run_start = page;
+            else if (!allocated && in_run)
+                runs.emplace_back(run_start, page);
+            in_run = allocated;
+        }
+        if (in_run)
+            runs.emplace_back(run_start, static_cast<uint32_t>(allocator.max_offset));
+    }
+
+#ifndef WIN32
+    const size_t host_page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    constexpr size_t CHUNK_SIZE = MiB(256);
+#ifdef __APPLE__
+    std::vector<char> pages(CHUNK_SIZE / host_page_size);
 #else
-    const int ret = mprotect(memory, page.size * state.page_size, PROT_NONE);
-    LOG_CRITICAL_IF(ret == -1, "mprotect failed: {}", get_error_msg());
+    std::vector<unsigned char> pages(CHUNK_SIZE / host_page_size);
 #endif
+    // guest pages may be smaller than the host ones, a host page shared by two runs is only counted once
+    size_t checked_end = 0;
+    for (const auto &[first_page, end_page] : runs) {
+        const size_t begin = std::max(align_down(static_cast<size_t>(first_page) * state.page_size, host_page_size), checked_end);
+        const size_t end = align(static_cast<size_t>(end_page) * state.page_size, host_page_size);
+        for (size_t offset = begin; offset < end; offset += CHUNK_SIZE) {
+            const size_t size = std::min(CHUNK_SIZE, end - offset);
+            if (mincore(state.memory.get() + offset, size, pages.data()) == -1)
+                return residency;
+            for (size_t page = 0; page < size / host_page_size; page++)
+                residency.resident += (pages[page] & 1) ? host_page_size : 0;
+        }
+        checked_end = std::max(checked_end, end);
+    }
+    residency.resident_available = true;
+
+#ifdef __linux__
+    // The guest memory is split in many mappings by the protections, sum the ones inside of it
+    const uintptr_t memory_begin = reinterpret_cast<uintptr_t>(state.memory.get());
+    const uintptr_t memory_end = memory_begin + TOTAL_MEM_SIZE;
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    bool in_memory = false;
+    while (std::getline(smaps, line)) {
+        uintptr_t begin = 0, end = 0;
+        if (std::sscanf(line.c_str(), "%" SCNxPTR "-%" SCNxPTR " ", &begin, &end) == 2) {
+            in_memory = begin >= memory_begin && end <= memory_end;
+        } else if (in_memory && line.starts_with("AnonHugePages:")) {
+            residency.huge_pages += std::strtoull(line.c_str() + strlen("AnonHugePages:"), nullptr, 10) * KiB(1);
+        }
+    }
+#endif
+#endif
+
+    return residency;
 }
 
 uint32_t mem_available(MemState &state) {
@@ -557,10 +1104,12 @@ uint32_t mem_available(MemState &state) {
 }
 
 const char *mem_name(Address address, MemState &state) {
-    if (PAGE_NAME_TRACKING) {
-        return state.page_name_map.find(address / state.page_size)->second.c_str();
-    }
-    return "";
+    const auto name = state.page_name_map.find(address / state.page_size);
+    return name != state.page_name_map.end() ? name->second.c_str() : "";
+}
+
+void set_allocation_thread_id(int32_t thread_id) {
+    allocation_thread_id = thread_id;
 }
 
 #ifdef WIN32
@@ -0,0 +1,100 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <mem/allocation_tracker.h>
+
+#include <gtest/gtest.h>
+
+TEST(allocation_tracker, category_is_the_name_before_the_detail) {
+    ASSERT_EQ(AllocationTracker::get_category("Thread stack: main (#1)"), "Thread stack");
+    ASSERT_EQ(AllocationTracker::get_category("Module segment: app0:eboot.bin:seg0"), "Module segment");
+    ASSERT_EQ(AllocationTracker::get_category("SceGxmNotificationRegion"), "SceGxmNotificationRegion");
+}
+
+TEST(allocation_tracker, disabled_records_nothing) {
+    AllocationTracker tracker;
+    tracker.record_alloc(0x81000000, KiB(4), "heap", 1);
+    ASSERT_EQ(tracker.get_current_size(), 0);
+    ASSERT_TRUE(tracker.get_events().empty());
+}
+
+TEST(allocation_tracker, aggregates_by_category) {
+    AllocationTracker tracker;
+    tracker.set_enabled(true);
+    tracker.record_alloc(0x81000000, KiB(64), "Thread stack: main (#1)", 1);
+    tracker.record_alloc(0x81010000, KiB(64), "Thread stack: worker (#2)", 1);
+    tracker.record_alloc(0x81020000, MiB(1), "heap", 2);
+    tracker.record_free(0x81000000, 1);
+    // never tracked
+    tracker.record_free(0x82000000, 1);
+
+    ASSERT_EQ(tracker.get_current_size(), KiB(64) + MiB(1));
+    ASSERT_EQ(tracker.get_peak_size(), KiB(128) + MiB(1));
+
+    const auto stats = tracker.get_category_stats();
+    ASSERT_EQ(stats.size(), 2);
+    ASSERT_EQ(stats[0].name, "Thread stack");
+    ASSERT_EQ(stats[0].live_count, 1);
+    ASSERT_EQ(stats[0].current_size, KiB(64));
+    ASSERT_EQ(stats[0].peak_size, KiB(128));
+    ASSERT_EQ(stats[0].alloc_count, 2);
+    ASSERT_EQ(stats[0].free_count, 1);
+    ASSERT_EQ(stats[0].size_histogram[AllocationTracker::get_size_bucket(KiB(64))], 2);
+    ASSERT_EQ(stats[1].name, "heap");
+
+    const auto events = tracker.get_events();
+    ASSERT_EQ(events.size(), 4);
+    ASSERT_TRUE(events.back().is_free);
+    ASSERT_EQ(events.back().thread_id, 1);
+}
+
+TEST(allocation_tracker, ring_keeps_the_last_events) {
+    AllocationTracker tracker(4);
+    tracker.set_enabled(true);
+    for (Address i = 0; i < 10; i++)
+        tracker.record_alloc(0x81000000 + i * KiB(4), KiB(4), "heap", 0);
+
+    const auto events = tracker.get_events();
+    ASSERT_EQ(events.size(), 4);
+    ASSERT_EQ(events.front().address, 0x81000000 + 6 * KiB(4));
+    ASSERT_EQ(events.back().address, 0x81000000 + 9 * KiB(4));
+    // the totals still count everything
+    ASSERT_EQ(tracker.get_category_stats()[0].alloc_count, 10);
+}
+
+TEST(allocation_tracker, realign_moves_the_allocation) {
+    AllocationTracker tracker;
+    tracker.set_enabled(true);
+    tracker.record_alloc(0x81000000, KiB(16), "aligned", 0);
+    tracker.record_realign(0x81000000, 0x81002000, KiB(8));
+    ASSERT_EQ(tracker.get_current_size(), KiB(8));
+    ASSERT_EQ(tracker.get_events().back().address, 0x81002000);
+
+    tracker.record_free(0x81002000, 0);
+    ASSERT_EQ(tracker.get_current_size(), 0);
+}
+
+TEST(allocation_tracker, csv_export) {
+    AllocationTracker tracker;
+    tracker.set_enabled(true);
+    tracker.record_alloc(0x81000000, KiB(4), "say \"hi\": 1", 3);
+
+    const std::string events = tracker.get_events_csv();
+    ASSERT_NE(events.find("alloc,0x81000000,4096,\"say \"\"hi\"\"\",3\n"), std::string::npos);
+    const std::string summary = tracker.get_summary_csv();
+    ASSERT_NE(summary.find("\"say \"\"hi\"\"\",1,4096,4096,4096,1,0,1,0"), std::string::npos);
+}
@@ -21,6 +21,12 @@
 
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <random>
+#include <vector>
+
 TEST(bitmap_allocator, one_bit_allocation) {
     BitmapAllocator allocator(KiB(5));
 
@@ -157,6 +163,7 @@ TEST(bitmap_allocator, no_best_fit_only_one_fit) {
 
     // Bitmap:              1000 0101 0001 0001 0101 0001 00[11 1]001
     alloc.words[0] = 0b10000101000100010101000100111001;
+    alloc.rebuild_summary();
 
     int to_alloc = 3;
     ASSERT_EQ(alloc.allocate_from(0, to_alloc), 26);
@@ -171,6 +178,7 @@ TEST(bitmap_allocator, no_best_fit_multiple_fit) {
 
     // Bitmap 1:            1000 0[111] 1001 0001 0101 0001 0011 1001
     alloc.words[0] = 0b10000111100100010101000100111001;
+    alloc.rebuild_summary();
 
     int to_alloc = 3;
     ASSERT_EQ(alloc.allocate_from(0, to_alloc), 5);
@@ -185,6 +193,7 @@ TEST(bitmap_allocator, no_best_fit_alloc_across) {
 
     alloc.words[0] = 0b111;
     alloc.words[1] = 0b11100000000000000000000000000000;
+    alloc.rebuild_summary();
 
     int to_alloc = 5;
     ASSERT_EQ(alloc.allocate_from(0, to_alloc), 29);
@@ -199,6 +208,7 @@ TEST(bitmap_allocator, best_fit_multiple_fit) {
 
     // Bitmap 1:            1000 0111 1001 0001 0101 0001 00[11 1]001
     alloc.words[0] = 0b10000111100100010101000100111001;
+    alloc.rebuild_summary();
 
     int to_alloc = 3;
     ASSERT_EQ(alloc.allocate_from(0, to_alloc, true), 26);
@@ -219,6 +229,7 @@ TEST(bitmap_allocator, count_bit_aligned) {
 
     // Bitmap 3: 12 bits on
     alloc.words[2] = 0x00F00F0F;
+    alloc.rebuild_summary();
 
     ASSERT_EQ(alloc.free_slot_count(0, 32 * 3), 56);
     ASSERT_EQ(alloc.free_slot_count(0, 32 * 3 - 1), 55);
@@ -239,7 +250,115 @@ TEST(bitmap_allocator, count_unaligned) {
     //                          ^ ignored
     // 5 valid bits on
     alloc.words[2] = 0b10101110001111;
+    alloc.rebuild_summary();
 
     // 4 valid bits + 12 bits + 5 valid bits = 21
     ASSERT_EQ(alloc.free_slot_count(22, 92), 21);
 }
+
+// Reference first and best fit, checking the slots one by one
+static int find_free_run_linear(const BitmapAllocator &allocator, int start, int size, bool best_fit) {
+    int result = -1;
+    int result_size = INT_MAX;
+    int run_start = start;
+    for (int offset = start; offset <= static_cast<int>(allocator.max_offset); offset++) {
+        if (offset < static_cast<int>(allocator.max_offset) && allocator.is_free(offset)) {
+            if (!best_fit && offset - run_start + 1 >= size)
+                return run_start;
+            continue;
+        }
+
+        const int run_size = offset - run_start;
+        if (run_size >= size && run_size < result_size) {
+            result = run_start;
+            result_size = run_size;
+        }
+        run_start = offset + 1;
+    }
+    return result;
+}
+
+TEST(bitmap_allocator, summary_matches_linear_search) {
+    // a failure reports the seed to reproduce it
+    const unsigned seed = std::random_device{}();
+    SCOPED_TRACE(::testing::Message() << "seed " << seed);
+    std::mt19937 rng(seed);
+    const auto random = [&](int bound) { return static_cast<int>(rng() % bound); };
+    constexpr int MEM_SIZE = 3000; // not a multiple of 32
+
+    BitmapAllocator allocator(MEM_SIZE);
+    for (int i = 0; i < 20000; ++i) {
+        const int offset = random(MEM_SIZE);
+        const int size = random(40) + 1;
+        if (random(2)) {
+            allocator.allocate_at(offset, std::min(size, MEM_SIZE - offset));
+        } else {
+            allocator.free(offset, std::min(size, MEM_SIZE - offset));
+        }
+
+        const int start = random(64);
+        const int wanted = random(64) + 1;
+        const bool best_fit = random(2);
+        const int expected = find_free_run_linear(allocator, start, wanted, best_fit);
+
+        int allocated = wanted;
+        const int ret = allocator.allocate_from(start, allocated, best_fit);
+        ASSERT_EQ(ret, expected);
+        if (ret >= 0) {
+            ASSERT_EQ(allocated, wanted);
+            allocator.free(ret, allocated);
+        }
+
+        const int count_start = random(MEM_SIZE);
+        const int count_end = count_start + random(MEM_SIZE - count_start) + 1;
+        int count = 0;
+        for (int slot = count_start; slot < count_end; slot++)
+            count += allocator.is_free(slot);
+        ASSERT_EQ(allocator.free_slot_count(count_start, count_end), count);
+    }
+}
+
+// Small allocations and frees in a fragmented guest sized page bitmap.
+// Only prints timings, run it with --gtest_also_run_disabled_tests
+TEST(bitmap_allocator, DISABLED_benchmark_throughput) {
+    constexpr int MEM_SIZE = KiB(1024); // 4 GiB of 4 KiB pages
+    constexpr int OPERATIONS = 20000;
+
+    for (const bool best_fit : { false, true }) {
+        srand(0);
+        BitmapAllocator allocator(MEM_SIZE);
+        std::vector<std::pair<int, int>> blocks;
+
+        // fill most of the space, the free runs left are scattered everywhere
+        while (allocator.free_slot_count(0, MEM_SIZE) > MEM_SIZE / 4) {
+            int size = rand() % 16 + 1;
+            const int offset = allocator.allocate_from(0, size);
+            blocks.emplace_back(offset, size);
+        }
+        for (std::size_t i = 0; i < blocks.size(); i += 2) {
+            allocator.free(blocks[i].first, blocks[i].second);
+            blocks[i].second = 0;
+        }
+
+        const auto begin = std::chrono::steady_clock::now();
+        int valid_pages = 0;
+        for (int i = 0; i < OPERATIONS; ++i) {
+            auto &block = blocks[rand() % blocks.size()];
+            if (block.second) {
+                allocator.free(block.first, block.second);
+                block.second = 0;
+            }
+
+            int size = rand() % 32 + 1;
+            const int offset = allocator.allocate_from(0, size, best_fit);
+            if (offset >= 0)
+                block = { offset, size };
+
+            valid_pages += allocator.free_slot_count(rand() % MEM_SIZE, MEM_SIZE) > 0;
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+        ASSERT_GT(valid_pages, 0);
+        std::printf("%s: %.0f allocate/free/count per second\n", best_fit ? "best fit" : "first fit", OPERATIONS / elapsed.count());
+    }
+}
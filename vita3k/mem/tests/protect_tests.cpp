@@ -0,0 +1,318 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <mem/functions.h>
+#include <mem/state.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// The access violation handler is global, so all the tests share the same memory
+static MemState &get_mem() {
+    static MemState mem;
+    static const bool initialized = init(mem, false);
+    EXPECT_TRUE(initialized);
+    return mem;
+}
+
+static void write_byte(MemState &mem, Address addr) {
+    *reinterpret_cast<volatile uint8_t *>(&mem.memory[addr]) = 1;
+}
+
+TEST(protect, write_runs_callback_once) {
+    MemState &mem = get_mem();
+    const Address addr = alloc(mem, mem.page_size * 4, "protect");
+
+    int hits = 0;
+    add_protect(mem, addr, mem.page_size * 4, MemPerm::ReadOnly, [&](Address, bool write) {
+        EXPECT_TRUE(write);
+        hits++;
+        return true;
+    });
+    ASSERT_TRUE(is_protecting(mem, addr + mem.page_size * 3));
+
+    write_byte(mem, addr + mem.page_size * 2);
+    ASSERT_EQ(hits, 1);
+
+    // the whole block is gone after the first hit
+    write_byte(mem, addr);
+    ASSERT_EQ(hits, 1);
+    ASSERT_FALSE(is_protecting(mem, addr));
+
+    free(mem, addr);
+}
+
+TEST(protect, removed_block_drops_protection_without_callback) {
+    MemState &mem = get_mem();
+    const Address addr = alloc(mem, mem.page_size * 2, "protect");
+
+    int hits = 0;
+    const ProtectBlockPtr block = add_protect(mem, addr, mem.page_size * 2, MemPerm::None, [&](Address, bool) {
+        hits++;
+        return true;
+    });
+    ASSERT_TRUE(is_protecting(mem, addr));
+
+    remove_protect(mem, block);
+    ASSERT_FALSE(is_protecting(mem, addr + mem.page_size));
+
+    write_byte(mem, addr);
+    ASSERT_EQ(hits, 0);
+
+    free(mem, addr);
+}
+
+TEST(protect, overlapping_blocks_keep_the_strictest_permission) {
+    MemState &mem = get_mem();
+    const Address addr = alloc(mem, mem.page_size * 2, "protect");
+
+    int read_only_hits = 0;
+    int no_access_hits = 0;
+    add_protect(mem, addr, mem.page_size * 2, MemPerm::ReadOnly, [&](Address, bool) {
+        read_only_hits++;
+        return true;
+    });
+    add_protect(mem, addr + mem.page_size, mem.page_size, MemPerm::None, [&](Address, bool) {
+        no_access_hits++;
+        return true;
+    });
+
+    MemPerm perm = MemPerm::ReadWrite;
+    ASSERT_TRUE(is_protecting(mem, addr + mem.page_size, &perm));
+    ASSERT_EQ(perm, MemPerm::None);
+
+    // reading the first page doesn't fault, the second page is not readable
+    ASSERT_EQ(*reinterpret_cast<volatile uint8_t *>(&mem.memory[addr]), 0);
+    ASSERT_EQ(*reinterpret_cast<volatile uint8_t *>(&mem.memory[addr + mem.page_size]), 0);
+    ASSERT_EQ(read_only_hits, 1);
+    ASSERT_EQ(no_access_hits, 1);
+    ASSERT_FALSE(is_protecting(mem, addr));
+
+    free(mem, addr);
+}
+
+TEST(protect, open_segment_defers_protection) {
+    MemState &mem = get_mem();
+    const Address addr = alloc(mem, mem.page_size, "protect");
+
+    int hits = 0;
+    open_access_parent_protect_segment(mem, addr, mem.page_size);
+    add_protect(mem, addr, mem.page_size, MemPerm::ReadOnly, [&](Address, bool) {
+        hits++;
+        return true;
+    });
+
+    // still accessible while the segment is open
+    write_byte(mem, addr);
+    ASSERT_EQ(hits, 0);
+
+    close_access_parent_protect_segment(mem, addr, mem.page_size);
+    write_byte(mem, addr);
+    ASSERT_EQ(hits, 1);
+
+    free(mem, addr);
+}
+
+TEST(protect, parallel_faults_on_different_pages) {
+    constexpr int thread_count = 8;
+    constexpr int rounds = 200;
+
+    MemState &mem = get_mem();
+    const Address addr = alloc(mem, mem.page_size * thread_count, "protect");
+
+    std::atomic<int> hits = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; i++) {
+        threads.emplace_back([&, i] {
+            const Address page = addr + i * mem.page_size;
+            for (int round = 0; round < rounds; round++) {
+                add_protect(mem, page, mem.page_size, MemPerm::ReadOnly, [&](Address, bool) {
+                    hits++;
+                    return true;
+                });
+                write_byte(mem, page);
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+
+    ASSERT_EQ(hits, thread_count * rounds);
+    free(mem, addr);
+}
+
+TEST(protect, write_generation_tracks_writes) {
+    MemState &mem = get_mem();
+    const Address addr = alloc(mem, mem.page_size * 4, "generation");
+
+    const uint64_t first = snapshot_write_generation(mem, addr, mem.page_size * 2);
+    const uint64_t second = snapshot_write_generation(mem, addr + mem.page_size * 2, mem.page_size * 2);
+    ASSERT_FALSE(pages_changed_since(mem, addr, mem.page_size * 4, first));
+
+    // only the range holding the write changed
+    write_byte(mem, addr + mem.page_size * 3);
+    ASSERT_FALSE(pages_changed_since(mem, addr, mem.page_size * 2, first));
+    ASSERT_TRUE(pages_changed_since(mem, addr + mem.page_size * 2, mem.page_size * 2, second));
+
+    // watched again after a new snapshot
+    const uint64_t third = snapshot_write_generation(mem, addr + mem.page_size * 2, mem.page_size * 2);
+    ASSERT_FALSE(pages_changed_since(mem, addr + mem.page_size * 2, mem.page_size * 2, third));
+    write_byte(mem, addr + mem.page_size * 2);
+    ASSERT_TRUE(pages_changed_since(mem, addr + mem.page_size * 2, mem.page_size * 2, third));
+
+    free(mem, addr);
+    ASSERT_TRUE(pages_changed_since(mem, addr, mem.page_size * 2, first));
+}
+
+TEST(protect, write_generation_sees_opened_pages) {
+    MemState &mem = get_mem();
+    const Address addr = alloc(mem, mem.page_size, "generation");
+
+    // opening removes the host protection, the writes made meanwhile don't fault
+    const uint64_t before = snapshot_write_generation(mem, addr, mem.page_size);
+    open_access_parent_protect_segment(mem, addr, mem.page_size);
+    ASSERT_TRUE(pages_changed_since(mem, addr, mem.page_size, before));
+
+    const uint64_t opened = snapshot_write_generation(mem, addr, mem.page_size);
+    ASSERT_TRUE(pages_changed_since(mem, addr, mem.page_size, opened));
+
+    // watched again once closed
+    close_access_parent_protect_segment(mem, addr, mem.page_size);
+    const uint64_t closed = snapshot_write_generation(mem, addr, mem.page_size);
+    ASSERT_FALSE(pages_changed_since(mem, addr, mem.page_size, closed));
+    write_byte(mem, addr);
+    ASSERT_TRUE(pages_changed_since(mem, addr, mem.page_size, closed));
+
+    free(mem, addr);
+}
+
+TEST(snapshot, restores_content_and_allocations) {
+    MemState &mem = get_mem();
+    const Address kept = alloc(mem, mem.page_size * 4, "snapshot");
+    std::memset(&mem.memory[kept], 0x11, mem.page_size * 4);
+
+    const MemSnapshotPtr first = take_snapshot(mem);
+    ASSERT_GE(first->pages.size(), 4);
+
+    // only the written page is stored by the next snapshot
+    mem.memory[kept + mem.page_size] = 0x22;
+    const MemSnapshotPtr second = take_snapshot(mem);
+    ASSERT_EQ(second->pages, std::vector<uint32_t>{ kept / mem.page_size + 1 });
+
+    // nothing written, nothing stored
+    const MemSnapshotPtr unchanged = take_snapshot(mem);
+    ASSERT_TRUE(unchanged->pages.empty());
+    restore_snapshot(mem, second);
+
+    free(mem, kept);
+    const Address added = alloc(mem, mem.page_size, "snapshot");
+    mem.memory[added] = 0x33;
+
+    restore_snapshot(mem, first);
+    ASSERT_TRUE(is_valid_addr(mem, kept));
+    ASSERT_EQ(mem.memory[kept + mem.page_size], 0x11);
+    if (added != kept)
+        ASSERT_FALSE(is_valid_addr(mem, added));
+
+    restore_snapshot(mem, second);
+    ASSERT_EQ(mem.memory[kept + mem.page_size], 0x22);
+    ASSERT_EQ(mem.memory[kept + mem.page_size * 3], 0x11);
+
+    free(mem, kept);
+    reset_snapshots(mem);
+}
+
+TEST(snapshot, restore_invalidates_watched_pages) {
+    MemState &mem = get_mem();
+    const Address addr = alloc(mem, mem.page_size, "snapshot");
+
+    const MemSnapshotPtr snapshot = take_snapshot(mem);
+    write_byte(mem, addr);
+    const uint64_t generation = snapshot_write_generation(mem, addr, mem.page_size);
+
+    restore_snapshot(mem, snapshot);
+    ASSERT_EQ(mem.memory[addr], 0);
+    ASSERT_TRUE(pages_changed_since(mem, addr, mem.page_size, generation));
+
+    free(mem, addr);
+    reset_snapshots(mem);
+}
+
+TEST(snapshot, host_io_can_write_guest_memory) {
+    MemState &mem = get_mem();
+    constexpr uint32_t size = KiB(32);
+    const Address addr = alloc(mem, size, "snapshot");
+
+    std::FILE *file = std::tmpfile();
+    ASSERT_NE(file, nullptr);
+    const std::vector<uint8_t> data(size, 0x44);
+    ASSERT_EQ(std::fwrite(data.data(), 1, size, file), size);
+
+    // files are read straight into guest memory, the way sceIoRead does it
+    const MemSnapshotPtr snapshot = take_snapshot(mem);
+    std::rewind(file);
+    ASSERT_EQ(std::fread(&mem.memory[addr], 1, size, file), size);
+    ASSERT_EQ(mem.memory[addr + size - 1], 0x44);
+
+    restore_snapshot(mem, snapshot);
+    std::rewind(file);
+    ASSERT_EQ(std::fread(&mem.memory[addr], 1, size, file), size);
+    std::fclose(file);
+
+    free(mem, addr);
+    reset_snapshots(mem);
+}
+
+// Only prints timings, run it with --gtest_also_run_disabled_tests
+TEST(snapshot, DISABLED_benchmark_snapshot_time) {
+    constexpr uint32_t size = MiB(256);
+
+    MemState &mem = get_mem();
+    const Address addr = alloc(mem, size, "snapshot");
+    for (uint32_t offset = 0; offset < size; offset += mem.page_size)
+        mem.memory[addr + offset] = static_cast<uint8_t>(offset / mem.page_size);
+
+    const auto measure = [&](MemSnapshotPtr &snapshot) {
+        const auto begin = std::chrono::steady_clock::now();
+        snapshot = take_snapshot(mem);
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    };
+
+    MemSnapshotPtr full, incremental;
+    const double full_ms = measure(full);
+    // a game frame usually touches a few MiB
+    for (uint32_t offset = 0; offset < MiB(4); offset += mem.page_size)
+        mem.memory[addr + offset]++;
+    const double incremental_ms = measure(incremental);
+
+    const auto begin = std::chrono::steady_clock::now();
+    restore_snapshot(mem, full);
+    const double restore_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    ASSERT_EQ(mem.memory[addr + mem.page_size], 1);
+
+    std::printf("256 MiB allocated: full snapshot %.1f ms, 4 MiB changed %.1f ms (%zu KiB stored), restore %.1f ms\n",
+        full_ms, incremental_ms, incremental->data.size() / KiB(1), restore_ms);
+
+    free(mem, addr);
+    reset_snapshots(mem);
+}
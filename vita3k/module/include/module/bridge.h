@@ -31,6 +31,7 @@
 #include <emuenv/state.h>
 
 using ImportFn = std::function<void(EmuEnvState &emuenv, CPUState &cpu, SceUID thread_id)>;
+using ImportFnPtr = void (*)(EmuEnvState &emuenv, CPUState &cpu, SceUID thread_id);
 using ImportVarFactory = std::function<Address(EmuEnvState &emuenv)>;
 
 // Function returns a value that is written to CPU registers.
@@ -47,17 +48,29 @@ void call(void (*export_fn)(EmuEnvState &, SceUID, const char *, Args...), const
 }
 
 template <typename Ret, typename... Args>
-ImportFn bridge(Ret (*export_fn)(EmuEnvState &, SceUID, const char *, Args...), const char *export_name) {
+void bridge_call(Ret (*export_fn)(EmuEnvState &, SceUID, const char *, Args...), const char *export_name, EmuEnvState &emuenv, CPUState &cpu, SceUID thread_id) {
     constexpr std::tuple<ArgsLayout<Args...>, LayoutArgsState> args_layout = lay_out<typename BridgeTypes<Args>::ArmType...>();
 
-    return [export_fn, export_name, args_layout](EmuEnvState &emuenv, CPUState &cpu, SceUID thread_id) {
 #ifdef TRACY_ENABLE
-        ZoneNamed(___tracy_scoped_zone, emuenv.cfg.tracy_primitive_impl); // Tracy - Track function scope
-        ZoneColorV(___tracy_scoped_zone, 0xFFF34C); // Tracy - Change color to yellow
-        ZoneNameV(___tracy_scoped_zone, export_name, strlen(export_name)); // Tracy - Edit scope name based on export_name
+    ZoneNamed(___tracy_scoped_zone, emuenv.cfg.tracy_primitive_impl); // Tracy - Track function scope
+    ZoneColorV(___tracy_scoped_zone, 0xFFF34C); // Tracy - Change color to yellow
+    ZoneNameV(___tracy_scoped_zone, export_name, strlen(export_name)); // Tracy - Edit scope name based on export_name
 #endif
 
-        using Indices = std::index_sequence_for<Args...>;
-        call(export_fn, export_name, std::get<0>(args_layout), std::get<1>(args_layout), Indices(), thread_id, cpu, emuenv);
+    using Indices = std::index_sequence_for<Args...>;
+    call(export_fn, export_name, std::get<0>(args_layout), std::get<1>(args_layout), Indices(), thread_id, cpu, emuenv);
+}
+
+template <typename Ret, typename... Args>
+ImportFn bridge(Ret (*export_fn)(EmuEnvState &, SceUID, const char *, Args...), const char *export_name) {
+    return [export_fn, export_name](EmuEnvState &emuenv, CPUState &cpu, SceUID thread_id) {
+        bridge_call(export_fn, export_name, emuenv, cpu, thread_id);
     };
 }
+
+// Same as bridge(), but the export is known at compile time so the result is a plain function
+// Used by the import dispatch table to call HLE functions without going through a std::function
+template <auto export_fn, const char *export_name>
+void bridge_fn(EmuEnvState &emuenv, CPUState &cpu, SceUID thread_id) {
+    bridge_call(export_fn, export_name, emuenv, cpu, thread_id);
+}
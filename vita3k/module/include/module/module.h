@@ -27,8 +27,13 @@ int unimplemented_impl(const char *name);
 int stubbed_impl(const char *name, const char *info);
 #define STUBBED(info) stubbed_impl(export_name, info)
 
-#define BRIDGE_DECL(name) extern const ImportFn import_##name;
-#define BRIDGE_IMPL(name) const ImportFn import_##name = bridge(&export_##name, #name);
+#define BRIDGE_DECL(name)                 \
+    extern const ImportFn import_##name; \
+    extern const ImportFnPtr import_fn_ptr_##name;
+#define BRIDGE_IMPL(name)                                             \
+    const ImportFn import_##name = bridge(&export_##name, #name);     \
+    static constexpr char import_name_##name[] = #name;              \
+    const ImportFnPtr import_fn_ptr_##name = &bridge_fn<&export_##name, import_name_##name>;
 
 #define CALL_EXPORT(name, ...) export_##name(emuenv, thread_id, #name, ##__VA_ARGS__)
 
@@ -213,7 +213,7 @@ static Ptr<uint8_t> get_buffer(const PlayerPtr &player, MediaType media_type,
         for (uint32_t a = 0; a < PlayerInfoState::RING_BUFFER_COUNT; a++) {
             if (buffers[a])
                 free(mem, buffers[a]);
-            std::string alloc_name = fmt::format("AvPlayer {} Media Ring {}",
+            std::string alloc_name = fmt::format("AvPlayer media ring: {} {}",
                 media_type == MediaType::VIDEO ? "Video" : "Audio", a);
 
             buffers[a] = alloc(mem, size, alloc_name.c_str());
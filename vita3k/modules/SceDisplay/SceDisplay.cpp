@@ -142,6 +142,8 @@ EXPORT(SceInt32, _sceDisplaySetFrameBuf, const SceDisplayFrameBuf *pFrameBuf, Sc
         emuenv.display.frame = emuenv.display.next_frame;
         emuenv.renderer->should_display = true;
     }
+    // when running as fast as possible, the vblank thread waits for this frame
+    emuenv.display.next_frame_cond.notify_one();
 
     emuenv.frame_count++;
 
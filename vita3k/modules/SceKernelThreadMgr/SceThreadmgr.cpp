@@ -23,6 +23,7 @@
 #include <kernel/sync_primitives.h>
 #include <kernel/types.h>
 #include <packages/functions.h>
+#include <rtc/rtc.h>
 
 #include <util/lock_and_find.h>
 
@@ -33,9 +34,8 @@
 TRACY_MODULE_NAME(SceThreadmgr);
 
 inline uint64_t get_current_time() {
-    return std::chrono::duration_cast<std::chrono::microseconds>(
-        std::chrono::high_resolution_clock::now().time_since_epoch())
-        .count();
+    // the guest clock, which runs faster when fast-forwarding
+    return rtc_ticks_since_epoch();
 }
 
 EXPORT(int, __sceKernelCreateLwMutex, Ptr<SceKernelLwMutexWork> workarea, const char *name, unsigned int attr, Ptr<SceKernelCreateLwMutex_opt> opt) {
@@ -201,7 +201,8 @@ EXPORT(SceInt32, _sceKernelGetCallbackInfo, SceUID callbackId, SceKernelCallback
 
 EXPORT(SceInt32, _sceKernelGetCondInfo, SceUID condId, Ptr<SceKernelCondInfo> pInfo) {
     TRACY_FUNC(_sceKernelGetCondInfo, condId, pInfo);
-    const CondvarPtr condvar = lock_and_find(condId, emuenv.kernel.condvars, emuenv.kernel.mutex);
+    const HandleReadGuard guard;
+    Condvar *const condvar = emuenv.kernel.condvars.get(condId);
     if (!condvar)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVF_ID);
 
@@ -223,7 +224,8 @@ EXPORT(SceInt32, _sceKernelGetCondInfo, SceUID condId, Ptr<SceKernelCondInfo> pI
 
 EXPORT(SceInt32, _sceKernelGetEventFlagInfo, SceUID evfId, Ptr<SceKernelEventFlagInfo> pInfo) {
     TRACY_FUNC(_sceKernelGetEventFlagInfo, evfId, pInfo);
-    const EventFlagPtr eventflag = lock_and_find(evfId, emuenv.kernel.eventflags, emuenv.kernel.mutex);
+    const HandleReadGuard guard;
+    EventFlag *const eventflag = emuenv.kernel.eventflags.get(evfId);
     if (!eventflag)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_EVF_ID);
 
@@ -273,19 +275,17 @@ EXPORT(int, _sceKernelGetLwMutexInfoById, SceUID lightweight_mutex_id, Ptr<SceKe
         info_data = &info_data_local;
         info_data_local.size = info_size;
     }
-    MutexPtr mutex = mutex_get(emuenv.kernel, export_name, thread_id, lightweight_mutex_id, SyncWeight::Light);
+    const HandleReadGuard guard;
+    Mutex *const mutex = mutex_get(emuenv.kernel, export_name, thread_id, lightweight_mutex_id, SyncWeight::Light);
     if (mutex) {
         info_data->uid = lightweight_mutex_id;
         strncpy(info_data->name, mutex->name, KERNELOBJECT_MAX_NAME_LENGTH + 1);
         info_data->attr = mutex->attr;
         info_data->pWork = mutex->workarea;
         info_data->initCount = mutex->init_count;
-        info_data->currentCount = mutex->lock_count;
-        if (mutex->owner == 0) {
-            info_data->currentOwnerId = 0;
-        } else {
-            info_data->currentOwnerId = mutex->owner->id;
-        }
+        const SceKernelLwMutexWork *workarea = mutex->workarea.get(emuenv.mem);
+        info_data->currentCount = workarea->lockCount;
+        info_data->currentOwnerId = lwmutex_owner(*workarea);
         info_data->numWaitThreads = static_cast<SceUInt32>(mutex->waiting_threads->size());
         if (info_size < sizeof(SceKernelLwMutexInfo)) {
             memcpy(info.get(emuenv.mem), &info_data_local, info_size);
@@ -314,7 +314,8 @@ EXPORT(int, _sceKernelGetMutexInfo, SceUID mutexId, SceKernelMutexInfo *pInfo) {
         info_data = &info_data_local;
         info_data_local.size = info_size;
     }
-    const MutexPtr mutex = lock_and_find(mutexId, emuenv.kernel.mutexes, emuenv.kernel.mutex);
+    const HandleReadGuard guard;
+    Mutex *const mutex = emuenv.kernel.mutexes.get(mutexId);
     if (!mutex)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_MUTEX_ID);
     info_data->mutexId = mutexId;
@@ -342,7 +343,8 @@ EXPORT(int, _sceKernelGetRWLockInfo, SceUID rwlockId, SceKernelRWLockInfo *info)
         return RET_ERROR(SCE_KERNEL_ERROR_INVALID_ARGUMENT);
     if (info->size < sizeof(SceKernelRWLockInfo))
         return RET_ERROR(SCE_KERNEL_ERROR_INVALID_ARGUMENT);
-    const RWLockPtr rwlock = lock_and_find(rwlockId, emuenv.kernel.rwlocks, emuenv.kernel.mutex);
+    const HandleReadGuard guard;
+    RWLock *const rwlock = emuenv.kernel.rwlocks.get(rwlockId);
     if (!rwlock)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_RW_LOCK_ID);
     const std::lock_guard<std::mutex> rwlock_lock(rwlock->mutex);
@@ -391,7 +393,8 @@ EXPORT(int, _sceKernelGetRWLockInfo, SceUID rwlockId, SceKernelRWLockInfo *info)
 
 EXPORT(SceInt32, _sceKernelGetSemaInfo, SceUID semaId, Ptr<SceKernelSemaInfo> pInfo) {
     TRACY_FUNC(_sceKernelGetSemaInfo, semaId, pInfo);
-    const SemaphorePtr semaphore = lock_and_find(semaId, emuenv.kernel.semaphores, emuenv.kernel.mutex);
+    const HandleReadGuard guard;
+    Semaphore *const semaphore = emuenv.kernel.semaphores.get(semaId);
     if (!semaphore)
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_SEMA_ID);
 
@@ -539,8 +542,7 @@ EXPORT(int, _sceKernelLockLwMutex, Ptr<SceKernelLwMutexWork> workarea, int lock_
     if (!workarea)
         return RET_ERROR(SCE_KERNEL_ERROR_INVALID_ARGUMENT);
 
-    const auto lwmutexid = workarea.get(emuenv.mem)->uid;
-    return mutex_lock(emuenv.kernel, emuenv.mem, export_name, thread_id, lwmutexid, lock_count, ptimeout, SyncWeight::Light);
+    return lwmutex_lock(emuenv.kernel, emuenv.mem, export_name, thread_id, workarea, lock_count, ptimeout);
 }
 
 EXPORT(int, _sceKernelLockMutex, SceUID mutexid, int lock_count, unsigned int *timeout) {
@@ -822,7 +824,19 @@ int wait_thread_end(ThreadStatePtr &waiter, ThreadStatePtr &target, int *stat) {
         waiter->update_status(ThreadStatus::wait);
         target->waiting_threads.push_back(waiter);
     }
-    waiter->status_cond.wait(waiter_lock, [&]() { return waiter->status == ThreadStatus::run; });
+    waiter->status_cond.wait(waiter_lock, [&]() { return waiter->status == ThreadStatus::run || waiter->wait_aborted; });
+    if (waiter->status != ThreadStatus::run) {
+        // a savestate is being loaded, the target is locked before the waiter when it ends
+        waiter_lock.unlock();
+        {
+            const std::unique_lock<std::mutex> thread_lock(target->mutex);
+            std::erase(target->waiting_threads, waiter);
+        }
+        waiter_lock.lock();
+        if (waiter->status == ThreadStatus::wait)
+            waiter->update_status(ThreadStatus::run);
+        return SCE_KERNEL_ERROR_WAIT_CANCEL;
+    }
     return 0;
 }
 
@@ -876,6 +890,7 @@ EXPORT(SceInt32, sceKernelChangeThreadCpuAffinityMask, SceUID thid, SceInt32 aff
         return RET_ERROR(SCE_KERNEL_ERROR_ILLEGAL_CPU_AFFINITY_MASK);
 
     thread->affinity_mask = affinity_mask;
+    emuenv.kernel.update_host_thread(*thread);
     return old_affinity;
 }
 
@@ -900,6 +915,7 @@ EXPORT(SceInt32, sceKernelChangeThreadPriority2, SceUID thid, SceInt32 priority)
         return RET_ERROR(SCE_KERNEL_ERROR_ILLEGAL_PRIORITY);
 
     thread->priority = priority;
+    emuenv.kernel.update_host_thread(*thread);
 
     return old_priority;
 }
@@ -1010,11 +1026,20 @@ EXPORT(int, sceKernelCreateThreadForUser, const char *name, SceKernelThreadEntry
     return thread->id;
 }
 
-int delay_thread(SceUInt delay_us) {
+int delay_thread(EmuEnvState &emuenv, SceUID thread_id, SceUInt delay_us) {
     if (delay_us == 0)
         return SCE_KERNEL_ERROR_INVALID_ARGUMENT;
 
-    std::this_thread::sleep_for(std::chrono::microseconds(delay_us));
+    const ThreadStatePtr thread = emuenv.kernel.get_thread(thread_id);
+    if (!thread) {
+        std::this_thread::sleep_for(std::chrono::microseconds(delay_us));
+        return SCE_KERNEL_OK;
+    }
+
+    // the timer wheel is more precise than a sleep, and wakes all the threads delayed until the same tick at once
+    std::unique_lock<std::mutex> thread_lock(thread->mutex);
+    emuenv.kernel.timer_wheel.wait_for(thread_lock, std::shared_ptr<std::mutex>(thread, &thread->mutex),
+        std::shared_ptr<std::condition_variable>(thread, &thread->status_cond), std::chrono::microseconds(delay_us), [] { return false; });
 
     return SCE_KERNEL_OK;
 }
@@ -1026,21 +1051,21 @@ int delay_thread_cb(EmuEnvState &emuenv, SceUID thread_id, SceUInt delay_us) {
     auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
 
     if (delay_us > elapsed.count()) // If we spent less time than requested processing callbacks, sleep the remaining time
-        return delay_thread(delay_us - elapsed.count());
+        return delay_thread(emuenv, thread_id, delay_us - elapsed.count());
     else // Else return directly
         return SCE_KERNEL_OK;
 }
 
 EXPORT(int, sceKernelDelayThread, SceUInt delay) {
     TRACY_FUNC(sceKernelDelayThread, delay);
-    return delay_thread(delay);
+    return delay_thread(emuenv, thread_id, delay);
 }
 
 EXPORT(int, sceKernelDelayThread200, SceUInt delay) {
     TRACY_FUNC(sceKernelDelayThread200, delay);
     if (delay < 201)
         delay = 201;
-    return delay_thread(delay);
+    return delay_thread(emuenv, thread_id, delay);
 }
 
 EXPORT(int, sceKernelDelayThreadCB, SceUInt delay) {
@@ -1272,7 +1297,8 @@ EXPORT(SceUID, sceKernelOpenTimer, const char *name) {
 EXPORT(int, sceKernelPollSema, SceUID semaid, int32_t needCount) {
     TRACY_FUNC(sceKernelPollSema, semaid, needCount);
     assert(needCount >= 0);
-    const SemaphorePtr semaphore = lock_and_find(semaid, emuenv.kernel.semaphores, emuenv.kernel.mutex);
+    const HandleReadGuard guard;
+    Semaphore *const semaphore = emuenv.kernel.semaphores.get(semaid);
     if (!semaphore) {
         return RET_ERROR(SCE_KERNEL_ERROR_UNKNOWN_SEMA_ID);
     }
@@ -1425,7 +1451,7 @@ EXPORT(int, sceKernelTryLockWriteRWLock) {
 
 EXPORT(int, sceKernelUnlockMutex, SceUID mutexid, int unlock_count) {
     TRACY_FUNC(sceKernelUnlockMutex, mutexid, unlock_count);
-    return mutex_unlock(emuenv.kernel, export_name, thread_id, mutexid, unlock_count, SyncWeight::Heavy);
+    return mutex_unlock(emuenv.kernel, emuenv.mem, export_name, thread_id, mutexid, unlock_count, SyncWeight::Heavy);
 }
 
 EXPORT(int, sceKernelUnlockReadRWLock, SceUID lock_id) {
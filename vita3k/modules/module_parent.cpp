@@ -18,6 +18,7 @@
 #include <modules/module_parent.h>
 
 #include <cpu/functions.h>
+#include <cpu/state.h>
 #include <emuenv/state.h>
 #include <io/device.h>
 #include <io/vfs.h>
@@ -30,34 +31,76 @@
 #include <util/lock_and_find.h>
 #include <util/log.h>
 
+#include <algorithm>
+#include <atomic>
 #include <unordered_set>
+#include <vector>
 
 static constexpr bool LOG_UNK_NIDS_ALWAYS = false;
 
+// Once resolved to an HLE function, the svc #0 of an import stub is replaced
+// by an svc whose immediate is this value plus the index of the function in the dispatch table
+static constexpr uint32_t HLE_IMPORT_SVC_BASE = 0x100000;
+
 #define LIBRARY(name) extern const LibraryInitFn import_library_init_##name;
 #include <modules/library_init_list.inc>
 #undef LIBRARY
 
 #define VAR_NID(name, nid) extern const ImportVarFactory import_##name;
-#define NID(name, nid) extern const ImportFn import_##name;
+#define NID(name, nid) extern const ImportFnPtr import_fn_ptr_##name;
 #include <nids/nids.inc>
 #undef NID
 #undef VAR_NID
 
 struct EmuEnvState;
 
-static ImportFn resolve_import(uint32_t nid) {
-    switch (nid) {
+struct HleImport {
+    uint32_t nid;
+    ImportFnPtr fn;
+    // value of export_nids_generation when the absence of an LLE export for this NID was last checked
+    std::atomic<uint32_t> checked_generation = 0;
+};
+
+constexpr int hle_imports_size =
 #define VAR_NID(name, nid)
-#define NID(name, nid) \
-    case nid:          \
-        return import_##name;
+#define NID(name, nid) 1 +
 #include <nids/nids.inc>
+    0;
 #undef NID
 #undef VAR_NID
-    }
 
-    return ImportFn();
+static std::array<HleImport, hle_imports_size> &get_hle_imports() {
+    static std::array<HleImport, hle_imports_size> hle_imports = { {
+#define VAR_NID(name, nid)
+#define NID(name, nid) { nid, import_fn_ptr_##name },
+#include <nids/nids.inc>
+#undef NID
+#undef VAR_NID
+    } };
+    return hle_imports;
+}
+
+/**
+ * \brief Finds the index of an HLE function in the dispatch table.
+ * \param nid NID to resolve
+ * \return Index of the function, -1 if not found
+ */
+static int find_hle_import(uint32_t nid) {
+    // pairs of NID and dispatch table index, sorted by NID
+    static const std::vector<std::pair<uint32_t, int>> sorted_nids = []() {
+        std::vector<std::pair<uint32_t, int>> nids;
+        const auto &hle_imports = get_hle_imports();
+        for (int i = 0; i < hle_imports_size; i++)
+            nids.emplace_back(hle_imports[i].nid, i);
+        std::sort(nids.begin(), nids.end());
+        return nids;
+    }();
+
+    const auto it = std::lower_bound(sorted_nids.begin(), sorted_nids.end(), std::make_pair(nid, 0));
+    if (it == sorted_nids.end() || it->first != nid)
+        return -1;
+
+    return it->second;
 }
 
 const std::array<VarExport, var_exports_size> &get_var_exports() {
@@ -99,23 +142,52 @@ static void log_import_call(char emulation_level, uint32_t nid, SceUID thread_id
     }
 }
 
+static void log_hle_import_call(CPUState &cpu, uint32_t nid, SceUID thread_id) {
+    const std::unordered_set<uint32_t> hle_nid_blacklist = {
+        0xB295EB61, // sceKernelGetTLSAddr
+        0x46E7BE7B, // sceKernelLockLwMutex
+        0x91FA6614, // sceKernelUnlockLwMutex
+    };
+    auto lr = read_lr(cpu);
+    log_import_call('H', nid, thread_id, hle_nid_blacklist, lr);
+}
+
 void call_import(EmuEnvState &emuenv, CPUState &cpu, uint32_t nid, SceUID thread_id) {
+    if (cpu.svc >= HLE_IMPORT_SVC_BASE) {
+        // HLE - stub already resolved, the svc immediate is the index of the function
+        HleImport &hle_import = get_hle_imports()[cpu.svc - HLE_IMPORT_SVC_BASE];
+        // a module loaded since the last check may export this NID, in which case go through the slow path
+        if (hle_import.checked_generation.load(std::memory_order_relaxed) == emuenv.kernel.export_nids_generation.load(std::memory_order_relaxed)) {
+            if (emuenv.kernel.debugger.watch_import_calls)
+                log_hle_import_call(cpu, hle_import.nid, thread_id);
+            hle_import.fn(emuenv, cpu, thread_id);
+            return;
+        }
+    }
+
+    const uint32_t export_generation = emuenv.kernel.export_nids_generation.load(std::memory_order_relaxed);
     Address export_pc = resolve_export(emuenv.kernel, nid);
 
     if (!export_pc) {
         // HLE - call our C++ function
-        if (emuenv.kernel.debugger.watch_import_calls) {
-            const std::unordered_set<uint32_t> hle_nid_blacklist = {
-                0xB295EB61, // sceKernelGetTLSAddr
-                0x46E7BE7B, // sceKernelLockLwMutex
-                0x91FA6614, // sceKernelUnlockLwMutex
-            };
-            auto lr = read_lr(cpu);
-            log_import_call('H', nid, thread_id, hle_nid_blacklist, lr);
-        }
-        const ImportFn fn = resolve_import(nid);
-        if (fn) {
-            fn(emuenv, cpu, thread_id);
+        if (emuenv.kernel.debugger.watch_import_calls)
+            log_hle_import_call(cpu, nid, thread_id);
+
+        const int index = find_hle_import(nid);
+        if (index >= 0) {
+            HleImport &hle_import = get_hle_imports()[index];
+            hle_import.checked_generation = export_generation;
+
+            // Resolve the stub once, next calls go straight to the function
+            const Address pc = read_pc(cpu) - 4;
+            uint32_t *const stub = Ptr<uint32_t>(pc).get(emuenv.mem);
+            const uint32_t svc = HLE_IMPORT_SVC_BASE + index;
+            if (stub[0] != encode_arm_inst(INSTRUCTION_SYSCALL, svc, 0)) {
+                stub[0] = encode_arm_inst(INSTRUCTION_SYSCALL, svc, 0);
+                emuenv.kernel.invalidate_jit_cache(pc, 4);
+            }
+
+            hle_import.fn(emuenv, cpu, thread_id);
         } else if (emuenv.missing_nids.count(nid) == 0 || LOG_UNK_NIDS_ALWAYS) {
             const ThreadStatePtr thread = lock_and_find(thread_id, emuenv.kernel.threads, emuenv.kernel.mutex);
             LOG_ERROR("Import function for NID {} not found (thread name: {}, thread ID: {})", log_hex(nid), thread->name, thread_id);
@@ -146,8 +218,7 @@ void call_import(EmuEnvState &emuenv, CPUState &cpu, uint32_t nid, SceUID thread
         const std::unordered_set<uint32_t> lle_nid_blacklist = {};
         log_import_call('L', nid, thread_id, lle_nid_blacklist, pc);
         write_pc(cpu, export_pc);
-        // TODO: invalidate cache for all threads. Now invalidate_jit_cache is not thread safe.
-        invalidate_jit_cache(cpu, pc, 4 * 3);
+        emuenv.kernel.invalidate_jit_cache(pc, 4 * 3);
     }
 }
 
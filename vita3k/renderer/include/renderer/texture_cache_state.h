@@ -35,7 +35,7 @@ enum class Backend : uint32_t;
 
 struct TextureCacheInfo {
     bool use_hash = false;
-    bool dirty = false;
+    uint64_t write_generation = 0; // When the hash is not used
     TextureCacheHash hash = 0;
     uint64_t timestamp = 0;
     SceGxmTexture texture;
@@ -695,7 +695,7 @@ void GLState::render_frame(const SceFVector2 &viewport_pos, const SceFVector2 &v
         const auto pixels = display.frame.base.cast<void>().get(mem);
 
         if (pixels) {
-            open_access_parent_protect_segment(mem, display.frame.base.address());
+            open_access_parent_protect_segment(mem, display.frame.base.address(), texture_data_size);
             unprotect_inner(mem, display.frame.base.address(), texture_data_size);
         }
 
@@ -706,7 +706,7 @@ void GLState::render_frame(const SceFVector2 &viewport_pos, const SceFVector2 &v
         glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 
         if (pixels) {
-            close_access_parent_protect_segment(mem, display.frame.base.address());
+            close_access_parent_protect_segment(mem, display.frame.base.address(), texture_data_size);
         }
 
         texture_size.x = static_cast<float>(display.frame.image_size.x);
@@ -142,7 +142,7 @@ COMMAND(handle_sync_surface_data) {
     // We just unprotect and reprotect again :D
     const std::size_t total_size = height * gxm::get_stride_in_bytes(surface->colorFormat, stride_in_pixels);
 
-    open_access_parent_protect_segment(mem, data);
+    open_access_parent_protect_segment(mem, data, total_size);
     unprotect_inner(mem, data, total_size);
 
     switch (renderer.current_backend) {
@@ -181,7 +181,7 @@ COMMAND(handle_sync_surface_data) {
         protect_inner(mem, data, total_size, MemPerm::None);
     }
 
-    close_access_parent_protect_segment(mem, data);
+    close_access_parent_protect_segment(mem, data, total_size);
 
     if (helper.cmd->status) {
         complete_command(renderer, helper, 0);
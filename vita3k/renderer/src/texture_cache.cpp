@@ -803,7 +803,7 @@ void cache_and_bind_texture(TextureCacheState &cache, const SceGxmTexture &gxm_t
             upload = info->hash != hash;
             info->hash = hash;
         } else {
-            upload = info->dirty;
+            upload = pages_changed_since(mem, range_protect_begin, range_protect_end - range_protect_begin, info->write_generation);
         }
     }
 
@@ -825,17 +825,11 @@ void cache_and_bind_texture(TextureCacheState &cache, const SceGxmTexture &gxm_t
         cache.configure_texture_callback(cache, &gxm_texture);
     }
     if (upload) {
-        upload_bound_texture(cache, gxm_texture, mem);
+        // the snapshot must be taken before reading the texture
         if (!info->use_hash) {
-            info->dirty = false;
-            add_protect(mem, range_protect_begin, range_protect_end - range_protect_begin, MemPerm::ReadOnly, [info, gxm_texture](Address, bool) {
-                if (memcmp(&info->texture, &gxm_texture, sizeof(SceGxmTexture)) == 0) {
-                    info->dirty = true;
-                }
-
-                return true;
-            });
+            info->write_generation = snapshot_write_generation(mem, range_protect_begin, range_protect_end - range_protect_begin);
         }
+        upload_bound_texture(cache, gxm_texture, mem);
         cache.upload_done_callback();
     }
 
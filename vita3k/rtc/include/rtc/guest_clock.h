@@ -0,0 +1,79 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+
+/*! \brief The clock the guest measures the time with: the RTC ticks, the thread delays and the wait timeouts.
+ *
+ * The time is in us since the host epoch. The clock follows the host one at speed, from the guest time it had
+ * when the speed was last changed, so that it never goes back. At speed 1 it is the host clock plus an offset,
+ * read without taking the lock.
+ * At speed 0 (as fast as possible) the vblanks drive it: each one moves it forward by one vblank period, however
+ * soon it comes. Between two vblanks it moves on as the host clock, without reaching the next vblank.
+ */
+class GuestClock {
+public:
+    typedef std::function<void()> Listener;
+
+    GuestClock();
+
+    GuestClock(const GuestClock &) = delete;
+    GuestClock &operator=(const GuestClock &) = delete;
+
+    std::uint64_t now() const;
+    float get_speed() const;
+    // A finite multiplier greater than 0, or 0 to run as fast as possible
+    void set_speed(float speed);
+    // Reported by the vblank thread, the period is the one of the next vblank
+    void vblank(std::chrono::microseconds period);
+
+    // Host time left until the clock reaches time, nullopt if only the vblanks can take it there
+    std::optional<std::chrono::nanoseconds> host_time_until(std::uint64_t time) const;
+
+    // The listeners are called after the speed changed or a vblank moved the clock, outside of its lock.
+    // Once remove_listener returned, the listener isn't running anymore.
+    size_t add_listener(Listener listener);
+    void remove_listener(size_t id);
+
+private:
+    std::atomic<bool> scaled = false;
+    std::atomic<std::int64_t> offset = 0;
+
+    mutable std::mutex mutex;
+    float speed = 1.0f;
+    std::uint64_t host_anchor = 0;
+    std::uint64_t guest_anchor = 0;
+    std::uint64_t vblank_period = 16'667;
+
+    std::mutex listeners_mutex;
+    std::map<size_t, Listener> listeners;
+    size_t next_listener_id = 0;
+
+    std::uint64_t now(std::uint64_t host) const;
+    void notify_listeners();
+};
+
+// The clock of the emulated process
+GuestClock &guest_clock();
@@ -93,6 +93,8 @@ inline time_t rtc_timegm(struct tm *tm) {
 #endif
 
 std::uint64_t rtc_base_ticks();
+// Time of the guest clock, see GuestClock
+std::uint64_t rtc_ticks_since_epoch();
 std::uint64_t rtc_get_ticks(uint64_t base_tick);
 void __RtcPspTimeToTm(tm *val, const SceDateTime *pt);
 void __RtcTicksToPspTime(SceDateTime *t, std::uint64_t ticks);
@@ -0,0 +1,116 @@
+// Vita3K emulator project
+// Copyright (C) 2023 Vita3K team
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+#include <rtc/guest_clock.h>
+
+#include <algorithm>
+
+static std::uint64_t host_time() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+GuestClock::GuestClock()
+    : host_anchor(host_time())
+    , guest_anchor(host_anchor) {
+}
+
+// Must be called with the mutex locked
+std::uint64_t GuestClock::now(std::uint64_t host) const {
+    const std::uint64_t elapsed = host - host_anchor;
+    if (speed == 0)
+        return guest_anchor + std::min(elapsed, vblank_period - 1);
+    return guest_anchor + static_cast<std::uint64_t>(elapsed * static_cast<double>(speed));
+}
+
+std::uint64_t GuestClock::now() const {
+    const std::uint64_t host = host_time();
+    if (!scaled.load(std::memory_order_acquire))
+        return host + offset.load(std::memory_order_relaxed);
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    return now(host);
+}
+
+float GuestClock::get_speed() const {
+    const std::lock_guard<std::mutex> lock(mutex);
+    return speed;
+}
+
+void GuestClock::set_speed(float new_speed) {
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        const std::uint64_t host = host_time();
+        // start from the current guest time, so the clock never goes back
+        const std::uint64_t guest = scaled ? now(host) : host + offset;
+        speed = new_speed;
+        host_anchor = host;
+        guest_anchor = guest;
+        offset = static_cast<std::int64_t>(guest - host);
+        scaled.store(speed != 1.0f, std::memory_order_release);
+    }
+    notify_listeners();
+}
+
+void GuestClock::vblank(std::chrono::microseconds period) {
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        if (speed != 0) {
+            vblank_period = period.count();
+            return;
+        }
+        guest_anchor += vblank_period;
+        host_anchor = host_time();
+        vblank_period = period.count();
+    }
+    notify_listeners();
+}
+
+std::optional<std::chrono::nanoseconds> GuestClock::host_time_until(std::uint64_t time) const {
+    const std::lock_guard<std::mutex> lock(mutex);
+    const std::uint64_t host = host_time();
+    const std::uint64_t guest = now(host);
+    if (time <= guest)
+        return std::chrono::nanoseconds(0);
+    if (speed == 0) {
+        if (time - guest_anchor >= vblank_period)
+            return std::nullopt;
+        return std::chrono::microseconds(time - guest);
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double, std::micro>((time - guest) / speed));
+}
+
+size_t GuestClock::add_listener(Listener listener) {
+    const std::lock_guard<std::mutex> lock(listeners_mutex);
+    listeners.emplace(next_listener_id, std::move(listener));
+    return next_listener_id++;
+}
+
+void GuestClock::remove_listener(size_t id) {
+    const std::lock_guard<std::mutex> lock(listeners_mutex);
+    listeners.erase(id);
+}
+
+void GuestClock::notify_listeners() {
+    const std::lock_guard<std::mutex> lock(listeners_mutex);
+    for (const auto &[_, listener] : listeners)
+        listener();
+}
+
+GuestClock &guest_clock() {
+    static GuestClock clock;
+    return clock;
+}
@@ -17,12 +17,11 @@
 
 #include <rtc/rtc.h>
 
+#include <rtc/guest_clock.h>
 #include <util/log.h>
 
 std::uint64_t rtc_ticks_since_epoch() {
-    const auto now = std::chrono::high_resolution_clock::now();
-    const auto now_timepoint = std::chrono::time_point_cast<VitaClocks>(now);
-    return now_timepoint.time_since_epoch().count();
+    return guest_clock().now();
 }
 
 std::uint64_t rtc_base_ticks() {
@@ -2,80 +2,108 @@
 
 #include <algorithm>
 #include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <memory>
+#include <thread>
 
-#include <cassert>
-
-// Ring buffer for bytes - not multi-thread safe, bring your own locks
+// Ring buffer for bytes with a single producer and any number of consumers, without locks.
+// The indices only grow, a byte is at index % capacity in the buffer. Consumers claim what they read by
+// moving claimed forward, then release it in the order they claimed it, so the producer never overwrites
+// bytes a consumer is still copying out.
+// Only one thread at a time may call Insert, bring your own lock if there are several producers.
 class ByteRingBuffer {
 public:
-    ByteRingBuffer(std::size_t size)
+    explicit ByteRingBuffer(std::size_t size)
         : buffer(new char[size])
-        , capacity(size){
-
-        };
+        , capacity(size) {}
 
-    bool Empty() const { return (used == 0); }
-    bool Full() const { return (used == capacity); }
+    bool Empty() const { return Used() == 0; }
+    bool Full() const { return Free() == 0; }
     std::size_t Capacity() const { return capacity; }
-    std::size_t Free() const { return capacity - used; }
-    std::size_t Used() const { return used; }
-
-    std::size_t Insert(const void *in, std::size_t size) {
-        if (Full()) {
-            return 0;
-        }
 
-        const std::size_t insertSize = std::min(size, Free()); // Biggest we can insert in buffer
-        if (start <= end) { // There is space between 'end' and buffer end, and potentially between 0 and 'start'
-            const std::size_t bufEndInsertSize = std::min(capacity - end, insertSize); // Size of data to put between 'end' and buffer end
-            const std::size_t bufStartInsertSize = std::min(start, insertSize - bufEndInsertSize); // Size of data to put between 0 and start
+    // bytes the producer can insert
+    std::size_t Free() const {
+        // end first, so the difference can't exceed the capacity
+        const std::uint64_t end_index = end.load(std::memory_order_acquire);
+        const std::uint64_t start_index = start.load(std::memory_order_acquire);
+        return capacity - static_cast<std::size_t>(end_index - std::min(start_index, end_index));
+    }
 
-            assert((bufEndInsertSize + bufStartInsertSize) == insertSize);
+    // bytes the consumers can still claim
+    std::size_t Used() const {
+        const std::uint64_t claimed_index = claimed.load(std::memory_order_acquire);
+        return static_cast<std::size_t>(end.load(std::memory_order_acquire) - claimed_index);
+    }
 
-            memcpy(&buffer[end], static_cast<const char *>(in), bufEndInsertSize);
-            memcpy(&buffer[0], static_cast<const char *>(in) + bufEndInsertSize, bufStartInsertSize);
-        } else { // There is space between 'end' and 'start'
-            memcpy(&buffer[end], static_cast<const char *>(in), insertSize);
-        }
+    // Inserts as much of in as fits if that is at least min_size bytes, producer only
+    std::size_t Insert(const void *in, std::size_t size, std::size_t min_size = 1) {
+        const std::uint64_t end_index = end.load(std::memory_order_relaxed);
+        const std::size_t insert_size = std::min(size, capacity - static_cast<std::size_t>(end_index - start.load(std::memory_order_acquire)));
+        if (insert_size == 0 || insert_size < min_size)
+            return 0;
 
-        end = (end + insertSize) % capacity;
-        used += insertSize;
-        return insertSize;
+        CopyIn(end_index, static_cast<const char *>(in), insert_size);
+        end.store(end_index + insert_size, std::memory_order_release);
+        return insert_size;
     }
 
-    std::size_t Remove(void *out, std::size_t size) {
-        std::size_t removed = Peek(out, size); // If empty, Peek should copy 0
-        start = (start + removed) % capacity;
-        used -= removed;
-        return removed;
+    // Removes up to size bytes if at least min_size of them are there
+    std::size_t Remove(void *out, std::size_t size, std::size_t min_size = 1) {
+        std::uint64_t claimed_index = claimed.load(std::memory_order_relaxed);
+        std::size_t remove_size;
+        do {
+            remove_size = std::min<std::size_t>(size, end.load(std::memory_order_acquire) - claimed_index);
+            if (remove_size == 0 || remove_size < min_size)
+                return 0;
+        } while (!claimed.compare_exchange_weak(claimed_index, claimed_index + remove_size, std::memory_order_acquire, std::memory_order_relaxed));
+
+        CopyOut(claimed_index, static_cast<char *>(out), remove_size);
+
+        // the consumers that claimed before are still copying, the producer can't have their bytes yet
+        while (start.load(std::memory_order_acquire) != claimed_index)
+            std::this_thread::yield();
+        start.store(claimed_index + remove_size, std::memory_order_release);
+        return remove_size;
     }
 
-    std::size_t Peek(void *out, std::size_t size) const {
-        if (Empty()) {
-            return 0;
-        }
+    // Copies up to size bytes without removing them if at least min_size of them are there
+    std::size_t Peek(void *out, std::size_t size, std::size_t min_size = 1) const {
+        while (true) {
+            const std::uint64_t claimed_index = claimed.load(std::memory_order_acquire);
+            const std::size_t peek_size = std::min<std::size_t>(size, end.load(std::memory_order_acquire) - claimed_index);
+            if (peek_size == 0 || peek_size < min_size)
+                return 0;
 
-        const std::size_t extractSize = std::min(size, Used());
-        if (start < end) { // Data between 'start' and 'end'-1
-            memcpy(out, &buffer[start], extractSize);
-        } else { // Data between 'start' and buffer end, and potentially between 0 and 'end'-1
-            const std::size_t bufTailSize = std::min(capacity - start, extractSize); // Size of stuff to copy between 'start' and buffer end
-            const std::size_t bufHeadSize = std::min(end, extractSize - bufTailSize); // Size of stuff to copy at buffer start
+            CopyOut(claimed_index, static_cast<char *>(out), peek_size);
 
-            assert((bufTailSize + bufHeadSize) == extractSize);
-            memcpy(out, &buffer[start], bufTailSize);
-            memcpy(static_cast<char *>(out) + bufTailSize, &buffer[0], bufHeadSize);
+            // like a seqlock: the copy is only good if no consumer released these bytes to the producer meanwhile
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (start.load(std::memory_order_relaxed) <= claimed_index)
+                return peek_size;
         }
-        return extractSize;
     }
 
 private:
     std::unique_ptr<char[]> buffer;
     const std::size_t capacity;
 
-    // buffer[start] -> buffer[end - 1] is used
-    std::size_t start = 0;
-    std::size_t end = 0;
-    std::size_t used = 0;
+    // buffer[start] -> buffer[end - 1] is used, buffer[start] -> buffer[claimed - 1] is being removed
+    std::atomic<std::uint64_t> start = 0;
+    std::atomic<std::uint64_t> claimed = 0;
+    std::atomic<std::uint64_t> end = 0;
+
+    void CopyIn(std::uint64_t index, const char *in, std::size_t size) {
+        const std::size_t position = index % capacity;
+        const std::size_t tail_size = std::min(size, capacity - position); // Size of data to put before the buffer end
+        memcpy(&buffer[position], in, tail_size);
+        memcpy(&buffer[0], in + tail_size, size - tail_size);
+    }
+
+    void CopyOut(std::uint64_t index, char *out, std::size_t size) const {
+        const std::size_t position = index % capacity;
+        const std::size_t tail_size = std::min(size, capacity - position); // Size of data to copy before the buffer end
+        memcpy(out, &buffer[position], tail_size);
+        memcpy(out + tail_size, &buffer[0], size - tail_size);
+    }
 };
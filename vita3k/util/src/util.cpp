@@ -741,9 +741,9 @@ uint32_t encode_arm_inst(uint8_t type, uint32_t immed, uint16_t reg) {
         // Upper bits == 0xE34
         return ((uint32_t)0xE34 << 20) | ((uint32_t)(immed & 0xF000) << 4) | (immed & 0xFFF) | (reg << 12);
     case INSTRUCTION_SYSCALL:
-        // Syscall does not have any immediate value, the number should
-        // already be in R12
-        return (uint32_t)0xEF000000;
+        // 1110 1111 XXXXXXXXXXXXXXXXXXXXXXXX
+        // where X is the immediate, ignored by the processor
+        return (uint32_t)0xEF000000 | (immed & 0xFFFFFF);
     case INSTRUCTION_BRANCH:
         // 1110 0001 0010 111111111111 0001 YYYY
         // BX Rn has 0xE12FFF1 as top bytes